@@ -241,6 +241,8 @@ void DjvuBridge::processOpen(CmdRequest& request, CmdResponse& response)
         }
 
         pageCount = ddjvu_document_get_pagenum(doc);
+        // Pages evicted from our LRU can be recreated from djvulibre cache without decoding
+        ddjvu_cache_set_size(context, DJVU_PAGES_MEMORY_BUDGET);
 
         info = (ddjvu_pageinfo_t**) calloc(pageCount, sizeof(ddjvu_pageinfo_t*));
         pages = (ddjvu_page_t**) calloc(pageCount, sizeof(ddjvu_page_t*));
@@ -333,6 +335,7 @@ void DjvuBridge::processPage(CmdRequest& request, CmdResponse& response)
         response.result = RES_DJVU_FAIL;
         return;
     }
+    prefetchPages(pageNumber);
 }
 
 void DjvuBridge::processPageFree(CmdRequest& request, CmdResponse& response)
@@ -366,11 +369,7 @@ void DjvuBridge::processPageFree(CmdRequest& request, CmdResponse& response)
         response.result = RES_BAD_REQ_DATA;
         return;
     }
-    if (pages[pageNumber])
-    {
-        ddjvu_page_release(pages[pageNumber]);
-        pages[pageNumber] = NULL;
-    }
+    releasePage(pageNumber);
 }
 
 void DjvuBridge::processPageRender(CmdRequest& request, CmdResponse& response)
@@ -519,7 +518,16 @@ ddjvu_page_t* DjvuBridge::getPage(uint32_t pageNo, bool decode)
 #endif
     if (pages[pageNo] == nullptr) {
         pages[pageNo] = ddjvu_page_create(doc, pageNo);
+        if (pages[pageNo] == nullptr) {
+            LE("Cannot create page %d", pageNo);
+            return nullptr;
+        }
+    } else {
+        pagesLru.remove(pageNo);
     }
+    // Requested page goes to the head, so it is never evicted by prefetched neighbours
+    pagesLru.push_front(pageNo);
+    trimPages();
     if (decode) {
         int step = 0;
         ddjvu_status_t r;
@@ -543,6 +551,60 @@ ddjvu_page_t* DjvuBridge::getPage(uint32_t pageNo, bool decode)
     return pages[pageNo];
 }
 
+void DjvuBridge::prefetchPages(uint32_t pageNo)
+{
+    // ddjvu_page_create starts decoding in djvulibre threads and returns immediately,
+    // so neighbours are decoded in parallel while current page is rendered.
+    auto position = std::next(pagesLru.begin());
+    for (uint32_t d = 1; d <= DJVU_PREFETCH_PAGES; d++) {
+        uint32_t neighbours[2] = { pageNo + d, pageNo - d };
+        for (uint32_t n : neighbours) {
+            if (n >= pageCount || pages[n] != nullptr) {
+                continue;
+            }
+            pages[n] = ddjvu_page_create(doc, n);
+            if (pages[n] != nullptr) {
+                pagesLru.insert(position, n);
+            }
+        }
+    }
+    trimPages();
+}
+
+size_t DjvuBridge::estimatePageMemory(uint32_t pageNo)
+{
+    // Rough size of decoded JB2 shapes and IW44 coefficients, page info is known
+    // for every page that was requested by client, prefetched pages use a default.
+    ddjvu_pageinfo_t* i = info[pageNo];
+    if (i == nullptr || i->width <= 0 || i->height <= 0) {
+        return 4 * 1024 * 1024;
+    }
+    return (size_t) i->width * i->height / 4;
+}
+
+void DjvuBridge::trimPages()
+{
+    size_t total = 0;
+    for (uint32_t n : pagesLru) {
+        total += estimatePageMemory(n);
+    }
+    while (total > DJVU_PAGES_MEMORY_BUDGET && pagesLru.size() > 1) {
+        uint32_t n = pagesLru.back();
+        total -= estimatePageMemory(n);
+        LD("Evicting page %d", n);
+        releasePage(n);
+    }
+}
+
+void DjvuBridge::releasePage(uint32_t pageNo)
+{
+    if (pages[pageNo]) {
+        ddjvu_page_release(pages[pageNo]);
+        pages[pageNo] = NULL;
+    }
+    pagesLru.remove(pageNo);
+}
+
 void DjvuBridge::waitAndHandleMessages()
 {
 #ifdef OREDEBUG
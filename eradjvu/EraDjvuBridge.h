@@ -26,12 +26,18 @@
 #include "StBridge.h"
 #include <string>
 #include <vector>
+#include <list>
 #include <sstream>
 #include <iostream>
 #include <codecvt>
 #include "StSearchUtils.h"
 #include "openreadera.h"
 
+// Decoded pages and djvulibre file cache are kept within this budget
+#define DJVU_PAGES_MEMORY_BUDGET (64 * 1024 * 1024)
+// Neighbour pages decoded in background on each side of requested page
+#define DJVU_PREFETCH_PAGES 1
+
 std::wstring djvu_stringToWstring(const std::string& t_str);
 
 std::string  djvu_wstringToString(const std::wstring& t_str);
@@ -163,6 +169,8 @@ private:
     uint32_t pageCount;
     ddjvu_pageinfo_t **info;
     ddjvu_page_t **pages;
+    // Created pages, most recently used first
+    std::list<uint32_t> pagesLru;
 
     DjvuOutline* outline;
     int searchPackCounter = 0;
@@ -192,6 +200,10 @@ protected:
 
     ddjvu_pageinfo_t* getPageInfo(uint32_t pageNo);
     ddjvu_page_t* getPage(uint32_t pageNo, bool decode);
+    void prefetchPages(uint32_t pageNo);
+    void releasePage(uint32_t pageNo);
+    void trimPages();
+    size_t estimatePageMemory(uint32_t pageNo);
 
     void processLinks(int pageNo, CmdResponse& response);
     void processText(int pageNo, const char* pattern, CmdResponse& response);
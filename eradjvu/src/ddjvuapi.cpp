@@ -63,6 +63,9 @@
 
 #include <cstddef>
 #include <cstdlib>
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+#endif
 #include <cstdio>
 #include <cstring>
 #include <cctype>
@@ -2025,6 +2028,8 @@ struct DJVUNS ddjvu_format_s
   char ditherbits;
   bool rtoptobottom;
   bool ytoptobottom;
+  // EraPDF: masks are 0xff/0xff00/0xff0000, rgb tables are identity
+  bool rgba32;
 };
 
 static ddjvu_format_t *
@@ -2078,6 +2083,8 @@ ddjvu_format_create(ddjvu_format_style_t style,
         }
         if (nargs >= 4)
           fmt->xorval = args[3];
+        fmt->rgba32 = (style==DDJVU_FORMAT_RGBMASK32 && args[0]==0xff
+                       && args[1]==0xff00 && args[2]==0xff0000);
         break;
       }
     case DDJVU_FORMAT_PALETTE8:
@@ -2155,6 +2162,35 @@ ddjvu_format_release(ddjvu_format_t *format)
   delete format;
 }
 
+// EraPDF: RGBA output without per-channel table lookups >>>
+static void
+fmt_convert_row_rgba32(const GPixel *p, int w, uint32_t xorval, uint32_t *b)
+{
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) \
+    && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  const uint8x16_t x0 = vdupq_n_u8(xorval & 0xff);
+  const uint8x16_t x1 = vdupq_n_u8((xorval >> 8) & 0xff);
+  const uint8x16_t x2 = vdupq_n_u8((xorval >> 16) & 0xff);
+  const uint8x16_t x3 = vdupq_n_u8((xorval >> 24) & 0xff);
+  for (; w >= 16; w -= 16, p += 16, b += 16)
+    {
+      // GPixel is stored as b,g,r bytes
+      uint8x16x3_t bgr = vld3q_u8((const uint8_t*)p);
+      uint8x16x4_t rgba;
+      rgba.val[0] = veorq_u8(bgr.val[2], x0);
+      rgba.val[1] = veorq_u8(bgr.val[1], x1);
+      rgba.val[2] = veorq_u8(bgr.val[0], x2);
+      rgba.val[3] = x3;
+      vst4q_u8((uint8_t*)b, rgba);
+    }
+#endif
+  while (--w >= 0) {
+    b[0]=((uint32_t)p->r|((uint32_t)p->g<<8)|((uint32_t)p->b<<16))^xorval;
+    b+=1; p+=1;
+  }
+}
+// EraPDF: RGBA output without per-channel table lookups <<<
+
 static void
 fmt_convert_row(const GPixel *p, int w, 
                 const ddjvu_format_t *fmt, char *buf)
@@ -2188,6 +2224,11 @@ fmt_convert_row(const GPixel *p, int w,
     case DDJVU_FORMAT_RGBMASK32: /* truecolor 32 bits with masks */
       {
         uint32_t *b = (uint32_t*)buf;
+        if (fmt->rgba32)
+          {
+            fmt_convert_row_rgba32(p, w, xorval, b);
+            break;
+          }
         while (--w >= 0) {
           b[0]=(r[0][p->r]|r[1][p->g]|r[2][p->b])^xorval; 
           b+=1; p+=1; 
@@ -2374,6 +2415,23 @@ fmt_convert(GBitmap *bm, const ddjvu_format_t *fmt, char *buffer, int rowsize)
     }
   for (i=m; i<256; i++)
     g[i][0] = g[i][1] = g[i][2] = g[i][3] = 0;
+  // EraPDF: one lookup per pixel for 32 bits output >>>
+  if (fmt->style == DDJVU_FORMAT_RGBMASK32)
+    {
+      const uint32_t (&r)[3][256] = fmt->rgb;
+      uint32_t lut[256];
+      for (i=0; i<256; i++)
+        lut[i] = (r[0][g[i][2]]|r[1][g[i][1]]|r[2][g[i][0]])^fmt->xorval;
+      for (int k=0; k<h; k++, buffer+=rowsize)
+        {
+          const unsigned char *p = (*bm)[fmt->rtoptobottom ? h-1-k : k];
+          uint32_t *b = (uint32_t*)buffer;
+          for (int x=0; x<w; x++)
+            b[x] = lut[p[x]];
+        }
+      return;
+    }
+  // EraPDF: one lookup per pixel for 32 bits output <<<
   
   // Loop on rows
   if (fmt->rtoptobottom)
@@ -21,6 +21,11 @@
 #include "EraEpubBridge.h"
 #include "StSocket.h"
 #include <cstdlib>
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 // Should go as last include to not trigger rebuild of other files on changes
 #include "openreadera_version.h"
 
@@ -84,7 +89,29 @@ void CreBridge::convertBitmap(LVColorDrawBuf* bitmap)
     if (bitmap->GetBitsPerPixel() == 32) {
         // Convert Cre colors to Android
         int size = bitmap->GetWidth() * bitmap->GetHeight();
-        for (lUInt8* p = bitmap->GetData(); --size >= 0; p+=4) {
+        lUInt8* p = bitmap->GetData();
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+        for (; size >= 16; size -= 16, p += 64) {
+            uint8x16x4_t px = vld4q_u8(p);
+            uint8x16_t t = px.val[0];
+            px.val[0] = px.val[2];
+            px.val[2] = t;
+            px.val[3] = vmvnq_u8(px.val[3]);
+            vst4q_u8(p, px);
+        }
+#elif defined(__SSE2__)
+        const __m128i mask_g = _mm_set1_epi32(0x0000FF00);
+        const __m128i mask_b = _mm_set1_epi32(0x000000FF);
+        const __m128i mask_a = _mm_set1_epi32((int) 0xFF000000);
+        for (; size >= 4; size -= 4, p += 16) {
+            __m128i px = _mm_loadu_si128((const __m128i*) p);
+            __m128i res = _mm_or_si128(_mm_and_si128(px, mask_g), _mm_andnot_si128(px, mask_a));
+            res = _mm_or_si128(res, _mm_and_si128(_mm_srli_epi32(px, 16), mask_b));
+            res = _mm_or_si128(res, _mm_slli_epi32(_mm_and_si128(px, mask_b), 16));
+            _mm_storeu_si128((__m128i*) p, res);
+        }
+#endif
+        for (; --size >= 0; p += 4) {
             // Invert A
             p[3] ^= 0xFF;
             // Swap R and B
@@ -107,6 +134,11 @@ void CreBridge::processOpen(CmdRequest& request, CmdResponse& response)
         .getInt(&doc_format)
         .getByteArray(&absolute_path_arg)
         .getInt(&direct_archive);
+    // Optional saved reading position, progressive layout covers it in the first pass
+    uint8_t* position_arg = nullptr;
+    if (iter.hasNext()) {
+        iter.getByteArray(&position_arg);
+    }
     if (!iter.isValid() || !socket_name || !absolute_path_arg) {
         response.result = RES_BAD_REQ_DATA;
         return;
@@ -140,8 +172,19 @@ void CreBridge::processOpen(CmdRequest& request, CmdResponse& response)
 
     if (result)
     {
-        doc_view_->RenderIfDirty();
-        response.addInt(ExportPagesCount(doc_view_->GetColumns(), doc_view_->GetPagesCount()));
+        if (doc_view_->cfg_progressive_render_)
+        {
+            lString16 position = position_arg
+                    ? lString16(reinterpret_cast<const char*>(position_arg)) : lString16::empty_str;
+            int pages = doc_view_->RenderPrefix(position);
+            response.addInt(ExportPagesCount(doc_view_->GetColumns(), pages));
+            response.addInt(doc_view_->IsLayoutIncomplete() ? 1 : 0);
+        }
+        else
+        {
+            doc_view_->RenderIfDirty();
+            response.addInt(ExportPagesCount(doc_view_->GetColumns(), doc_view_->GetPagesCount()));
+        }
     }
     else if (OreIsNormalDirectArchive(direct_archive))
         {response.result = RES_ARCHIVE_COLLISION;}
@@ -149,6 +192,18 @@ void CreBridge::processOpen(CmdRequest& request, CmdResponse& response)
         {response.result = RES_INTERNAL_ERROR;}
 }
 
+void CreBridge::processCompleteLayout(CmdRequest& request, CmdResponse& response)
+{
+    response.cmd = CMD_RES_CRE_COMPLETE_LAYOUT;
+    if (doc_view_ == nullptr) {
+        CRLog::error("processCompleteLayout doc not opened");
+        response.result = RES_BAD_REQ_DATA;
+        return;
+    }
+    doc_view_->CompleteLayout();
+    response.addInt(ExportPagesCount(doc_view_->GetColumns(), doc_view_->GetPagesCount()));
+}
+
 void CreBridge::processPageRender(CmdRequest& request, CmdResponse& response)
 {
     response.cmd = CMD_RES_PAGE_RENDER;
@@ -168,6 +223,8 @@ void CreBridge::processPageRender(CmdRequest& request, CmdResponse& response)
         return;
     }
 
+    // Pages past laid out prefix, next spread included, need whole document
+    doc_view_->CompleteLayoutForPage((page + 1) * doc_view_->GetColumns());
     doc_view_->GoToPage(ImportPage(page, doc_view_->GetColumns()));
     auto resp = new CmdData();
     unsigned char* pixels = resp->newByteArray(width * height * 4);
@@ -211,6 +268,7 @@ void CreBridge::processPageRender(CmdRequest& request, CmdResponse& response)
         convertBitmap(buf);
         delete buf;
         response.addData(resp);
+        prewarm_pending_ = true;
     }
 }
 
@@ -223,6 +281,7 @@ void CreBridge::processQuit(CmdRequest& request, CmdResponse& response)
 CreBridge::CreBridge() : StBridge(ORE_LOG_TAG)
 {
     doc_view_ = nullptr;
+    prewarm_pending_ = false;
 #ifdef OREDEBUG
     CRLog::setLevel(CRLog::TRACE);
 #else
@@ -242,6 +301,14 @@ CreBridge::~CreBridge()
     ShutdownFontManager();
 }
 
+void CreBridge::processIdle()
+{
+    if (prewarm_pending_ && doc_view_ != nullptr) {
+        doc_view_->PrewarmPageImages();
+    }
+    prewarm_pending_ = false;
+}
+
 void CreBridge::process(CmdRequest& request, CmdResponse& response)
 {
     response.reset();
@@ -260,6 +327,9 @@ void CreBridge::process(CmdRequest& request, CmdResponse& response)
         case CMD_REQ_PAGE_RENDER:
             processPageRender(request, response);
             break;
+        case CMD_REQ_CRE_COMPLETE_LAYOUT:
+            processCompleteLayout(request, response);
+            break;
         case CMD_REQ_LINKS:
             processPageLinks(request, response);
             break;
@@ -305,6 +375,9 @@ void CreBridge::process(CmdRequest& request, CmdResponse& response)
         case CMD_REQ_INDEXER:
             processTextSearchGetSuggestionsIndex(request, response);
             break;
+        case CMD_REQ_INDEXER_PREFIX:
+            processTextSearchSuggestionsByPrefix(request, response);
+            break;
         case CMD_REQ_CRE_IMG_XPATHS:
             processImagesXpaths(request, response);
             break;
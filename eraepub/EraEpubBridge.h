@@ -30,6 +30,8 @@ typedef std::map<int, ldomWord> ldomWordMap;
 class CreBridge : public StBridge {
 private:
     LVDocView* doc_view_;
+    // Images of neighbour pages are decoded after rendered page is sent
+    bool prewarm_pending_;
 public:
     CreBridge();
 
@@ -37,6 +39,8 @@ public:
 
     void process(CmdRequest& request, CmdResponse& response);
 
+    void processIdle();
+
 protected:
     uint32_t ExportPagesCount(int columns, int pages);
 
@@ -67,6 +71,8 @@ protected:
 
     void processPageRender(CmdRequest& request, CmdResponse& response);
 
+    void processCompleteLayout(CmdRequest& request, CmdResponse& response);
+
     void processPageByXPath(CmdRequest& request, CmdResponse& response);
 
     void processPageByXPathMultiple(CmdRequest& request, CmdResponse& response);
@@ -88,6 +94,7 @@ protected:
     void processTextSearchPreviews(CmdRequest& request, CmdResponse& response);
 
     void processTextSearchGetSuggestionsIndex(CmdRequest& request, CmdResponse& response);
+    void processTextSearchSuggestionsByPrefix(CmdRequest& request, CmdResponse& response);
 
     void processImagesXpaths(CmdRequest& request, CmdResponse& response);
 
@@ -278,6 +278,26 @@ void CreBridge::processConfig(CmdRequest& request, CmdResponse& response)
             }
             bool bool_val = (bool) int_val;
             doc_view_->cfg_firstpage_thumb_ = bool_val;
+        } else if (key == CONFIG_CRE_PROGRESSIVE_RENDER) {
+            int int_val = parseInt(val);
+            if (int_val < 0 || int_val > 1) {
+                response.result = RES_BAD_REQ_DATA;
+                return;
+            }
+            doc_view_->cfg_progressive_render_ = (bool) int_val;
+        } else if (key == CONFIG_CRE_STORAGE_CODEC) {
+            int int_val = parseInt(val);
+            if (int_val < STORAGE_CODEC_NONE || int_val > STORAGE_CODEC_ZLIB) {
+                response.result = RES_BAD_REQ_DATA;
+                return;
+            }
+            ldomDataStorageManager::setCodec(int_val);
+        } else if (key == CONFIG_CRE_STORAGE_SPILL_DIR) {
+            ldomDataStorageManager::setSpillDir(lString8(val));
+        } else if (key == CONFIG_CRE_HYPH_CACHE_DIR) {
+            HyphMan::setCacheDir(Utf8ToUnicode(lString8(val)));
+        } else if (key == CONFIG_CRE_PHRASE_CACHE_DIR) {
+            doc_view_->cfg_phrase_cache_dir_ = Utf8ToUnicode(lString8(val));
         } else if (key == CONFIG_ERA_EMBEDDED_STYLES) {
             int int_val = parseInt(val);
             if (int_val < 0 || int_val > 5) {
@@ -339,6 +359,10 @@ void CreBridge::processConfig(CmdRequest& request, CmdResponse& response)
         //LE("cfg_txt_indent_margin_override out indent = [%d]  margin = [%d] ", doc_view_->GetCrDom()->cfg_txt_indent, doc_view_->GetCrDom()->cfg_txt_margin);
     }
     doc_view_->hitboxesCash.reset();
+    doc_view_->pageTextCash.reset();
+    doc_view_->xpointerIndex.reset();
+    doc_view_->SavePhrasesIndex();
+    doc_view_->phraseIndex.reset();
     doc_view_->RenderIfDirty();
     response.addInt(ExportPagesCount(doc_view_->GetColumns(), doc_view_->GetPagesCount()));
 }
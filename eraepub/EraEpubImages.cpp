@@ -160,6 +160,7 @@ void CreBridge::processImageHitbox(CmdRequest &request, CmdResponse &response)
         response.result = RES_BAD_REQ_DATA;
         return;
     }
+    doc_view_->CompleteLayoutForPage((external_page + 1) * doc_view_->GetColumns());
     auto page = (uint32_t) ImportPage(external_page, doc_view_->GetColumns());
     doc_view_->GoToPage(page);
     float page_width    = doc_view_->GetWidth();
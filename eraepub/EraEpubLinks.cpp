@@ -31,6 +31,7 @@ void CreBridge::processPageLinks(CmdRequest& request, CmdResponse& response)
         response.result = RES_BAD_REQ_DATA;
         return;
     }
+    doc_view_->CompleteLayoutForPage((external_page + 1) * doc_view_->GetColumns());
     auto page = (uint32_t) ImportPage(external_page, doc_view_->GetColumns());
     doc_view_->GoToPage(page);
     LVArray<Hitbox> pageLinks = doc_view_->GetPageLinks();
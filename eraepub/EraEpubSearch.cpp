@@ -20,6 +20,30 @@
 
 #include "EraEpubBridge.h"
 
+// Single pass, pos() and replace() in loop rescan the string from start every time
+static lString16 replaceLineBreaks(const lString16& text, const lChar16* replacement)
+{
+    if (text.pos(L"\n") == -1)
+    {
+        return text;
+    }
+    lString16 result;
+    result.reserve(text.length());
+    const lChar16* s = text.c_str();
+    for (int i = 0; i < text.length(); i++)
+    {
+        if (s[i] == '\n')
+        {
+            result.append(replacement);
+        }
+        else
+        {
+            result.append(1, s[i]);
+        }
+    }
+    return result;
+}
+
 void CreBridge::processTextSearchPreviews(CmdRequest &request, CmdResponse &response)
 {
     response.cmd = CMD_RES_SEARCH_PREVIEWS;
@@ -44,10 +68,16 @@ void CreBridge::processTextSearchPreviews(CmdRequest &request, CmdResponse &resp
 
     lString16 query  = inputstr;
     int pagestart = 0;
-    int pageend = doc_view_->GetPagesCount()-1;
+    int pageend = -1;
 
     int sep = inputstr.pos(":");
-    if (sep > 0)
+    if (sep <= 0)
+    {
+        // Whole book search covers pages past laid out prefix or imported text too
+        doc_view_->CompleteLayout();
+        pageend = doc_view_->GetPagesCount()-1;
+    }
+    else
     {
         lString16 pages_s = inputstr.substr(0, sep);
         lString16Collection pages_c;
@@ -63,15 +93,11 @@ void CreBridge::processTextSearchPreviews(CmdRequest &request, CmdResponse &resp
         response.result = RES_BAD_REQ_DATA;
         return;
     }
-    int slash_n = query.pos("\n");
-    while (slash_n!=-1)
-    {
-        query.replace(slash_n,1,lString16(" "));
-        slash_n = query.pos("\n");
-    }
+    query = replaceLineBreaks(query, L" ");
 
     query = query.processIndicText();
 
+    doc_view_->CompleteLayoutForPage((pageend + 1) * doc_view_->GetColumns());
     for (int p = pagestart; p <= pageend; p ++)
     {
         auto page = (uint32_t) ImportPage(p, doc_view_->GetColumns());
@@ -81,11 +107,7 @@ void CreBridge::processTextSearchPreviews(CmdRequest &request, CmdResponse &resp
         {
             SearchResult curr = searchPreviews.get(i);
 
-            lString16 text = curr.preview_;
-            while (text.pos(L"\n")!=-1)
-            {
-                text.replace(L"\n", L" ");
-            }
+            lString16 text = replaceLineBreaks(curr.preview_, L" ");
             //text.trimDoubleSpaces(false,false,false);
 
             lString16 xpointers_str;
@@ -148,13 +170,9 @@ void CreBridge::processTextSearchHitboxes(CmdRequest &request, CmdResponse &resp
         response.result = RES_BAD_REQ_DATA;
         return;
     }
-    int slash_n = query.pos("\n");
-    while (slash_n!=-1)
-    {
-        query.replace(slash_n,1,lString16::empty_str);
-        slash_n = query.pos("\n");
-    }
+    query = replaceLineBreaks(query, L"");
 
+    doc_view_->CompleteLayoutForPage((external_page + 1) * doc_view_->GetColumns());
     auto page = (uint32_t) ImportPage(external_page, doc_view_->GetColumns());
 
     query = query.processIndicText();
@@ -254,13 +272,47 @@ void CreBridge::processTextSearchGetSuggestionsIndex(CmdRequest &request, CmdRes
 
     //lString16Map map = doc_view_->GetWordsIndexesMap();
 
-    for (int page_index = pagestart; page_index < pageend; page_index++)
+    PhraseIndex& index = doc_view_->GetPhrasesIndex(pagestart, pageend);
+    for (int page = pagestart; page < pageend; page++)
     {
-        lString16Map map = doc_view_->GetPhrasesIndexesMapForPage(page_index);
-        for (lString16Map::iterator it = map.begin(); it != map.end(); it++)
+        for (int i = index.pageStart(page); i < index.pageEnd(page); i++)
         {
-            responseAddString(response, lString16(it->first.c_str()));
-            response.addInt(it->second);
+            PhraseIndex::Posting posting = index.posting(i);
+            responseAddString(response, index.phrase(posting.phrase));
+            response.addInt(posting.count);
         }
     }
 }
+
+void CreBridge::processTextSearchSuggestionsByPrefix(CmdRequest &request, CmdResponse &response)
+{
+    response.cmd = CMD_RES_INDEXER_PREFIX;
+    CmdDataIterator iter(request.first);
+    uint8_t *temp_val;
+    uint32_t max_count = 0;
+    iter.getByteArray(&temp_val).getInt(&max_count);
+    if (!iter.isValid())
+    {
+        CRLog::error("processTextSearchSuggestionsByPrefix bad request data");
+        response.result = RES_BAD_REQ_DATA;
+        return;
+    }
+    const char *val = reinterpret_cast<const char *>(temp_val);
+    lString16 prefix = Utf8ToUnicode(lString8(val));
+    prefix.lowercase();
+    if (prefix.empty())
+    {
+        CRLog::error("processTextSearchSuggestionsByPrefix bad request data");
+        response.result = RES_BAD_REQ_DATA;
+        return;
+    }
+    // Phrases of pages already indexed by CMD_REQ_INDEXER or loaded from phrase cache
+    PhraseIndex& index = doc_view_->GetPhrasesIndex(0, 0);
+    LVArray<PhraseIndex::Posting> found;
+    index.findPrefix(prefix, (int) max_count, found);
+    for (int i = 0; i < found.length(); i++)
+    {
+        responseAddString(response, index.phrase(found[i].phrase));
+        response.addInt(found[i].count);
+    }
+}
@@ -35,20 +35,20 @@ void CreBridge::processPageText(CmdRequest& request, CmdResponse& response)
         response.result = RES_BAD_REQ_DATA;
         return;
     }
+    doc_view_->CompleteLayoutForPage((external_page + 1) * doc_view_->GetColumns());
     auto page = (uint32_t) ImportPage(external_page, doc_view_->GetColumns());
     doc_view_->GoToPage(page);
 #ifdef DEBUG_TEXT
     CRLog::debug("processPageText external_page=%d page=%d page_width=%d page_height=%d",
             external_page, page, doc_view_->GetWidth(), doc_view_->GetHeight());
 #endif
-    LVArray<Hitbox> hitboxes = doc_view_->GetPageHitboxes();
-    for (int i = 0; i < hitboxes.length(); i++)
+    const PageGeometry& geometry = doc_view_->GetPageGeometry(page);
+    for (int i = 0; i < geometry.length(); i++)
     {
-        Hitbox currHitbox = hitboxes.get(i);
         if(gJapaneseVerticalMode)
         {
-            float t = currHitbox.top_;
-            float b = currHitbox.bottom_;
+            float t = geometry.top(i);
+            float b = geometry.bottom(i);
 
             t -=0.5f;
             b -=0.5f;
@@ -60,19 +60,19 @@ void CreBridge::processPageText(CmdRequest& request, CmdResponse& response)
             b +=0.5f;
 
             response.addFloat(b);
-            response.addFloat(currHitbox.left_);
+            response.addFloat(geometry.left(i));
             response.addFloat(t);
-            response.addFloat(currHitbox.right_);
+            response.addFloat(geometry.right(i));
         }
         else
         {
-            response.addFloat(currHitbox.left_);
-            response.addFloat(currHitbox.top_);
-            response.addFloat(currHitbox.right_);
-            response.addFloat(currHitbox.bottom_);
+            response.addFloat(geometry.left(i));
+            response.addFloat(geometry.top(i));
+            response.addFloat(geometry.right(i));
+            response.addFloat(geometry.bottom(i));
         }
 
-        responseAddString(response, currHitbox.text_.restoreIndicText());
+        responseAddString(response, geometry.text(i).restoreIndicText());
     }
 #undef DEBUG_TEXT
 }
@@ -115,28 +115,33 @@ void CreBridge::processRtlText(CmdRequest &request, CmdResponse &response)
     uint32_t id_start = keys.at(1).atoi();
     uint32_t id_end   = keys.at(2).atoi();
 
+    doc_view_->CompleteLayoutForPage((external_page + 1) * doc_view_->GetColumns());
     uint32_t page = (uint32_t) ImportPage(external_page, doc_view_->GetColumns());
     doc_view_->GoToPage(page);
-    LVArray<Hitbox> hitboxes = doc_view_->GetPageHitboxes();
+    const PageGeometry& geometry = doc_view_->GetPageGeometry(page);
     LVArray<SortStruct> array;
-    long long int lastindex;
+    long long int lastindex = 0;
+    if (id_end >= (uint32_t) geometry.length())
+    {
+        id_end = geometry.length() - 1;
+    }
 
-    for (int i = id_start; i <= id_end; i++)
+    for (int i = id_start; i <= (int) id_end; i++)
     {
-        Hitbox hb = hitboxes.get(i);
+        ldomNode* node = geometry.node(i);
         long long int index;
-        if (hb.getNode()->isNull())
+        if (node->isNull())
         {
             index = lastindex;
         }
         else
         {
-            index = hb.getNode()->getDataIndex() * 1000000;
-            index += hb.word_.getStartXPointer().getOffset();
+            index = node->getDataIndex() * 1000000;
+            index += geometry.word(i).getStartXPointer().getOffset();
             lastindex = index;
         }
         SortStruct str;
-        str.text = hb.text_;
+        str.text = geometry.text(i);
         str.weight = index;
         array.add(str);
     }
@@ -182,6 +187,7 @@ void CreBridge::processXPathByHitbox(CmdRequest &request, CmdResponse &response)
 
     uint32_t external_page = keys.at(0).atoi();
     lString16 hitbox = keys.at(1);
+    doc_view_->CompleteLayoutForPage((external_page + 1) * doc_view_->GetColumns());
     uint32_t page = (uint32_t) ImportPage(external_page, doc_view_->GetColumns());
     ldomWordMap m = doc_view_->GetldomWordMapFromPage(page);
 
@@ -218,6 +224,7 @@ void CreBridge::processXPathByRectId(CmdRequest &request, CmdResponse &response)
     {
         endXpath = (bool) keys.at(2).atoi();
     }
+    doc_view_->CompleteLayoutForPage((external_page + 1) * doc_view_->GetColumns());
     uint32_t page = (uint32_t) ImportPage(external_page, doc_view_->GetColumns());
     lString16 xpath = doc_view_->GetXpathFromPageById(page, id, endXpath );
 
@@ -260,6 +267,7 @@ void CreBridge::processPageRangeText(CmdRequest &request, CmdResponse &response)
     int external_page = keys.at(0).atoi();
     lString16 startstr  = keys.at(1);
     lString16 endstr    = keys.at(2);
+    doc_view_->CompleteLayoutForPage(external_page + 1);
     if( external_page < 0 || external_page >= doc_view_->GetPagesCount() )
     {
         CRLog::error("processPageRangeText: External page %d < 0 OR %d >= %d",
@@ -270,8 +278,8 @@ void CreBridge::processPageRangeText(CmdRequest &request, CmdResponse &response)
     int page = external_page;
     doc_view_->GoToPage(page);
 
-    ldomXPointer start  = doc_view_->GetCrDom()->createXPointer(startstr);
-    ldomXPointer end    = doc_view_->GetCrDom()->createXPointer(endstr);
+    ldomXPointer start  = doc_view_->CreateXPointer(startstr);
+    ldomXPointer end    = doc_view_->CreateXPointer(endstr);
     int startpage = doc_view_->GetPageForBookmark(start);
     int endpage = doc_view_->GetPageForBookmark(end);
     //CRLog::error("processPageRangeText key_input = %s",LCSTR(key_input));
@@ -393,14 +401,7 @@ void CreBridge::processPageByXPath(CmdRequest& request, CmdResponse& response)
         return;
     }
     lString16 xpath(reinterpret_cast<const char*>(xpath_string));
-    ldomXPointer bm = doc_view_->GetCrDom()->createXPointer(xpath);
-    if (bm.isNull()) {
-        CRLog::error("processPageByXPath bad xpath bm.isNull()");
-        response.result = RES_BAD_REQ_DATA;
-        return;
-    }
-    doc_view_->GoToBookmark(bm);
-    int current_page = doc_view_->GetCurrPage();
+    int current_page = doc_view_->GetPageForXPath(xpath);
     if (current_page < 0) {
         CRLog::error("processPageByXPath bad xpath current_page < 0");
         response.result = RES_BAD_REQ_DATA;
@@ -428,16 +429,7 @@ void CreBridge::processPageByXPathMultiple(CmdRequest& request, CmdResponse& res
     lString16 pages_str;
     for (int i = 0; i < paths.length(); i++)
     {
-        lString16 xpath = paths.at(i);
-        ldomXPointer bm = doc_view_->GetCrDom()->createXPointer(xpath);
-        if (bm.isNull())
-        {
-            pages_str += L"-1;";
-            CRLog::error("processPageByXPathMultiple bad xpath bm.isNull()");
-            continue;
-        }
-        doc_view_->GoToBookmark(bm);
-        int current_page = doc_view_->GetCurrPage();
+        int current_page = doc_view_->GetPageForXPath(paths.at(i));
         if (current_page < 0)
         {
             pages_str += L"-1;";
@@ -467,6 +459,7 @@ void CreBridge::processPageXPath(CmdRequest& request, CmdResponse& response)
         response.result = RES_BAD_REQ_DATA;
         return;
     }
+    doc_view_->CompleteLayoutForPage((page + 1) * doc_view_->GetColumns());
     ldomXPointer xptr = doc_view_->getPageBookmark(ImportPage(page, doc_view_->GetColumns()));
     if (xptr.isNull()) {
         CRLog::error("processPageXPath null ldomXPointer");
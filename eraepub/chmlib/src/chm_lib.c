@@ -1639,6 +1639,194 @@ LONGINT64 chm_retrieve_object(struct chmFile *h,
     }
 }
 
+/* find reset interval holding given address of compressed space */
+int chm_get_interval(struct chmFile *h,
+                     LONGUINT64 addr,
+                     LONGUINT64 *interval)
+{
+    if (h == NULL                         ||
+        ! h->compression_enabled          ||
+        h->reset_table.block_len == 0     ||
+        h->reset_blkcount == 0)
+        return 0;
+
+    *interval = addr / h->reset_table.block_len / h->reset_blkcount;
+    return 1;
+}
+
+/* read compressed blocks of reset interval, returns 0 on failure */
+int chm_read_interval(struct chmFile *h,
+                      LONGUINT64 interval,
+                      struct chmLzxInterval *iv)
+{
+    UChar *table, *dummy;
+    unsigned int remain;
+    UInt64 block, cmpStart, cmpEnd;
+    int entries, i;
+
+    memset(iv, 0, sizeof(struct chmLzxInterval));
+    if (h == NULL                         ||
+        ! h->compression_enabled          ||
+        h->reset_table.block_len == 0     ||
+        h->reset_blkcount == 0)
+        return 0;
+
+    block = interval * h->reset_blkcount;
+    if (block >= h->reset_table.block_count)
+        return 0;
+    iv->first_block = block;
+    iv->block_count = (int)h->reset_blkcount;
+    if (block + iv->block_count > h->reset_table.block_count)
+        iv->block_count = (int)(h->reset_table.block_count - block);
+    iv->block_len = (unsigned int)h->reset_table.block_len;
+    iv->window_bits = myffs(h->window_size) - 1;
+
+    /* one reset table read gives bounds of all blocks, the last block of */
+    /* the section ends where compressed data ends                        */
+    entries = iv->block_count + 1;
+    if (block + iv->block_count >= h->reset_table.block_count)
+        entries = iv->block_count;
+    table = (UChar *)malloc(entries * 8);
+    iv->cmp_offsets = (LONGINT64 *)malloc((iv->block_count + 1) * sizeof(LONGINT64));
+    if (table == NULL || iv->cmp_offsets == NULL)
+    {
+        free(table);
+        chm_free_interval(iv);
+        return 0;
+    }
+    remain = entries * 8;
+    if (_chm_fetch_bytes(h, table,
+                         (UInt64)h->data_offset
+                            + (UInt64)h->rt_unit.start
+                            + (UInt64)h->reset_table.table_offset
+                            + (UInt64)block*8,
+                         remain) != remain)
+    {
+        free(table);
+        chm_free_interval(iv);
+        return 0;
+    }
+    dummy = table;
+    _unmarshal_uint64(&dummy, &remain, &cmpStart);
+    iv->cmp_offsets[0] = 0;
+    for (i = 1; i <= iv->block_count; i++)
+    {
+        if (i < entries)
+            _unmarshal_uint64(&dummy, &remain, &cmpEnd);
+        else
+            cmpEnd = h->reset_table.compressed_len;
+        iv->cmp_offsets[i] = (Int64)(cmpEnd - cmpStart);
+        if (cmpEnd < cmpStart                                               ||
+            iv->cmp_offsets[i] < iv->cmp_offsets[i-1]                       ||
+            iv->cmp_offsets[i] - iv->cmp_offsets[i-1] > (Int64)iv->block_len + 6144)
+        {
+            free(table);
+            chm_free_interval(iv);
+            return 0;
+        }
+    }
+    free(table);
+
+    /* decoder may look a few bytes past the end of the last block */
+    iv->cmp_data = (UChar *)malloc((size_t)iv->cmp_offsets[iv->block_count] + 16);
+    if (iv->cmp_data == NULL)
+    {
+        chm_free_interval(iv);
+        return 0;
+    }
+    memset(iv->cmp_data + iv->cmp_offsets[iv->block_count], 0, 16);
+    if (_chm_fetch_bytes(h, iv->cmp_data,
+                         cmpStart + h->data_offset + h->cn_unit.start,
+                         iv->cmp_offsets[iv->block_count])
+            != iv->cmp_offsets[iv->block_count])
+    {
+        chm_free_interval(iv);
+        return 0;
+    }
+    return 1;
+}
+
+/* decompress blocks of reset interval, returns 0 on failure.  doesn't use */
+/* the file handle, so it's safe to call for different intervals at once  */
+int chm_decompress_interval(struct chmLzxInterval *iv)
+{
+    struct LZXstate *state;
+    int i;
+
+    if (iv->cmp_data == NULL)
+        return 0;
+    iv->data = (UChar *)malloc((size_t)iv->block_count * iv->block_len);
+    if (iv->data == NULL)
+        return 0;
+    state = LZXinit(iv->window_bits);
+    if (state == NULL)
+    {
+        free(iv->data);
+        iv->data = NULL;
+        return 0;
+    }
+    LZXreset(state);
+    for (i = 0; i < iv->block_count; i++)
+    {
+        if (LZXdecompress(state,
+                          iv->cmp_data + iv->cmp_offsets[i],
+                          iv->data + (size_t)i * iv->block_len,
+                          (int)(iv->cmp_offsets[i+1] - iv->cmp_offsets[i]),
+                          (int)iv->block_len) != DECR_OK)
+        {
+            LZXteardown(state);
+            free(iv->data);
+            iv->data = NULL;
+            return 0;
+        }
+    }
+    LZXteardown(state);
+
+    /* compressed data isn't needed any more */
+    free(iv->cmp_data);
+    iv->cmp_data = NULL;
+    return 1;
+}
+
+/* put decompressed blocks of reset interval to the block cache */
+void chm_cache_interval(struct chmFile *h,
+                        struct chmLzxInterval *iv)
+{
+    int i, indexSlot;
+    UInt64 block;
+
+    if (iv->data == NULL || iv->block_len != h->reset_table.block_len)
+        return;
+
+    CHM_ACQUIRE_LOCK(h->lzx_mutex);
+    CHM_ACQUIRE_LOCK(h->cache_mutex);
+    for (i = 0; i < iv->block_count; i++)
+    {
+        block = iv->first_block + i;
+        indexSlot = (int)(block % h->cache_num_blocks);
+        if (! h->cache_blocks[indexSlot])
+            h->cache_blocks[indexSlot] = (UChar *)malloc(iv->block_len);
+        if (! h->cache_blocks[indexSlot])
+            break;
+        memcpy(h->cache_blocks[indexSlot],
+               iv->data + (size_t)i * iv->block_len,
+               iv->block_len);
+        h->cache_block_indices[indexSlot] = block;
+    }
+    CHM_RELEASE_LOCK(h->cache_mutex);
+    CHM_RELEASE_LOCK(h->lzx_mutex);
+}
+
+void chm_free_interval(struct chmLzxInterval *iv)
+{
+    free(iv->cmp_offsets);
+    free(iv->cmp_data);
+    free(iv->data);
+    iv->cmp_offsets = NULL;
+    iv->cmp_data = NULL;
+    iv->data = NULL;
+}
+
 /* enumerate the objects in the .chm archive */
 int chm_enumerate(struct chmFile *h,
                   int what,
@@ -131,6 +131,38 @@ LONGINT64 chm_retrieve_object(struct chmFile *h,
                               LONGUINT64 addr,
                               LONGINT64 len);
 
+/* LZX reset interval, decompressed independently from the file handle.    */
+/* Only chm_decompress_interval may run concurrently with other calls.      */
+struct chmLzxInterval
+{
+    LONGUINT64         first_block;
+    int                block_count;
+    unsigned int       block_len;
+    int                window_bits;
+    LONGINT64         *cmp_offsets;   /* block_count+1 offsets in cmp_data */
+    unsigned char     *cmp_data;
+    unsigned char     *data;          /* block_count*block_len bytes       */
+};
+
+/* find reset interval holding given address of compressed space */
+int chm_get_interval(struct chmFile *h,
+                     LONGUINT64 addr,
+                     LONGUINT64 *interval);
+
+/* read compressed blocks of reset interval, returns 0 on failure */
+int chm_read_interval(struct chmFile *h,
+                      LONGUINT64 interval,
+                      struct chmLzxInterval *iv);
+
+/* decompress blocks of reset interval, returns 0 on failure */
+int chm_decompress_interval(struct chmLzxInterval *iv);
+
+/* put decompressed blocks of reset interval to the block cache */
+void chm_cache_interval(struct chmFile *h,
+                        struct chmLzxInterval *iv);
+
+void chm_free_interval(struct chmLzxInterval *iv);
+
 /* enumerate the objects in the .chm archive */
 typedef int (*CHM_ENUMERATOR)(struct chmFile *h,
                               struct chmUnitInfo *ui,
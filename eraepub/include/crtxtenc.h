@@ -109,6 +109,17 @@ int AutodetectCodePage(const unsigned char * buf, int buf_size, char * cp_name,
     \return non-zero on success
 */
 int AutodetectCodePageUtf( const unsigned char * buf, int buf_size, char * cp_name, char * lang_name );
+/**
+    \brief Autodetects encoding of text data in buffer, only using ByteOrderMark.
+
+    \param buf is buffer with text data to autodetect, first 4 bytes are enough
+    \param buf_size is size of data in buffer, bytes
+    \param cp_name is buffer to store autodetected name of encoding, i.e. "utf-8", "utf-16le"
+    \param lang_name is buffer to store autodetected name of language, i.e. "en"
+
+    \return non-zero on success
+*/
+int AutodetectCodePageBom( const unsigned char * buf, int buf_size, char * cp_name, char * lang_name );
 
 bool hasXmlTags(const lUInt8 * buf, int size);
 
@@ -27,6 +27,7 @@ public:
     virtual lverror_t GetSize(lvsize_t* pSize);
     virtual LVStreamRef OpenStream(const lChar16* fname, lvopen_mode_t mode);
     virtual LVStreamRef OpenStreamByPackedSize(uint32_t size);
+    virtual bool ReadPackedItem(const lChar16* fname, LVPackedItem& item);
     /// returns stream/container name, may be NULL if unknown
     virtual const lChar16* GetName();
     /// sets stream/container name, may be not implemented for some objects
@@ -76,12 +76,16 @@ class HyphMan
     static HyphMethod* _method;
 	static HyphDictionary* _selectedDictionary;
 	static HyphDictionaryList* _dictList;
+    static lString16 _cacheDir;
 public:
     HyphMan();
     ~HyphMan();
 	static void init();
 	static void uninit();
     static bool activateDictionaryFromStream(LVStreamRef stream);
+    /// directory for tries compiled on dictionary activation, empty string disables them
+    static void setCacheDir(const lString16& dir) { _cacheDir = dir; }
+    static const lString16& getCacheDir() { return _cacheDir; }
     static bool activateDictionary(lString16 id) { return _dictList->activate(id); }
 	static HyphDictionary* getSelectedDictionary() { return _selectedDictionary; }
     inline static bool hyphenate(const lChar16* str, int len, lUInt16* widths, lUInt8* flags,
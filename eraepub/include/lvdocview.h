@@ -108,47 +108,203 @@ public:
     inline ldomNode * getNode() { return word_.getNode(); }
 };
 
-class PageHitboxesCash
+/// Hitboxes of one page: rects, words as text node index and offsets, and texts pooled in one string
+class PageGeometry
 {
 private:
-    int page_ = -1;
-    LVArray<Hitbox> PageHitboxes_;
+    int page_;
+    CrDom* dom_;
+    /// left, right, top, bottom of each hitbox
+    LVArray<float> rects_;
+    /// word text node data index, 0 for para ends
+    LVArray<lUInt32> nodes_;
+    LVArray<lInt32> starts_;
+    LVArray<lInt32> ends_;
+    /// hitbox text start in pool, with pool length as last item
+    LVArray<lInt32> text_pos_;
+    lString16 text_pool_;
 public:
-    PageHitboxesCash(){};
-    PageHitboxesCash(int page, LVArray<Hitbox> Hitboxes){
-        page_ = page;
-        PageHitboxes_ = Hitboxes;
-    }
-
-    int getPage()
+    PageGeometry(int page, CrDom* dom, const LVArray<Hitbox>& hitboxes);
+
+    int getPage() const { return page_; }
+    int length() const { return nodes_.length(); }
+    float left(int i) const { return rects_.get(i * 4); }
+    float right(int i) const { return rects_.get(i * 4 + 1); }
+    float top(int i) const { return rects_.get(i * 4 + 2); }
+    float bottom(int i) const { return rects_.get(i * 4 + 3); }
+    lString16 text(int i) const
     {
-        return page_;
+        return lString16(text_pool_, text_pos_.get(i), text_pos_.get(i + 1) - text_pos_.get(i));
     }
+    ldomNode* node(int i) const { return nodes_.get(i) ? dom_->getTinyNode(nodes_.get(i)) : NULL; }
+    ldomWord word(int i) const { return ldomWord(node(i), starts_.get(i), ends_.get(i)); }
+    Hitbox get(int i) const { return Hitbox(left(i), right(i), top(i), bottom(i), text(i), word(i)); }
+};
 
-    LVArray<Hitbox> getArray()
-    {
-        return PageHitboxes_;
-    };
+/// Geometry of recently used pages, so requests alternating between pages of
+/// a spread don't recompute hitboxes. Should be reset when layout changes.
+class PageGeometryCache
+{
+private:
+    /// most recently used first
+    LVPtrVector<PageGeometry> pages_;
+public:
+    PageGeometryCache() {};
+    /// returns cached geometry of page, or NULL
+    PageGeometry* find(int page);
+    /// adds geometry, evicts least recently used page if cache is full
+    PageGeometry* add(PageGeometry* geometry);
+    void reset() { pages_.clear(); }
+};
 
-    Hitbox get(int num)
-    {
-        return PageHitboxes_.get(num);
-    }
+/// Text of a page shared by text and search requests. Text node runs, used
+/// to map text offsets to xpointers, are collected on first lookup, so
+/// requests that need only the text don't walk the page twice.
+class PageText
+{
+private:
+    int page_;
+    CrDom* dom_;
+    LVRef<ldomXRange> range_;
+    lString16 text_;
+    lString16 normalized_;
+    lString16 lower_;
+    bool runs_ready_;
+    /// page text offset and length of every text node run
+    LVArray<lInt32> run_pos_;
+    LVArray<lInt32> run_lens_;
+    /// text node data index and offset of the first char of every run
+    LVArray<lUInt32> run_nodes_;
+    LVArray<lInt32> run_offsets_;
+
+    void collectRuns();
+public:
+    PageText(int page, CrDom* dom, LVRef<ldomXRange> range);
+
+    int getPage() const { return page_; }
+    /// text of page range as returned by GetRangeText()
+    const lString16& text() const { return text_; }
+    /// text with unusual spaces replaced by plain ones, offsets are same as in text
+    const lString16& normalized() const { return normalized_; }
+    /// lowercased normalized text
+    const lString16& lower() const { return lower_; }
+    /// xpointer of char at page text offset, null if there is no char there
+    ldomXPointer getXPointer(int pos);
+    /// xpointers of increasing offsets, stops at first offset without char
+    LVArray<ldomXPointer> getXPointers(const LVArray<int>& pos_arr);
+};
 
-    int length() {
-        return PageHitboxes_.length();
-    }
+/// Texts of recently used pages, so search requests looking into the next
+/// page and then searching it don't extract same text again.
+/// Should be reset when layout changes.
+class PageTextCache
+{
+private:
+    /// most recently used first
+    LVPtrVector<PageText> pages_;
+public:
+    PageTextCache() {};
+    /// returns cached text of page, or NULL
+    PageText* find(int page);
+    /// adds text, evicts least recently used page if cache is full
+    PageText* add(PageText* text);
+    void reset() { pages_.clear(); }
+};
 
-    bool isEmpty()
+/// Resolves bookmark and highlight xpointer strings. Children of elements
+/// met on the way are grouped by xpath step once, so a step like p[233]
+/// doesn't count preceding siblings, and resolved strings are interned
+/// together with their pages. Should be reset when layout changes, since
+/// rendering may box inline children into new elements.
+class XPointerIndex
+{
+public:
+    struct Entry
     {
-        return ((page_ == -1) || (PageHitboxes_.empty()));
-    }
+        lUInt32 node;
+        lInt32 offset;
+        /// -1 while page isn't known
+        lInt32 page;
+        Entry() : node(0), offset(0), page(-1) {}
+        Entry(lUInt32 node, lInt32 offset) : node(node), offset(offset), page(-1) {}
+    };
+private:
+    LVHashTable<lString16, int> ids_;
+    LVArray<Entry> entries_;
+    /// child table of element is [table_starts_[i], table_starts_[i] + table_lens_[i])
+    /// in keys_ and nodes_, keys sorted with children of same key in document order
+    LVHashTable<lUInt32, int> tables_;
+    LVArray<lInt32> table_starts_;
+    LVArray<lInt32> table_lens_;
+    LVArray<lUInt32> keys_;
+    LVArray<lUInt32> nodes_;
+
+    int getTable(ldomNode* parent);
+    /// returns child with key of given ordinal, or with count of such children
+    ldomNode* findChild(ldomNode* parent, lUInt32 key, int ordinal, int* count = NULL);
+    ldomXPointer createXPointer(CrDom* dom, const lString16& xpath);
+public:
+    XPointerIndex() : ids_(1024), tables_(1024) {}
+    /// returns entry of xpointer string, NULL if it can't be resolved
+    Entry* find(CrDom* dom, const lString16& xpath);
+    void reset();
+};
 
-    void reset()
+/// Search suggestion phrases of document: words and 2-3 word phrases with
+/// their counts on every page. Pages are tokenized in a single pass when first
+/// requested, phrases are interned once for the whole document.
+class PhraseIndex
+{
+public:
+    struct Posting
     {
-        page_ = -1;
-        PageHitboxes_.reset();
-    }
+        int phrase;
+        int count;
+        Posting() : phrase(0), count(0) {}
+        Posting(int phrase, int count) : phrase(phrase), count(count) {}
+    };
+private:
+    LVHashTable<lString16, int> ids_;
+    lString16Collection phrases_;
+    /// count of phrase on all added pages
+    LVArray<int> totals_;
+    /// phrase ids ordered by phrase for prefix lookup, rebuilt when phrases are added
+    LVArray<int> sorted_;
+    /// postings of page i are [page_starts_[i], page_ends_[i]), both -1 if page isn't added
+    LVArray<int> page_starts_;
+    LVArray<int> page_ends_;
+    LVArray<Posting> postings_;
+    /// posting index + 1 of phrase on current page, 0 if phrase wasn't met there
+    LVArray<int> slots_;
+    LVArray<int> tok_starts_;
+    LVArray<int> tok_lens_;
+    lString16 key_;
+    /// checksum of page list the index was built for
+    lUInt32 layout_;
+    bool modified_;
+
+    int intern(const lString16& phrase);
+    void addPhrase(const lChar16* text, int first, int count);
+public:
+    PhraseIndex() : ids_(4096), layout_(0), modified_(false) {}
+    bool empty() const { return page_starts_.empty(); }
+    bool isModified() const { return modified_; }
+    lUInt32 getLayout() const { return layout_; }
+    void setLayout(lUInt32 layout) { layout_ = layout; }
+    bool hasPage(int page) const { return page < page_starts_.length() && page_starts_[page] >= 0; }
+    /// adds page of lowercased text
+    void addPage(int page, const lString16& text);
+    int pageStart(int page) const { return hasPage(page) ? page_starts_[page] : 0; }
+    int pageEnd(int page) const { return hasPage(page) ? page_ends_[page] : 0; }
+    Posting posting(int i) const { return postings_[i]; }
+    const lString16& phrase(int id) const { return phrases_[id]; }
+    /// finds up to max_count phrases starting with lowercased prefix, most frequent first,
+    /// with their counts on all added pages
+    void findPrefix(const lString16& prefix, int max_count, LVArray<Posting>& result);
+    bool serialize(SerialBuf& buf);
+    /// fails if index was saved for other layout
+    bool deserialize(SerialBuf& buf, lUInt32 layout);
+    void reset();
 };
 
 class SearchResult{
@@ -290,6 +446,11 @@ private:
     int page_; // >=0 is correct page number, < 0 - get based on offset_
     int offset_;  // >=0 is correct vertical offset inside document, < 0 - get based on page_
     bool is_rendered_;
+    // only start of document is laid out, see RenderPrefix()
+    bool layout_incomplete_;
+    // import of big text stopped after its start, see ImportTextPrefix()
+    LVTextParser* txt_import_;
+    LvDomWriter* txt_import_writer_;
     int highlight_bookmarks_;
     lvRect margins_;
     bool show_cover_;
@@ -309,6 +470,12 @@ private:
 
     bool NeedCheckImage();
 
+    /// imports start of big text only, CompleteImport() imports the rest
+    bool ImportTextPrefix();
+    /// imports rest of text after ImportTextPrefix(), layout is to be redone
+    void CompleteImport();
+    void DropImport();
+
 public:
     bool position_is_set_;
     int doc_format_;
@@ -325,8 +492,16 @@ public:
     bool cfg_embeded_fonts_;
     bool cfg_enable_footnotes_;
     bool cfg_firstpage_thumb_;
+    bool cfg_progressive_render_;
     bool cfg_txt_smart_format_;
-    PageHitboxesCash hitboxesCash;
+    PageGeometryCache hitboxesCash;
+    PageTextCache pageTextCash;
+    XPointerIndex xpointerIndex;
+    PhraseIndex phraseIndex;
+    /// directory for suggestion phrases of documents, empty string disables saving them
+    lString16 cfg_phrase_cache_dir_;
+    /// file of suggestion phrases for current document, empty if not saved
+    lString16 phrase_cache_file_;
 
     inline bool IsPagesMode() { return viewport_mode_ == MODE_PAGES; }
     inline bool IsScrollMode() { return viewport_mode_ == MODE_SCROLL; }
@@ -339,6 +514,15 @@ public:
     ldomXPointer getCurrentPageMiddleParagraph();
     /// render document, if not rendered
     void RenderIfDirty();
+    /// lays out only start of document up to saved position, returns estimated pages count;
+    /// CompleteLayout() or any change requesting render lays out the rest
+    int RenderPrefix(const lString16& xpath = lString16::empty_str);
+    /// lays out whole document after RenderPrefix()
+    void CompleteLayout();
+    /// lays out whole document if page is past laid out prefix
+    void CompleteLayoutForPage(int page);
+    bool IsLayoutIncomplete() { return layout_incomplete_; }
+    bool IsImportIncomplete() { return txt_import_ != NULL; }
     /// sets new list of bookmarks, removes old values
     void SetBookmarks(LVPtrVector<CRBookmark>& bookmarks);
     /// find bookmark by window point, return NULL if point doesn't belong to any bookmark
@@ -374,8 +558,12 @@ public:
     void UpdateBookmarksRanges();
     /// get page document range, -1 for current page
     LVRef<ldomXRange> GetPageDocRange(int page_index = -1 , bool one_column = false);
+    /// decodes JPEG images on pages next to current one ahead on worker thread
+    void PrewarmPageImages();
     /// get page text, -1 for current page
     lString16 GetPageText(int page_index = -1);
+    /// returns cached text of page, -1 for current page
+    PageText& GetPageTextData(int page_index = -1);
     int GetColumns();
     void UpdatePageMargins();
     /// returns pointer to TOC root node
@@ -406,6 +594,10 @@ public:
     void SetBookmark(ldomXPointer bm);
     /// moves position to bookmark
     void GoToBookmark(ldomXPointer bm);
+    /// get page number by bookmark string, -1 if it can't be resolved
+    int GetPageForXPath(const lString16& xpath);
+    /// returns xpointer of bookmark string, resolved through xpointer index
+    ldomXPointer CreateXPointer(const lString16& xpath);
     /// get page number by bookmark
     int GetPageForBookmark(ldomXPointer bm);
     /// get bookmark position text
@@ -454,6 +646,8 @@ public:
     LVArray<Hitbox> GetPageLinks();
     //returns array of Hitbox objects that contain hitbox info about characters on current docview page
     LVArray<Hitbox> GetPageHitboxes(ldomXRange *in_range = NULL, bool rtl_enable = true, bool rtl_space = true);
+    //returns cached hitboxes of page, moves to page if they are not cached
+    const PageGeometry& GetPageGeometry(int page);
     //returns array of lvRects, that contains info about image location on current docview page
     LVArray<ImgRect> GetPageImages(int page = -1, image_display_t type = img_all);
     //rewrites imgheight and imgwidth to corresponding values of scaled image.
@@ -461,9 +655,9 @@ public:
     font_ref_t GetBaseFont();
 
     lString16   GetHitboxHash(float l,float r,float t,float b);
-    ldomWord    FindldomWordFromMap(ldomWordMap m, lString16 key);
+    ldomWord    FindldomWordFromMap(const ldomWordMap& m, lString16 key);
     ldomWordMap GetldomWordMapFromPage(int page);
-    lString16 GetXpathByRectCoords(lString16 key, ldomWordMap m);
+    lString16 GetXpathByRectCoords(lString16 key, const ldomWordMap& m);
 
     LVDocView();
     ~LVDocView();
@@ -487,10 +681,10 @@ public:
 
     LVArray<SearchResult> SearchForTextPreviews(int page, lString16 query);
 
-    SearchResult FindAndTrimNextPage(lString16 text, lString16 query, int page, int start_last);
+    SearchResult FindAndTrimNextPage(PageText& page_text, lString16 query, int start_last);
 
 
-    LVArray<SearchResult> FindAndTrim(lString16 text, lString16 query, bool IgnoreCase, int page, int &end);
+    LVArray<SearchResult> FindAndTrim(PageText& page_text, lString16 query, bool IgnoreCase, int &end);
 
     LVArray<TextRect> GetSearchHitboxesNextPage(LVArray<ldomWord> base1, int page, lString16 query);
     int GetSearchHitboxesNextPageLite(int page, lString16 query);
@@ -499,7 +693,10 @@ public:
     bool checkBeforePrevPage(LVArray<ldomWord> base, lString16 query);
 
     lString16Map GetWordsIndexesMap();
-    lString16Map GetPhrasesIndexesMapForPage(int page_index);
+    /// returns suggestion phrases index with pages [page_start, page_end) added to it
+    PhraseIndex& GetPhrasesIndex(int page_start, int page_end);
+    /// writes suggestion phrases index to phrase_cache_file_ if it has changed
+    void SavePhrasesIndex();
 
     LVArray<Hitbox> unionRects(LVArray<Hitbox> rects);
 
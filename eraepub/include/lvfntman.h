@@ -27,6 +27,34 @@ class LVDrawBuf;
 
 struct LVFontGlyphCacheItem;
 
+#define GLYPH_SLAB_SIZE 0x10000
+#define GLYPH_SIZE_CLASS_STEP 32
+// Items bigger than GLYPH_SIZE_CLASS_STEP * GLYPH_SIZE_CLASS_COUNT bytes are malloced
+#define GLYPH_SIZE_CLASS_COUNT 64
+
+/// Packs glyph items into big slabs, freed items are reused by items of same size class
+class LVFontGlyphSlabAllocator
+{
+private:
+    void * free_lists[GLYPH_SIZE_CLASS_COUNT];
+    LVArray<lUInt8 *> slabs;
+    lUInt8 * slab_pos;
+    int slab_left;
+public:
+    LVFontGlyphSlabAllocator() : slab_pos(NULL), slab_left(0)
+    {
+        memset( free_lists, 0, sizeof(free_lists) );
+    }
+    ~LVFontGlyphSlabAllocator()
+    {
+        clear();
+    }
+    void * alloc( int size );
+    void free( void * ptr, int size );
+    /// releases all slabs, there must be no allocated items
+    void clear();
+};
+
 class LVFontGlobalGlyphCache
 {
 private:
@@ -34,6 +62,7 @@ private:
     LVFontGlyphCacheItem * tail;
     int size;
     int max_size;
+    LVFontGlyphSlabAllocator allocator;
     void removeNoLock( LVFontGlyphCacheItem * item );
     void putNoLock( LVFontGlyphCacheItem * item );
 public:
@@ -49,8 +78,14 @@ public:
     void remove( LVFontGlyphCacheItem * item );
     void refresh( LVFontGlyphCacheItem * item );
     void clear();
+    void * allocItem( int sz ) { return allocator.alloc( sz ); }
+    void freeItem( void * ptr, int sz ) { allocator.free( ptr, sz ); }
 };
 
+#define GLYPH_INDEX_PAGE_SHIFT 9
+#define GLYPH_INDEX_PAGE_SIZE (1 << GLYPH_INDEX_PAGE_SHIFT)
+#define GLYPH_INDEX_PAGE_COUNT (0x10000 >> GLYPH_INDEX_PAGE_SHIFT)
+
 class LVFontLocalGlyphCache
 {
 private:
@@ -58,18 +93,27 @@ private:
     LVFontGlyphCacheItem * tail;
     LVFontGlobalGlyphCache * global_cache;
     int size;
+    // Items by char, allocated by pages of GLYPH_INDEX_PAGE_SIZE chars
+    LVFontGlyphCacheItem * * index[GLYPH_INDEX_PAGE_COUNT];
 public:
     LVFontLocalGlyphCache( LVFontGlobalGlyphCache * globalCache )
         : head(NULL), tail(NULL), global_cache( globalCache )
-    { }
+    {
+        memset( index, 0, sizeof(index) );
+    }
     ~LVFontLocalGlyphCache()
     {
         clear();
+        for ( int i=0; i<GLYPH_INDEX_PAGE_COUNT; i++ ) {
+            if ( index[i] )
+                delete [] index[i];
+        }
     }
     void clear();
     LVFontGlyphCacheItem * get( lUInt16 ch );
     void put( LVFontGlyphCacheItem * item );
     void remove( LVFontGlyphCacheItem * item );
+    LVFontGlobalGlyphCache * getGlobalCache() { return global_cache; }
 };
 
 class LVFontGlyphCacheItem
@@ -98,8 +142,8 @@ public:
     }
     static LVFontGlyphCacheItem * newItem( LVFontLocalGlyphCache * local_cache, lChar16 ch, int w, int h )
     {
-        LVFontGlyphCacheItem * item = (LVFontGlyphCacheItem *)malloc( sizeof(LVFontGlyphCacheItem)
-            + (w*h - 1)*sizeof(lUInt8) );
+        LVFontGlyphCacheItem * item = (LVFontGlyphCacheItem *)local_cache->getGlobalCache()->allocItem(
+            sizeof(LVFontGlyphCacheItem) + (w*h - 1)*sizeof(lUInt8) );
         item->ch = ch;
         item->bmp_width   = (lUInt8)w;
         item->bmp_height  = (lUInt8)h;
@@ -118,7 +162,7 @@ public:
     }
     static void freeItem( LVFontGlyphCacheItem * item )
     {
-        free( item );
+        item->local_cache->getGlobalCache()->freeItem( item, item->getSize() );
     }
 };
 
@@ -144,7 +188,7 @@ public:
         lUInt8  blackBoxY;   ///< 1: height of glyph black box
         lInt8   originX;     ///< 2: X origin for glyph
         lInt8   originY;     ///< 3: Y origin for glyph
-        lUInt8  width;       ///< 4: full width of glyph
+        lUInt16 width;       ///< 4: full width of glyph
     };
 
     virtual unsigned int getCharIndex( lChar16 code, lChar16 def_char ) =0;// { return 0;};
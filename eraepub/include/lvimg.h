@@ -59,6 +59,10 @@ public:
     virtual int    GetWidth() = 0;
     virtual int    GetHeight() = 0;
     virtual bool   Decode( LVImageDecoderCallback * callback ) = 0;
+    /// returns largest reduction (1, 2, 4 or 8) decoder can do cheaply keeping image at least dx*dy
+    virtual int    GetDecodeScale( int, int ) { return 1; }
+    /// decodes image reduced by scale from GetDecodeScale(), rows are (GetWidth()+scale-1)/scale wide
+    virtual bool   DecodeScaled( LVImageDecoderCallback * callback, int scale ) { return scale == 1 && Decode( callback ); }
     LVImageSource() : _ninePatch(NULL) {}
     virtual ~LVImageSource();
 };
@@ -115,6 +119,49 @@ LVImageSourceRef LVCreateColorTransformImageSource(LVImageSourceRef srcImage,
 /// (0 is no change, 255 is totally transparent)
 LVImageSourceRef LVCreateAlphaTransformImageSource(LVImageSourceRef srcImage, int alpha);
 
+// Max total size of decoded document images kept scaled to drawing size
+#define IMAGE_SURFACE_CACHE_SIZE (16*1024*1024)
+
+class LVImageSurfaceWorker;
+
+/// Document images decoded and scaled to the size they are drawn at, so redrawing
+/// a page doesn't decode them again. Items are kept in LRU order, limited by total size.
+/// JPEG images of nearby pages can be decoded ahead of time on worker thread.
+class LVImageSurfaceCache
+{
+    struct Item {
+        lUInt32 node;  // data index of image node
+        int dx;        // 0 for image decoded ahead and not scaled yet
+        int dy;
+        LVColorDrawBuf * buf;
+        Item * prev;
+        Item * next;
+    };
+    Item * _head;
+    Item * _tail;
+    int _size;
+    int _maxSize;
+    LVImageSurfaceWorker * _worker;
+    Item * find( lUInt32 node, int dx, int dy );
+    void moveToHead( Item * item );
+    void remove( Item * item );
+    void add( lUInt32 node, int dx, int dy, LVColorDrawBuf * buf );
+    /// moves images decoded by worker to cache
+    void collect();
+public:
+    LVImageSurfaceCache( int maxSize = IMAGE_SURFACE_CACHE_SIZE );
+    ~LVImageSurfaceCache();
+    /// returns image of node scaled to dx*dy, decodes it if not cached yet;
+    /// returns source image itself if it's too large to cache, null if node has no image
+    LVImageSourceRef get( ldomNode * node, int dx, int dy );
+    /// queues decoding of node JPEG image on worker thread, reduced to not less than
+    /// maxDx*maxDy; images of other formats are left to be decoded when drawn
+    void prewarm( ldomNode * node, int maxDx, int maxDy );
+    /// drops queued decoding requests which are not started yet
+    void cancelPrewarm();
+    void clear();
+};
+
 class LVFont;
 class LVDrawBuf;
 
@@ -511,6 +511,25 @@ public:
     virtual ~LVContainerItemInfo() {}
 };
 
+/// Packed data of archive item. Read by the thread owning the archive, then
+/// inflated with LVInflatePackedItem, which can run on any thread.
+struct LVPackedItem
+{
+    lUInt8 * packed;
+    lUInt32  packSize;
+    lUInt32  unpSize;
+    int      method;   ///< 0 stored, 8 deflate
+    lUInt8 * data;     ///< unpacked data, unpSize bytes
+    LVPackedItem() : packed(NULL), packSize(0), unpSize(0), method(0), data(NULL) {}
+    ~LVPackedItem() { free(packed); free(data); }
+private:
+    LVPackedItem(const LVPackedItem &);
+    LVPackedItem & operator = (const LVPackedItem &);
+};
+
+/// Unpacks item read with LVContainer::ReadPackedItem, uses only zlib and plain buffers
+bool LVInflatePackedItem(LVPackedItem & item);
+
 class LVContainer : public LVStorageObject
 {
 public:
@@ -521,6 +540,8 @@ public:
     virtual int GetObjectCount() const = 0;
     virtual LVStreamRef OpenStream( const lChar16 * fname, lvopen_mode_t mode ) = 0;
     virtual LVStreamRef OpenStreamByPackedSize(uint32_t size) = 0;
+    /// Reads packed data of item, false if container can't provide it (use OpenStream then)
+    virtual bool ReadPackedItem(const lChar16 * /*fname*/, LVPackedItem & /*item*/) { return false; }
     LVContainer() {}
     virtual ~LVContainer() { }
 };
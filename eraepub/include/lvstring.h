@@ -129,6 +129,14 @@ void lStr_uppercase( lChar16 * str, int len );
 void lStr_lowercase( lChar16 * str, int len );
 /// calculates CRC32 for buffer contents
 lUInt32 lStr_crc32( lUInt32 prevValue, const void * buf, int size );
+/// logs string allocation counters collected since previous call, if STRING_ALLOC_STATS is enabled
+void lStr_dumpAllocStats( const char * title );
+/// returns length of leading run of plain ASCII bytes (1..127)
+int lStr_asciiLength( const lUInt8 * src, int len );
+/// widens leading run of plain ASCII bytes (1..127), returns number of converted chars
+int lStr_decodeAscii( const lUInt8 * src, int len, lChar16 * dst );
+/// narrows leading run of plain ASCII chars (1..127), returns number of converted chars
+int lStr_encodeAscii( const lChar16 * src, int len, lUInt8 * dst );
 
 // converts 0..15 to 0..f
 char toHexDigit( int c );
@@ -165,6 +173,10 @@ private:
     // Chunk allocation functions
     static lstring8_chunk_t* alloc();
     static void free(lstring8_chunk_t* pChunk);
+    /// true if chars are stored in the same block right after chunk
+    bool isInline() const { return buf8 == (lChar8 *)(this + 1); }
+    /// sets buffer capacity to n chars plus terminating zero, keeps first len+1 chars
+    void resizeBuffer(lInt32 n);
 };
 
 struct lstring16_chunk_t {
@@ -185,6 +197,10 @@ private:
     // Chunk allocation functions
     static lstring16_chunk_t* alloc();
     static void free(lstring16_chunk_t* pChunk);
+    /// true if chars are stored in the same block right after chunk
+    bool isInline() const { return buf16 == (lChar16 *)(this + 1); }
+    /// sets buffer capacity to n chars plus terminating zero, keeps first len+1 chars
+    void resizeBuffer(lInt32 n);
 };
 
 namespace fmt {
@@ -135,6 +135,8 @@ public:
     bool parse(const char* &str, CrDomXml* doc);
     lUInt16 getElementNameId() { return _id; }
     bool check(const ldomNode* node ) const;
+    /// true if rules look only at class of node itself, not at its attributes or neighbours
+    bool isContextFree() const;
     void applyCss(const ldomNode* node, css_style_rec_t* style) const
     {
         _decl->apply(node, style);
@@ -176,6 +178,18 @@ private:
     void set(LVPtrVector<LVCssSelector>& v);
 
     CssSelectorMap selectorMap_;
+
+    /// Selector chains for one element name and class value pair
+    struct ClassMatch
+    {
+        LVCssSelector* selector_class;
+        bool context_free;
+    };
+    /// Keyed by element id and interned class value index of document
+    std::map<lUInt32, ClassMatch> classMatchMap_;
+    /// Changes every time selectors change
+    lUInt32 generation_;
+    const ClassMatch& getClassMatch(const ldomNode* node);
 public:
     /// save current state of stylesheet
     void push() { _stack.add(dup()); }
@@ -197,17 +211,24 @@ public:
         _selectors.clear();
         _stack.clear();
         selectorMap_.clear();
+        classMatchMap_.clear();
+        generation_++;
     }
     /// set document to retrieve ID values from
     void setDocument(CrDomXml* doc) { _doc = doc; }
     /// constructor
-    LVStyleSheet(CrDomXml* doc = NULL ) : _doc(doc) { }
+    LVStyleSheet(CrDomXml* doc = NULL ) : _doc(doc), generation_(0) { }
     /// copy constructor
     LVStyleSheet(LVStyleSheet& sheet);
     /// parse stylesheet, compile and add found rules to sheet
     bool parse(const char* str );
     /// apply stylesheet to node style
     void applyCss(const ldomNode* node, css_style_rec_t* style );
+    /// true if style applied to node depends only on its element name and class value,
+    /// so computed style can be shared between such nodes with same parent style
+    bool isContextFree(const ldomNode* node) { return getClassMatch(node).context_free; }
+    /// returns value which changes every time rules of stylesheet change
+    lUInt32 getGeneration() { return generation_; }
 
     /// calculate hash
     lUInt32 getHash();
@@ -98,6 +98,7 @@ typedef enum {
 	xpath_step_point      // point index                                .N
 } xpath_step_t;
 xpath_step_t ParseXPathStep( const lChar8 * &path, lString8 & name, int & index );
+xpath_step_t ParseXPathStep( const lChar16 * &path, lString16 & name, int & index );
 
 // mode: 0=disabled, 1=integer scaling factors, 2=free scaling
 // scale: 0=auto based on font size, 1=no zoom, 2=scale up to *2, 3=scale up to *3
@@ -156,6 +157,43 @@ struct ldomNodeStyleInfo
     lUInt16 _styleIndex;
 };
 
+/// Computed style inputs of element whose matching selectors don't look at siblings,
+/// ancestors or attributes other than class
+struct ldomStyleShareKey
+{
+    const css_style_rec_t* parent;
+    lUInt16 id;
+    lUInt16 class_index;
+    lUInt16 style_index;
+    int base_font_size;
+    int embedded_lvl;
+    lUInt32 sheet_generation;
+    lUInt32 getHash() const;
+    bool operator == (const ldomStyleShareKey& v) const;
+};
+
+#define STYLE_SHARE_CACHE_SIZE 1024
+
+/// Direct mapped cache of computed styles, so elements like hundreds of thousands
+/// of <p class="calibre1"> under same parent style skip stylesheet matching
+class ldomStyleShareCache
+{
+    struct Item
+    {
+        ldomStyleShareKey key;
+        // Keeps parent style alive, key compares its pointer
+        css_style_ref_t parent;
+        css_style_ref_t style;
+    };
+    Item* items_;
+public:
+    ldomStyleShareCache() : items_(NULL) { }
+    ~ldomStyleShareCache() { clear(); }
+    css_style_ref_t get(const ldomStyleShareKey& key);
+    void put(const ldomStyleShareKey& key, css_style_ref_t parent, css_style_ref_t style);
+    void clear();
+};
+
 class ldomBlobItem;
 #define BLOB_NAME_PREFIX L"@blob#"
 #define MOBI_IMAGE_NAME_PREFIX L"mobi_image_"
@@ -169,6 +207,26 @@ public:
     LVStreamRef getBlob( lString16 name );
 };
 
+/// Codecs for storage chunks unloaded from memory
+enum ldomStorageCodec {
+    STORAGE_CODEC_NONE = 0, ///< raw copy, for spill file
+    STORAGE_CODEC_FAST = 1, ///< LZ4 style byte oriented LZ77, cheap to unpack on every chunk fault
+    STORAGE_CODEC_ZLIB = 2  ///< deflate with DOC_DATA_COMPRESSION_LEVEL, smallest and slowest
+};
+
+/// Counters of chunks unloaded from memory and loaded back
+struct ldomStorageStats
+{
+    int packCount;
+    int unpackCount;
+    lInt64 packedBytes;   ///< data size of unloaded chunks
+    lInt64 packedResult;  ///< their size after packing
+    lInt64 unpackedBytes; ///< data size of chunks loaded back
+    lInt64 spilledBytes;  ///< packed bytes written to spill file
+};
+
+class ldomSpillFile;
+
 class ldomDataStorageManager
 {
     friend class ldomTextStorageChunk;
@@ -181,11 +239,28 @@ protected:
     int _maxUncompressedSize;
     int _chunkSize;
     char _type;       /// type, to show in log
+    int _codec;
+    ldomSpillFile * _spill;
+    bool _spillFailed;
+    ldomStorageStats _stats;
+    static int _defaultCodec;
+    static lString8 _spillDir;
     ldomTextStorageChunk * getChunk( lUInt32 address );
+    /// packs chunk data to memory or spill file and frees its buffer
+    bool swapOut( ldomTextStorageChunk * chunk );
+    /// unpacks data of unloaded chunk back to its buffer
+    bool swapIn( ldomTextStorageChunk * chunk );
 public:
-    /// checks buffer sizes, compacts most unused chunks
-    void compact( int reservedSpace );
+    /// sets codec for storages of documents created later
+    static void setCodec( int codec ) { _defaultCodec = codec; }
+    /// sets spill file directory for storages of documents created later, empty to keep packed chunks in memory
+    static void setSpillDir( const lString8 & dir ) { _spillDir = dir; }
+    /// checks buffer sizes, unloads least recently used chunks except specified one
+    void compact( int reservedSpace, ldomTextStorageChunk * except = NULL );
     int getUncompressedSize() { return _uncompressedSize; }
+    const ldomStorageStats & getStats() { return _stats; }
+    /// logs chunk traffic counters
+    void dumpStats();
     /// allocates new text node, return its address inside storage
     lUInt32 allocText( lUInt32 dataIndex, lUInt32 parentIndex, const lString8 & text );
     /// allocates storage for new element, returns address address inside storage
@@ -194,6 +269,9 @@ public:
     lString8 getText( lUInt32 address );
     /// get pointer to element data
     ElementDataStorageItem * getElem( lUInt32 addr );
+    /// get pointer to element data, which stays valid while other nodes are accessed until unpinElem()
+    ElementDataStorageItem * pinElem( lUInt32 addr );
+    void unpinElem( lUInt32 addr );
     /// change node's parent, returns true if modified
     bool setParent( lUInt32 address, lUInt32 parent );
     /// returns node's parent by address
@@ -233,6 +311,13 @@ class ldomTextStorageChunk
     lUInt32 _bufpos;  /// _buf (uncompressed) data write position (for appending of new data)
     lUInt16 _index;  /// ? index of chunk in storage
     char _type;       /// type, to show in log
+    lUInt8 * _compbuf;        /// packed data of unloaded chunk kept in memory
+    lUInt32 _compsize;        /// packed data size
+    lUInt32 _spillOffset;     /// packed data position in spill file
+    lUInt32 _spillCapacity;   /// space reserved in spill file, 0 if none
+    lUInt8 _codec;            /// codec of packed data
+    bool _saved;              /// buffer is unloaded, its data is packed
+    int _pinCount;            /// pointers into buffer are held, it can't be unloaded
 
     void setunpacked( const lUInt8 * buf, int bufsize );
     /// free data item
@@ -291,6 +376,7 @@ private:
     ldomNode * _elemList[TNC_PART_COUNT];
     LVIndexedRefCache<css_style_ref_t> _styles;
     LVIndexedRefCache<font_ref_t> _fonts;
+    ldomStyleShareCache _styleShareCache;
     int _tinyElementCount;
     int _itemCount;
     int _docIndex;
@@ -371,6 +457,7 @@ public:
     void dumpStatistics();
 
     lUInt32 calcStyleHashFull();
+    inline ldomStyleShareCache& getStyleShareCache() { return _styleShareCache; }
 };
 
 class CrDom;
@@ -528,6 +615,8 @@ public:
     int getAttrCount() const;
     /// returns attribute value by attribute name id and namespace id
     const lString16 & getAttributeValue( lUInt16 nsid, lUInt16 id ) const;
+    /// returns interned attribute value index, LXML_ATTR_VALUE_NONE if there is no such attribute
+    lUInt16 getAttributeValueIndex( lUInt16 nsid, lUInt16 id ) const;
     /// returns attribute value by attribute name
     inline const lString16 & getAttributeValue( const lChar16 * attrName ) const
     {
@@ -1438,10 +1527,6 @@ public:
     lString16 GetRangeText( lChar16 blockDelimiter='\n', int maxTextLen=0 );
 
     void getRangeWordsNoRect(LVArray<ldomWord> &words_list);
-
-    LVArray<ldomXPointer> getXpointerByOffsetInPageText(LVArray<int> pos_arr);
-
-    ldomXPointer getXpointerByOffsetInPageText(int pos);
 };
 
 class ldomMarkedText
@@ -1684,10 +1769,17 @@ private:
     int _page_height;
     int _page_width;
     bool _rendered;
+    // Final blocks to lay out by renderPrefix(), 0 for whole document
+    int _render_prefix_blocks;
+    // Node whose DocFragment is always laid out by renderPrefix()
+    ldomNode * _render_prefix_node;
+    int _render_estimated_pages;
+    int hideFragmentsAfter(int max_blocks, ldomNode * keep, LVArray<ldomNode*> & hidden);
     ldomXRangeList _selections;
     LVContainerRef _container;
     LVHashTable<lUInt32, ListNumberingPropsRef> lists;
     LVEmbeddedFontList _fontList;
+    LVImageSurfaceCache _imageSurfaceCache;
 protected:
     void applyDocStylesheet();
 public:
@@ -1707,6 +1799,8 @@ public:
         _hdr.render_style_hash = 0;
         _rendered = false;
     }
+    /// makes next render lay out document again, after nodes were added to rendered one
+    void dropRendered() { _rendered = false; }
     ListNumberingPropsRef getNodeNumberingProps( lUInt32 nodeDataIndex );
     void setNodeNumberingProps( lUInt32 nodeDataIndex, ListNumberingPropsRef v );
     void resetNodeNumberingProps();
@@ -1714,6 +1808,8 @@ public:
     LVStreamRef getObjectImageStream( lString16 refName );
     /// returns object image source
     LVImageSourceRef getObjectImageSource( lString16 refName );
+    /// returns cache of images scaled to drawing size
+    LVImageSurfaceCache & getImageSurfaceCache() { return _imageSurfaceCache; }
     bool isDefStyleSet() { return !_def_style.isNull(); }
     /// return document's embedded font list
     LVEmbeddedFontList & getEmbeddedFontList() { return _fontList; }
@@ -1747,6 +1843,11 @@ public:
     /// renders (formats) document in memory
     virtual int render(LVRendPageList* pages, int width, int dy,
     		bool showCover, int y0, font_ref_t def_font, int def_interline_space );
+    /// lays out only leading DocFragments with about max_blocks final blocks, and up to
+    /// the one holding keep node if it is deeper; next render() lays out whole document;
+    /// returns estimated pages count, 0 if whole document was laid out
+    int renderPrefix(LVRendPageList* pages, int width, int dy, bool showCover, int y0,
+            font_ref_t def_font, int def_interline_space, int max_blocks, ldomNode * keep);
     /// renders (formats) document in memory
     virtual bool
     setRenderProps(int width, int height, font_ref_t def_font, int def_interline_space);
@@ -1859,6 +1960,9 @@ public:
     		const lChar16* attrname, const lChar16* attrvalue);
     /// close tags
     ldomElementWriter* pop(ldomElementWriter* obj, lUInt16 id);
+    /// inits styles and render methods of elements still open, for rendering
+    /// document before parser writes the rest of it
+    void initOpenElements();
     virtual void OnText(const lChar16* text, int len, lUInt32 flags);
     /// add named BLOB data to document
     virtual bool OnBlob(lString16 name, const lUInt8 * data, int size)
@@ -38,6 +38,15 @@ typedef std::map<lUInt32,int> Headermap;
 //class LvXmlParser;
 class LVFileFormatParser;
 
+/// Links and footnotes collected over all fragments of one document import.
+/// Parsers of every fragment reference the same context and append to it in place.
+struct LvImportContext
+{
+    LVArray<LinkStruct> linksList;
+    LinksMap linksMap;
+    Epub3Notes epub3Notes;
+};
+
 class tinyNode;
 class ldomNode;
 
@@ -301,11 +310,17 @@ public:
     virtual ~LVTextFileBase();
 };
 
+class LVTextLineQueue;
+
 class LVTextParser : public LVTextFileBase {
 protected:
     LvXMLParserCallback* m_callback;
     bool smart_format_;
     bool firstpage_thumb_;
+    int block_limit_;
+    // Line queue of import stopped at block limit, NULL if text is imported
+    LVTextLineQueue* queue_;
+    void closeDocument();
 public:
 	/// constructor
     LVTextParser(LVStreamRef stream, LvXMLParserCallback* callback, bool smart_format,
@@ -316,6 +331,14 @@ public:
     virtual bool CheckFormat();
     /// parses input stream
     virtual bool Parse();
+    /// makes Parse() stop after given count of paragraphs, leaving body open, 0 for no limit
+    void SetBlockLimit(int block_limit) { block_limit_ = block_limit; }
+    /// true if Parse() stopped at block limit and ParseRest() is to be called
+    bool IsStopped() { return queue_ != NULL; }
+    /// imports text following the paragraphs imported by Parse() and closes document
+    bool ParseRest();
+    /// stream position Parse() reached
+    lvpos_t GetParsedPos() { return m_buf_fpos + m_buf_pos; }
 
     virtual bool ParseDocx(DocxItems docxItems,DocxLinks docxLinks, DocxStyles docxStyles) { return false; };
 
@@ -337,11 +360,13 @@ private:
     Tagmap m_;
     bool tags_init_ = false;
     EpubItems * EpubNotes_;
-    LVArray<LinkStruct> LinksList_;
-    LinksMap LinksMap_;
-    Epub3Notes Epub3Notes_;
+    LvImportContext ownContext_;
+    // ownContext_ unless shared with setImportContext
+    LvImportContext * context_;
     bool Notes_exists = false;
-    EpubStylesManager EpubStylesManager_;
+    EpubStylesManager ownStylesManager_;
+    // Owned by document, read only here
+    EpubStylesManager * EpubStylesManager_;
     std::map<lUInt32,lString16> fb3RelsMap_;
 protected:
     bool possible_capitalized_tags_;
@@ -360,11 +385,13 @@ public:
     //highly modified xml parser for epub footnotes parsing
     virtual bool ParseEpubFootnotes();
     //add epub notes list for parser
-    void setEpubNotes(EpubItems epubItems);
+    void setEpubNotes(EpubItems & epubItems);
+    /// links and notes are appended to context, which must outlive parser
+    void setImportContext(LvImportContext * context);
 
-    void setLinksList(LVArray<LinkStruct> LinksList);
+    void setLinksList(const LVArray<LinkStruct> & LinksList);
 
-    LVArray<LinkStruct> getLinksList();
+    const LVArray<LinkStruct> & getLinksList();
 
     /// sets charset by name
     virtual void SetCharset(const lChar16* name);
@@ -390,17 +417,17 @@ public:
 
     bool ReadTextToString(lString16 &output, bool write_to_tree, bool rtl_force_check = false);
 
-    void setLinksMap(LinksMap LinksMap);
+    void setLinksMap(const LinksMap & LinksMap);
 
-    LinksMap getLinksMap();
+    const LinksMap & getLinksMap();
 
-    void setEpub3Notes(Epub3Notes Epub3Notes);
+    void setEpub3Notes(const Epub3Notes & Epub3Notes);
 
-    Epub3Notes getEpub3Notes();
+    const Epub3Notes & getEpub3Notes();
 
-    void setStylesManager(EpubStylesManager manager);
+    void setStylesManager(EpubStylesManager & manager);
 
-    EpubStylesManager getStylesManager();
+    EpubStylesManager & getStylesManager();
 
     bool odtTagAllowed(lString16 tagname);
 
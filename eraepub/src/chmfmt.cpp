@@ -3,6 +3,21 @@
 #include "chmlib/src/chm_lib.h"
 #include "include/crconfig.h"
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <set>
+#include <vector>
+
+// Upper limit of decompressed topic data waiting for the parser
+#define CHM_PREFETCH_BUDGET (8 * 1024 * 1024)
+#define CHM_PREFETCH_MAX_THREADS 4
+// Size of chmlib decompressed block cache while topics are prefetched
+#define CHM_BLOCK_CACHE_BUDGET (4 * 1024 * 1024)
+// CHM_MAX_BLOCKS_CACHED of chmlib, cache is shrunk back to it after import
+#define CHM_BLOCK_CACHE_DEFAULT 5
+
 struct crChmExternalFileStream : public chmExternalFileStream {
     /** returns file size, in bytes, if opened successfully */
     //LONGUINT64 (open)( chmExternalFileStream * instance );
@@ -219,6 +234,19 @@ public:
     LVCHMContainer(LVStreamRef s) : _stream(s), _file(NULL)
     {
     }
+    chmFile * getFile()
+    {
+        return _file;
+    }
+    /// Resolves object by the same name as OpenStream takes
+    bool resolve( const wchar_t * fname, chmUnitInfo * ui )
+    {
+        lString16 fn(fname);
+        if ( fn[0]!='/' )
+            fn = cs16("/") + fn;
+        memset(ui, 0, sizeof(chmUnitInfo));
+        return CHM_RESOLVE_SUCCESS==chm_resolve_object(_file, UnicodeToUtf8(fn).c_str(), ui);
+    }
     virtual ~LVCHMContainer()
     {
         SetName(NULL);
@@ -966,6 +994,149 @@ static int filename_comparator(lString16 & _s1, lString16 & _s2) {
     return s1.compare(s2);
 }
 
+/// Decompresses LZX reset intervals of topics on worker threads ahead of the parser.
+/// Compressed data reads and block cache updates stay on the importing thread,
+/// workers only run LZX on plain buffers. Blocks missing in the cache are
+/// decompressed by chmlib on demand as before.
+class CHMIntervalPrefetch
+{
+private:
+    enum { ITEM_QUEUED, ITEM_READY, ITEM_FAILED };
+    chmFile * file_;
+    // Intervals in order of first use by topics
+    std::vector<LONGUINT64> intervals_;
+    // Count of intervals_ needed to read topics up to i inclusive
+    std::vector<int> topic_end_;
+    std::vector<chmLzxInterval*> items_;
+    std::vector<int> state_;
+    std::deque<int> queue_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stop_ = false;
+    bool cache_resized_ = false;
+    int next_read_ = 0;
+    int next_cache_ = 0;
+    lUInt32 pending_size_ = 0;
+
+    void work()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            cond_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (stop_)
+                return;
+            int i = queue_.front();
+            queue_.pop_front();
+            chmLzxInterval * iv = items_[i];
+            lock.unlock();
+            bool ok = chm_decompress_interval(iv) != 0;
+            lock.lock();
+            state_[i] = ok ? ITEM_READY : ITEM_FAILED;
+            cond_.notify_all();
+        }
+    }
+
+    void fill()
+    {
+        while (next_read_ < (int)intervals_.size() && pending_size_ < CHM_PREFETCH_BUDGET) {
+            int i = next_read_++;
+            chmLzxInterval * iv = new chmLzxInterval;
+            bool ok = chm_read_interval(file_, intervals_[i], iv) != 0;
+            if (ok && !cache_resized_) {
+                // Default cache of 5 blocks can't hold even one interval of a topic
+                int blocks = CHM_BLOCK_CACHE_BUDGET / iv->block_len;
+                if (blocks > iv->block_count)
+                    chm_set_param(file_, CHM_PARAM_MAX_BLOCKS_CACHED, blocks);
+                cache_resized_ = true;
+            }
+            if (!ok)
+                iv->block_count = 0;
+            std::lock_guard<std::mutex> lock(mutex_);
+            items_[i] = iv;
+            if (ok) {
+                state_[i] = ITEM_QUEUED;
+                queue_.push_back(i);
+                pending_size_ += iv->block_count * iv->block_len;
+                cond_.notify_all();
+            } else {
+                state_[i] = ITEM_FAILED;
+            }
+        }
+    }
+public:
+    CHMIntervalPrefetch(LVCHMContainer * cont, lString16Collection & topics, int threads)
+        : file_(cont->getFile())
+    {
+        std::set<LONGUINT64> seen;
+        for (int i = 0; i < topics.length(); i++) {
+            chmUnitInfo ui;
+            LONGUINT64 first, last;
+            if (cont->resolve(topics[i].c_str(), &ui) && ui.space == CHM_COMPRESSED && ui.length > 0
+                    && chm_get_interval(file_, ui.start, &first)
+                    && chm_get_interval(file_, ui.start + ui.length - 1, &last)) {
+                for (LONGUINT64 n = first; n <= last; n++) {
+                    if (seen.insert(n).second)
+                        intervals_.push_back(n);
+                }
+            }
+            topic_end_.push_back((int)intervals_.size());
+        }
+        items_.resize(intervals_.size(), NULL);
+        state_.resize(intervals_.size(), ITEM_FAILED);
+        for (int i = 0; i < threads; i++)
+            threads_.push_back(std::thread(&CHMIntervalPrefetch::work, this));
+    }
+
+    ~CHMIntervalPrefetch()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+            cond_.notify_all();
+        }
+        for (size_t i = 0; i < threads_.size(); i++)
+            threads_[i].join();
+        for (size_t i = 0; i < items_.size(); i++) {
+            if (items_[i]) {
+                chm_free_interval(items_[i]);
+                delete items_[i];
+            }
+        }
+        if (cache_resized_)
+            chm_set_param(file_, CHM_PARAM_MAX_BLOCKS_CACHED, CHM_BLOCK_CACHE_DEFAULT);
+    }
+
+    /// Puts intervals of topic i to the block cache, topics must be taken in order
+    void take(int i)
+    {
+        while (next_cache_ < topic_end_[i]) {
+            fill();
+            int k = next_cache_++;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [this, k] { return state_[k] != ITEM_QUEUED; });
+            }
+            chmLzxInterval * iv = items_[k];
+            if (state_[k] == ITEM_READY)
+                chm_cache_interval(file_, iv);
+            // Failed intervals have zero size
+            pending_size_ -= iv->block_count * iv->block_len;
+            chm_free_interval(iv);
+            delete iv;
+            items_[k] = NULL;
+        }
+        // Keep workers busy while topic is parsed
+        fill();
+    }
+
+    static int threadsCount()
+    {
+        int cpus = (int) std::thread::hardware_concurrency();
+        return (cpus - 1 < CHM_PREFETCH_MAX_THREADS) ? cpus - 1 : CHM_PREFETCH_MAX_THREADS;
+    }
+};
+
 class CHMTOCReader {
     LVContainerRef _cont;
     LvDocFragmentWriter * _appender;
@@ -1141,9 +1312,21 @@ public:
         {
             cnt=(cnt<FIRSTPAGE_BLOCKS_MAX_CHM)? cnt : FIRSTPAGE_BLOCKS_MAX_CHM;
         }
+        // Thumbnail import stops at first pages, decompressing ahead would be wasted
+        CHMIntervalPrefetch * prefetch = NULL;
+        int prefetch_threads = CHMIntervalPrefetch::threadsCount();
+        if ( !needs_coverpage && prefetch_threads > 0 && cnt > 1 ) {
+            lString16Collection topics;
+            for ( int i=0; i<cnt; i++ )
+                topics.add(_fileList[i]);
+            // Container is always opened by LVOpenCHMContainer in ImportCHMDocument
+            prefetch = new CHMIntervalPrefetch((LVCHMContainer*)_cont.get(), topics, prefetch_threads);
+        }
         for ( int i=0; i<cnt; i++ ) {
             lString16 fname = _fileList[i];
             //CRLog::trace("Import file %s", LCSTR(fname));
+            if ( prefetch )
+                prefetch->take(i);
             LVStreamRef stream = _cont->OpenStream(fname.c_str(), LVOM_READ);
             if ( stream.isNull() )
                 continue;
@@ -1158,6 +1341,7 @@ public:
             }
             appendedFragments++;
         }
+        delete prefetch;
         return appendedFragments;
     }
 };
@@ -1639,27 +1639,29 @@ int sort_dblstats_by_ch( const void * p1, const void * p2 )
 class CDoubleCharStat2
 { 
 private:
-    lUInt16 * * stats;
+    // flat 256x256 table, rows are cleared on first use only
+    lUInt16 * stats;
+    bool rows[256];
     int total;
     int items;
 public:
     CDoubleCharStat2() : stats(NULL), total(0), items(0)
     {
+        memset( rows, 0, sizeof(rows) );
     }
     void Add( unsigned char c1, unsigned char c2 )
     {
-        if ( !stats ) {
-            stats = new lUInt16* [256];
-            memset( stats, 0, sizeof(lUInt16*)*256);
-        }
+        if ( !stats )
+            stats = new lUInt16[256*256];
         if (c1==' ' && c2==' ')
             return;
         total++;
-        if ( stats[c1]==NULL ) {
-            stats[c1] = new lUInt16[256];
-            memset( stats[c1], 0, sizeof(lUInt16)*256 );
+        lUInt16 * row = stats + (c1 << 8);
+        if ( !rows[c1] ) {
+            rows[c1] = true;
+            memset( row, 0, sizeof(lUInt16)*256 );
         }
-        if ( stats[c1][c2]++ == 0)
+        if ( row[c2]++ == 0)
             items++;
     }
     void GetData( dbl_char_stat_t * pData, int len )
@@ -1668,12 +1670,13 @@ public:
         dbl_char_stat_long_t * pdata = new dbl_char_stat_long_t[items];
         if ( total ) {
             for ( int i=0; i<256; i++ ) {
-                if ( stats[i] ) {
+                if ( rows[i] ) {
+                    lUInt16 * row = stats + (i << 8);
                     for ( int j=0; j<256; j++ ) {
-                        if ( stats[i][j]> 0 ) {
+                        if ( row[j]> 0 ) {
                             pdata[count].ch1 = i;
                             pdata[count].ch2 = j;
-                            int n = stats[i][j];
+                            int n = row[j];
                             n = (int)(n * (lInt64)0x7000 / total);
                             pdata[count].count = n;
                             count++;
@@ -1706,13 +1709,12 @@ public:
    void Close()
    {
        if ( stats ) {
-           for ( int i=0; i<256; i++ )
-               if ( stats[i] )
-                   delete[] stats[i];
            delete[] stats;
            stats = NULL;
        }
+       memset( rows, 0, sizeof(rows) );
        total = 0;
+       items = 0;
    }
 
    virtual ~CDoubleCharStat2()
@@ -1726,6 +1728,10 @@ bool isValidUtf8Data( const unsigned char * buf, int buf_size )
     const unsigned char * start = buf;
     const unsigned char * end_buf = buf + buf_size - 5;
     while ( buf < end_buf ) {
+        // skip plain ASCII runs 16 bytes at a time
+        buf += lStr_asciiLength( buf, (int)(end_buf - buf) );
+        if ( buf >= end_buf )
+            break;
         lUInt8 ch = *buf++;
         if ( (ch & 0x80) == 0 ) {
         } else if ( (ch & 0xC0) == 0x80 ) {
@@ -1903,30 +1909,32 @@ typedef struct {
 // EXTERNAL DEFINE
 extern cp_stat_t cp_stat_table[];
 
-int AutodetectCodePageUtf( const unsigned char * buf, int buf_size, char * cp_name, char * lang_name )
+int AutodetectCodePageBom( const unsigned char * buf, int buf_size, char * cp_name, char * lang_name )
 {
+    if ( buf_size < 2 )
+        return 0;
     // checking byte order signatures
-    if ( buf[0]==0xEF && buf[1]==0xBB && buf[2]==0xBF ) {
+    if ( buf_size>=3 && buf[0]==0xEF && buf[1]==0xBB && buf[2]==0xBF ) {
         strcpy( cp_name, "utf-8" );
-        strcpy( lang_name, "en" );
-        return 1;
-    } else if ( buf[0]==0 && buf[1]==0 && buf[2]==0xFE && buf[3]==0xFF ) {
+    } else if ( buf_size>=4 && buf[0]==0 && buf[1]==0 && buf[2]==0xFE && buf[3]==0xFF ) {
         strcpy( cp_name, "utf-32be" );
-        strcpy( lang_name, "en" );
-        return 1;
     } else if ( buf[0]==0xFE && buf[1]==0xFF ) {
         strcpy( cp_name, "utf-16be" );
-        strcpy( lang_name, "en" );
-        return 1;
-    } else if ( buf[0]==0xFF && buf[1]==0xFE && buf[2]==0 && buf[3]==0 ) {
+    } else if ( buf_size>=4 && buf[0]==0xFF && buf[1]==0xFE && buf[2]==0 && buf[3]==0 ) {
         strcpy( cp_name, "utf-32le" );
-        strcpy( lang_name, "en" );
-        return 1;
     } else if ( buf[0]==0xFF && buf[1]==0xFE ) {
         strcpy( cp_name, "utf-16le" );
-        strcpy( lang_name, "en" );
-        return 1;
+    } else {
+        return 0;
     }
+    strcpy( lang_name, "en" );
+    return 1;
+}
+
+int AutodetectCodePageUtf( const unsigned char * buf, int buf_size, char * cp_name, char * lang_name )
+{
+    if ( AutodetectCodePageBom( buf, buf_size, cp_name, lang_name ) )
+        return 1;
     if ( isValidUtf8Data( buf, buf_size ) ) {
         strcpy( cp_name, "utf-8" );
         strcpy( lang_name, "en" );
@@ -2021,6 +2029,12 @@ int AutodetectCodePage(const unsigned char* buf, int buf_size,
     int res = AutodetectCodePageUtf( buf, buf_size, cp_name, lang_name );
     if (res)
         return res;
+    // declared encoding overrides statistics anyway, don't collect them
+    if (skipHtml && detectXmlHtmlEncoding(buf, buf_size, cp_name)) {
+        CRLog::trace("Encoding parsed from XML/HTML: %s", cp_name);
+        strcpy(lang_name, "en");
+        return 1;
+    }
     // use character statistics
    short char_stat[256];
    dbl_char_stat_t dbl_char_stat[DBL_CHAR_STAT_SIZE];
@@ -2051,11 +2065,6 @@ int AutodetectCodePage(const unsigned char* buf, int buf_size,
    strcpy(cp_name, cp_stat_table[bestn].cp_name);
    strcpy(lang_name, cp_stat_table[bestn].lang_name);
    //CRLog::trace("Detected codepage: %s lang: %s index: %d %s", cp_name, lang_name, bestn, skipHtml ? "(skipHtml)" : "");
-   if (skipHtml) {
-       if (detectXmlHtmlEncoding(buf, buf_size, cp_name)) {
-           CRLog::trace("Encoding parsed from XML/HTML: %s", cp_name);
-       }
-   }
    return 1;
 }
 
@@ -3,6 +3,16 @@
 #include "include/EpubItems.h"
 #include "include/FootnotesPrinter.h"
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+// Upper limit of unpacked spine data waiting for the parser
+#define EPUB_PREFETCH_BUDGET (16 * 1024 * 1024)
+#define EPUB_PREFETCH_MAX_THREADS 4
+
 
 
 
@@ -283,6 +293,14 @@ LVStreamRef EncryptedDataContainer::OpenStreamByPackedSize(uint32_t size)
 	return LVStreamRef();
 }
 
+bool EncryptedDataContainer::ReadPackedItem(const lChar16 *fname, LVPackedItem &item)
+{
+	// Demangling is done by stream wrapper only
+	if (isEncryptedItem(fname))
+		return false;
+	return _container->ReadPackedItem(fname, item);
+}
+
 /// returns stream/container name, may be NULL if unknown
 const lChar16 *EncryptedDataContainer::GetName()
 {
@@ -699,6 +717,145 @@ void parseNav(CrDom *navdoc, CrDom *maindoc, LvDocFragmentWriter &appender)
 	recurseNav(root, appender, maindoc);
 }
 
+/// Inflates spine items on worker threads ahead of the parser. Archive reads and
+/// parsing stay on the importing thread, workers only run zlib on plain buffers.
+/// Items the archive can't hand out packed are opened by the caller as before.
+class EpubSpinePrefetch
+{
+private:
+	enum { ITEM_NONE, ITEM_QUEUED, ITEM_READY, ITEM_FAILED };
+	LVContainerRef arc_;
+	lString16Collection names_;
+	std::vector<LVPackedItem*> items_;
+	std::vector<int> state_;
+	std::deque<int> queue_;
+	std::vector<std::thread> threads_;
+	std::mutex mutex_;
+	std::condition_variable cond_;
+	bool stop_ = false;
+	int next_read_ = 0;
+	int current_ = -1;
+	lUInt32 pending_size_ = 0;
+
+	void work()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		for (;;)
+		{
+			cond_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+			if (stop_)
+			{
+				return;
+			}
+			int i = queue_.front();
+			queue_.pop_front();
+			LVPackedItem *item = items_[i];
+			lock.unlock();
+			bool ok = LVInflatePackedItem(*item);
+			free(item->packed);
+			item->packed = NULL;
+			lock.lock();
+			state_[i] = ok ? ITEM_READY : ITEM_FAILED;
+			cond_.notify_all();
+		}
+	}
+
+	void fill()
+	{
+		while (next_read_ < names_.length() && pending_size_ < EPUB_PREFETCH_BUDGET)
+		{
+			int i = next_read_++;
+			LVPackedItem *item = new LVPackedItem;
+			bool ok = arc_->ReadPackedItem(names_[i].c_str(), *item);
+			std::lock_guard<std::mutex> lock(mutex_);
+			items_[i] = item;
+			if (ok)
+			{
+				state_[i] = ITEM_QUEUED;
+				queue_.push_back(i);
+				pending_size_ += item->unpSize;
+				cond_.notify_all();
+			}
+			else
+			{
+				state_[i] = ITEM_FAILED;
+			}
+		}
+	}
+
+	void release()
+	{
+		if (current_ < 0)
+		{
+			return;
+		}
+		// Items failed to read have zero size
+		LVPackedItem *item = items_[current_];
+		pending_size_ -= item->unpSize;
+		delete item;
+		items_[current_] = NULL;
+		current_ = -1;
+	}
+public:
+	EpubSpinePrefetch(LVContainerRef arc, lString16Collection &names, int threads) : arc_(arc)
+	{
+		names_.addAll(names);
+		items_.resize(names_.length(), NULL);
+		state_.resize(names_.length(), ITEM_NONE);
+		for (int i = 0; i < threads; i++)
+		{
+			threads_.push_back(std::thread(&EpubSpinePrefetch::work, this));
+		}
+	}
+
+	~EpubSpinePrefetch()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+			cond_.notify_all();
+		}
+		for (size_t i = 0; i < threads_.size(); i++)
+		{
+			threads_[i].join();
+		}
+		for (size_t i = 0; i < items_.size(); i++)
+		{
+			delete items_[i];
+		}
+	}
+
+	/// Returns unpacked item i, or null stream if it has to be opened from archive.
+	/// Items must be taken in order, returned stream is valid until the next call.
+	LVStreamRef take(int i)
+	{
+		release();
+		fill();
+		if (i >= next_read_)
+		{
+			return LVStreamRef();
+		}
+		current_ = i;
+		std::unique_lock<std::mutex> lock(mutex_);
+		cond_.wait(lock, [this, i] { return state_[i] == ITEM_READY || state_[i] == ITEM_FAILED; });
+		if (state_[i] == ITEM_FAILED)
+		{
+			return LVStreamRef();
+		}
+		LVPackedItem *item = items_[i];
+		LVStreamRef stream = LVCreateMemoryStream(item->data, item->unpSize, false, LVOM_READ);
+		const lChar16 *name = names_[i].c_str();
+		stream->SetName(name[0] == '/' ? name + 1 : name);
+		return stream;
+	}
+
+	static int threadsCount()
+	{
+		int cpus = (int) std::thread::hardware_concurrency();
+		return (cpus - 1 < EPUB_PREFETCH_MAX_THREADS) ? cpus - 1 : EPUB_PREFETCH_MAX_THREADS;
+	}
+};
+
 bool ImportEpubDocument(LVStreamRef stream, CrDom *m_doc, bool firstpage_thumb)
 {
 	LVContainerRef arc = LVOpenArchive(stream);
@@ -736,9 +893,9 @@ bool ImportEpubDocument(LVStreamRef stream, CrDom *m_doc, bool firstpage_thumb)
 	// read content.opf
 	EpubItems epubItems;
 	EpubItems NotesItems;
-	LVArray<LinkStruct> LinksList;
-	LinksMap LinksMap;
-	Epub3Notes Epub3Notes;
+	LvImportContext importContext;
+	LVArray<LinkStruct> &LinksList = importContext.linksList;
+	Epub3Notes &Epub3Notes = importContext.epub3Notes;
 	//EpubItem * epubToc = NULL; //TODO
 	LVArray<EpubItem *> spineItems;
 	lString16 codeBase;
@@ -1057,11 +1214,31 @@ bool ImportEpubDocument(LVStreamRef stream, CrDom *m_doc, bool firstpage_thumb)
 	    }
         itemcounter++;
     }
+	// Thumbnail import stops at first page, inflating ahead would be wasted
+	EpubSpinePrefetch *prefetch = NULL;
+	int prefetch_threads = EpubSpinePrefetch::threadsCount();
+	if (!firstpage_thumb && prefetch_threads > 0 && spineItems.length() > 1)
+	{
+		lString16Collection spineNames;
+		for (int i = 0; i < spineItems.length(); i++)
+		{
+			spineNames.add(codeBase + spineItems[i]->href);
+		}
+		prefetch = new EpubSpinePrefetch(m_arc, spineNames, prefetch_threads);
+	}
 	for (int i = 0; i < spineItems.length(); i++)
 	{
 		lString16 name = codeBase + spineItems[i]->href;
 		//LV("        EPUB Checking fragment: %s", UnicodeToUtf8(name).c_str());
-		LVStreamRef stream = m_arc->OpenStream(name.c_str(), LVOM_READ);
+		LVStreamRef stream;
+		if (prefetch)
+		{
+			stream = prefetch->take(i);
+		}
+		if (stream.isNull())
+		{
+			stream = m_arc->OpenStream(name.c_str(), LVOM_READ);
+		}
 		if (stream.isNull())
 		{
 			LE("failed opening stream for [%s], retrying with sanitize",LCSTR(name));
@@ -1081,9 +1258,7 @@ bool ImportEpubDocument(LVStreamRef stream, CrDom *m_doc, bool firstpage_thumb)
 		//LvXmlParser
 		LvHtmlParser parser(stream, &appender, firstpage_thumb);
 		parser.setEpubNotes(NotesItems);
-		parser.setLinksList(LinksList);
-		parser.setLinksMap(LinksMap);
-		parser.setEpub3Notes(Epub3Notes);
+		parser.setImportContext(&importContext);
 		parser.setStylesManager(m_doc->stylesManager);
 		if (parser.CheckFormat() && parser.Parse())
 		{
@@ -1096,10 +1271,8 @@ bool ImportEpubDocument(LVStreamRef stream, CrDom *m_doc, bool firstpage_thumb)
 		{
 			LE("Document type is not XML/XHTML for fragment %s", LCSTR(name));
 		}
-		LinksList = parser.getLinksList();
-		LinksMap = parser.getLinksMap();
-		Epub3Notes = parser.getEpub3Notes();
 	}
+	delete prefetch;
 	if(gEmbeddedStylesLVL > 0)
 	{
 		m_doc->stylesManager.Finalize();
@@ -1141,8 +1314,7 @@ bool ImportEpubDocument(LVStreamRef stream, CrDom *m_doc, bool firstpage_thumb)
 				//LV("base: %s", UnicodeToUtf8(base).c_str());
 				//LvXmlParser
 				LvHtmlParser parser(stream, &appender3, firstpage_thumb);
-				//parser.setLinksList(LinksList);
-				parser.setLinksMap(LinksMap);
+				parser.setImportContext(&importContext);
                 parser.setStylesManager(m_doc->stylesManager);
                 if (parser.CheckFormat() && parser.ParseEpubFootnotes())
 				{
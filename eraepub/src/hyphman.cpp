@@ -13,6 +13,8 @@
 
 */
 #include <stdlib.h>
+#include <map>
+#include <vector>
 #include "include/lvxml.h"
 #include "include/hyphman.h"
 #include "include/lvfnt.h"
@@ -20,7 +22,13 @@
 
 #define WORD_LENGTH 2048
 #define MAX_PATTERN_SIZE  9
-#define PATTERN_HASH_SIZE 16384
+// Compiled patterns are saved to cache directory under dictionary file name with this suffix
+#define HYPH_TRIE_SUFFIX ".trie"
+#define HYPH_TRIE_MAGIC "CRHYTRI2"
+#define HYPH_TRIE_MAGIC_SIZE 8
+#define HYPH_TRIE_NONE 0xFFFFFFFF
+#define HYPH_WORD_CACHE_SIZE 1024
+#define HYPH_WORD_CACHE_MAX_LENGTH 24
 
 // set to 1 for debug dump
 #if 0
@@ -33,21 +41,76 @@
 
 HyphDictionary* HyphMan::_selectedDictionary = NULL;
 HyphDictionaryList* HyphMan::_dictList = NULL;
+lString16 HyphMan::_cacheDir;
+
+// Compiled patterns trie has same layout in memory and in .trie file:
+// header, nodes, edges sorted by char within node, then hyphenation digits strings
+struct HyphTrieHeader
+{
+    char magic[HYPH_TRIE_MAGIC_SIZE];
+    lUInt32 hash;
+    // Size and crc32 of source dictionary file, to detect stale .trie
+    lUInt32 source_size;
+    lUInt32 source_crc;
+    lUInt32 node_count;
+    lUInt32 edge_count;
+    lUInt32 attr_size;
+};
+
+struct HyphTrieNode
+{
+    lUInt32 first_edge;
+    lUInt32 edge_count;
+    // Offset of pattern digits in attrs, 0 if no pattern ends at this node
+    lUInt32 attr;
+};
+
+struct HyphTrieEdge
+{
+    lUInt32 ch;
+    lUInt32 node;
+};
+
+struct HyphWordCacheItem
+{
+    int len;
+    bool found;
+    lChar16 word[HYPH_WORD_CACHE_MAX_LENGTH];
+    char mask[HYPH_WORD_CACHE_MAX_LENGTH + 3];
+};
 
 class TexPattern;
 class TexHyph : public HyphMethod
 {
-    TexPattern * table[PATTERN_HASH_SIZE];
+    // Compiled trie is either owned by _image or mapped from .trie file
+    lUInt8 * _image;
+    LVStreamRef _imageStream;
+    LVStreamBufferRef _imageBuffer;
+    const HyphTrieHeader * _header;
+    const HyphTrieNode * _nodes;
+    const HyphTrieEdge * _edges;
+    const char * _attrs;
+    // Masks of recently hyphenated words, so layout doesn't walk trie for same words again
+    HyphWordCacheItem * _wordCache;
     lUInt32 _hash;
+    bool attach( const lUInt8 * data, lvsize_t size );
+    bool loadPatterns( LVStreamRef stream, LVPtrVector<TexPattern> & patterns );
+    bool loadSource( LVStreamRef stream, lUInt32 sourceSize, lUInt32 sourceCrc );
+    bool compile( LVPtrVector<TexPattern> & patterns, lUInt32 sourceSize, lUInt32 sourceCrc );
+    bool loadCompiled( lString16 fileName, lUInt32 sourceSize, lUInt32 sourceCrc );
+    bool saveCompiled( lString16 fileName );
+    HyphWordCacheItem * getWordCacheItem( const lChar16 * word, int len );
 public:
     bool match( const lChar16 * str, char * mask );
     virtual bool hyphenate(const lChar16* str, int len, lUInt16* widths, lUInt8* flags,
                            lUInt16 hyphCharWidth, lUInt16 maxWidth);
-    void addPattern( TexPattern * pattern );
     TexHyph();
     virtual ~TexHyph();
     bool load( LVStreamRef stream );
+    /// loads compiled .trie from cache directory, or compiles dictionary and saves .trie there
     bool load( lString16 fileName );
+    /// writes compiled trie to stream
+    bool save( LVStreamRef stream );
     virtual lUInt32 getHash() { return _hash; }
 };
 
@@ -167,13 +230,8 @@ bool HyphDictionary::activate()
             HyphMan::_method = &NO_HYPH;
         }
 		CRLog::trace("Selecting hyphenation dictionary %s", UnicodeToUtf8(_filename).c_str() );
-		LVStreamRef stream = LVOpenFileStream(getFilename().c_str(), LVOM_READ);
-		if (stream.isNull()) {
-			CRLog::error("Cannot open hyphenation dictionary %s", UnicodeToUtf8(_filename).c_str());
-			return false;
-		}
         TexHyph * method = new TexHyph();
-        if ( !method->load( stream ) ) {
+        if ( !method->load( getFilename() ) ) {
 			CRLog::error("Cannot open hyphenation dictionary %s", UnicodeToUtf8(_filename).c_str());
             delete method;
             return false;
@@ -256,73 +314,8 @@ class TexPattern {
 public:
     lChar16 word[MAX_PATTERN_SIZE];
     char attr[MAX_PATTERN_SIZE+1];
-    TexPattern * next;
 
-    int cmp( TexPattern * v )
-    {
-        return lStr_cmp( word, v->word );
-    }
-
-    static int hash( const lChar16 * s )
-    {
-        return ((lUInt32)(((s[0] *31 + s[1])*31 + s[2]) * 31 + s[3])) % PATTERN_HASH_SIZE;
-    }
-
-    static int hash3( const lChar16 * s )
-    {
-        return ((lUInt32)(((s[0] *31 + s[1])*31 + s[2]) * 31 + 0)) % PATTERN_HASH_SIZE;
-    }
-
-    static int hash2( const lChar16 * s )
-    {
-        return ((lUInt32)(((s[0] *31 + s[1])*31 + 0) * 31 + 0)) % PATTERN_HASH_SIZE;
-    }
-
-    static int hash1( const lChar16 * s )
-    {
-        return ((lUInt32)(((s[0] *31 + 0)*31 + 0) * 31 + 0)) % PATTERN_HASH_SIZE;
-    }
-
-    int hash()
-    {
-        return ((lUInt32)(((word[0] *31 + word[1])*31 + word[2]) * 31 + word[3])) % PATTERN_HASH_SIZE;
-    }
-
-    bool match( const lChar16 * s, char * mask )
-    {
-        TexPattern * p = this;
-        bool found = false;
-        while ( p ) {
-            bool res = true;
-            for ( int i=2; p->word[i]; i++ )
-                if ( p->word[i]!=s[i] ) {
-                    res = false;
-                    break;
-                }
-            if ( res ) {
-                if ( p->word[0]==s[0] && (p->word[1]==0 || p->word[1]==s[1]) ) {
-#if DUMP_PATTERNS==1
-                    CRLog::debug("Pattern matched: %s %s on %s %s", LCSTR(lString16(p->word)), p->attr, LCSTR(lString16(s)), mask);
-#endif
-                    p->apply(mask);
-                    found = true;
-                }
-            }
-            p = p->next;
-        }
-        return found;
-    }
-
-    void apply( char * mask )
-    {
-        ;
-        for ( char * p = attr; *p && *mask; p++, mask++ ) {
-            if ( *mask < *p )
-                *mask = *p;
-        }
-    }
-
-    TexPattern( const lString16 &s ) : next( NULL )
+    TexPattern( const lString16 &s )
     {
         memset( word, 0, sizeof(word) );
         memset( attr, '0', sizeof(attr) );
@@ -405,39 +398,23 @@ public:
 };
 
 TexHyph::TexHyph()
+    : _image(NULL), _header(NULL), _nodes(NULL), _edges(NULL), _attrs(NULL), _wordCache(NULL)
 {
-    memset( table, 0, sizeof(table) );
     _hash = 123456;
 }
 
 TexHyph::~TexHyph()
 {
-    for ( int i=0; i<PATTERN_HASH_SIZE; i++ ) {
-        TexPattern * p = table[i];
-        while (p) {
-            TexPattern * tmp = p;
-            p = p->next;
-            delete tmp;
-        }
-    }
-}
-
-void TexHyph::addPattern( TexPattern * pattern )
-{
-    int h = pattern->hash();
-    TexPattern * * p = &table[h];
-    while ( *p && pattern->cmp(*p)<0 )
-        p = &((*p)->next);
-    pattern->next = *p;
-    *p = pattern;
+    if ( _image )
+        delete[] _image;
+    if ( _wordCache )
+        delete[] _wordCache;
 }
 
-bool TexHyph::load( LVStreamRef stream )
+bool TexHyph::loadPatterns( LVStreamRef stream, LVPtrVector<TexPattern> & patterns )
 {
     int w = isCorrectHyphFile(stream.get());
-    int patternCount = 0;
     if (w) {
-        _hash = stream->getcrc32();
         int        i;
         lvsize_t   dw;
 
@@ -479,8 +456,7 @@ bool TexHyph::load( LVStreamRef stream )
 #if DUMP_PATTERNS==1
                 CRLog::debug("Pattern: '%s' - %s", LCSTR(lString16(pattern->word)), pattern->attr );
 #endif
-                addPattern( pattern );
-                patternCount++;
+                patterns.add( pattern );
             }
         }
 
@@ -508,13 +484,12 @@ bool TexHyph::load( LVStreamRef stream )
 #if DUMP_PATTERNS==1
                 CRLog::debug("Pattern: '%s' - %s", LCSTR(lString16(pattern->word)), pattern->attr);
 #endif
-                addPattern( pattern );
-                patternCount++;
+                patterns.add( pattern );
                 p += sz + sz + 1;
             }
         }
 
-        return patternCount>0;
+        return patterns.length()>0;
     } else {
         // tex xml format as for FBReader
         lString16Collection data;
@@ -532,11 +507,224 @@ bool TexHyph::load( LVStreamRef stream )
 #if DUMP_PATTERNS==1
             CRLog::debug("Pattern: (%s) '%s' - %s", LCSTR(data[i]), LCSTR(lString16(pattern->word)), pattern->attr);
 #endif
-            addPattern( pattern );
-            patternCount++;
+            patterns.add( pattern );
+        }
+        return patterns.length()>0;
+    }
+}
+
+struct HyphTrieBuildNode
+{
+    std::map<lChar16, HyphTrieBuildNode*> children;
+    bool terminal;
+    char attr[MAX_PATTERN_SIZE+1];
+    HyphTrieBuildNode() : terminal(false) { memset( attr, 0, sizeof(attr) ); }
+    ~HyphTrieBuildNode()
+    {
+        std::map<lChar16, HyphTrieBuildNode*>::iterator it;
+        for ( it = children.begin(); it != children.end(); ++it )
+            delete it->second;
+    }
+    /// same patterns are merged, applying merged digits equals applying each of them
+    void mergeAttr( const char * v )
+    {
+        int len = (int)strlen( attr );
+        int vlen = (int)strnlen( v, MAX_PATTERN_SIZE );
+        for ( int i=0; i<vlen; i++ ) {
+            if ( i>=len || attr[i]<v[i] )
+                attr[i] = v[i];
         }
-        return patternCount>0;
+        terminal = true;
+    }
+};
+
+bool TexHyph::compile( LVPtrVector<TexPattern> & patterns, lUInt32 sourceSize, lUInt32 sourceCrc )
+{
+    HyphTrieBuildNode root;
+    for ( int i=0; i<patterns.length(); i++ ) {
+        TexPattern * pattern = patterns[i];
+        HyphTrieBuildNode * node = &root;
+        for ( int k=0; k<MAX_PATTERN_SIZE && pattern->word[k]; k++ ) {
+            HyphTrieBuildNode * & child = node->children[pattern->word[k]];
+            if ( !child )
+                child = new HyphTrieBuildNode();
+            node = child;
+        }
+        if ( node!=&root )
+            node->mergeAttr( pattern->attr );
+    }
+    // Flatten breadth first, so children of each node get contiguous edges
+    std::vector<HyphTrieBuildNode*> order;
+    std::vector<HyphTrieNode> nodes;
+    std::vector<HyphTrieEdge> edges;
+    std::vector<char> attrs;
+    attrs.push_back( 0 );
+    order.push_back( &root );
+    for ( size_t i=0; i<order.size(); i++ ) {
+        HyphTrieBuildNode * src = order[i];
+        HyphTrieNode node;
+        node.first_edge = (lUInt32)edges.size();
+        node.edge_count = (lUInt32)src->children.size();
+        node.attr = 0;
+        if ( src->terminal ) {
+            node.attr = (lUInt32)attrs.size();
+            attrs.insert( attrs.end(), src->attr, src->attr + strlen( src->attr ) + 1 );
+        }
+        std::map<lChar16, HyphTrieBuildNode*>::iterator it;
+        for ( it = src->children.begin(); it != src->children.end(); ++it ) {
+            HyphTrieEdge edge;
+            edge.ch = (lUInt32)it->first;
+            edge.node = (lUInt32)order.size();
+            edges.push_back( edge );
+            order.push_back( it->second );
+        }
+        nodes.push_back( node );
+    }
+    // Keep image size multiple of 4, so mapped .trie arrays stay aligned
+    while ( attrs.size() & 3 )
+        attrs.push_back( 0 );
+
+    HyphTrieHeader header;
+    memcpy( header.magic, HYPH_TRIE_MAGIC, HYPH_TRIE_MAGIC_SIZE );
+    header.hash = _hash;
+    header.source_size = sourceSize;
+    header.source_crc = sourceCrc;
+    header.node_count = (lUInt32)nodes.size();
+    header.edge_count = (lUInt32)edges.size();
+    header.attr_size = (lUInt32)attrs.size();
+    size_t nodesSize = nodes.size() * sizeof(HyphTrieNode);
+    size_t edgesSize = edges.size() * sizeof(HyphTrieEdge);
+    size_t size = sizeof(header) + nodesSize + edgesSize + attrs.size();
+    lUInt8 * image = new lUInt8[size];
+    lUInt8 * p = image;
+    memcpy( p, &header, sizeof(header) );
+    p += sizeof(header);
+    memcpy( p, &nodes[0], nodesSize );
+    p += nodesSize;
+    if ( edgesSize ) {
+        memcpy( p, &edges[0], edgesSize );
+        p += edgesSize;
     }
+    memcpy( p, &attrs[0], attrs.size() );
+    if ( !attach( image, size ) ) {
+        delete[] image;
+        return false;
+    }
+    _image = image;
+    CRLog::debug("TexHyph: compiled %d patterns to %d trie nodes", patterns.length(), (int)nodes.size());
+    return true;
+}
+
+bool TexHyph::attach( const lUInt8 * data, lvsize_t size )
+{
+    if ( size < sizeof(HyphTrieHeader) )
+        return false;
+    const HyphTrieHeader * header = (const HyphTrieHeader *)data;
+    if ( memcmp( header->magic, HYPH_TRIE_MAGIC, HYPH_TRIE_MAGIC_SIZE )!=0 )
+        return false;
+    if ( header->node_count==0 || header->attr_size==0
+            || header->node_count > size / sizeof(HyphTrieNode)
+            || header->edge_count > size / sizeof(HyphTrieEdge) )
+        return false;
+    lvsize_t expected = sizeof(HyphTrieHeader)
+            + (lvsize_t)header->node_count * sizeof(HyphTrieNode)
+            + (lvsize_t)header->edge_count * sizeof(HyphTrieEdge)
+            + header->attr_size;
+    if ( expected!=size )
+        return false;
+    const HyphTrieNode * nodes = (const HyphTrieNode *)(data + sizeof(HyphTrieHeader));
+    const HyphTrieEdge * edges = (const HyphTrieEdge *)(nodes + header->node_count);
+    const char * attrs = (const char *)(edges + header->edge_count);
+    // Validate once, so match() never checks bounds
+    if ( attrs[header->attr_size - 1]!=0 )
+        return false;
+    for ( lUInt32 i=0; i<header->node_count; i++ ) {
+        const HyphTrieNode & node = nodes[i];
+        if ( node.first_edge > header->edge_count
+                || node.edge_count > header->edge_count - node.first_edge
+                || node.attr >= header->attr_size )
+            return false;
+    }
+    for ( lUInt32 i=0; i<header->edge_count; i++ ) {
+        if ( edges[i].node==0 || edges[i].node >= header->node_count )
+            return false;
+    }
+    _header = header;
+    _nodes = nodes;
+    _edges = edges;
+    _attrs = attrs;
+    return true;
+}
+
+bool TexHyph::save( LVStreamRef stream )
+{
+    if ( stream.isNull() || !_header )
+        return false;
+    lvsize_t size = sizeof(HyphTrieHeader)
+            + (lvsize_t)_header->node_count * sizeof(HyphTrieNode)
+            + (lvsize_t)_header->edge_count * sizeof(HyphTrieEdge)
+            + _header->attr_size;
+    lvsize_t dw = 0;
+    return stream->Write( _header, size, &dw )==LVERR_OK && dw==size;
+}
+
+bool TexHyph::loadCompiled( lString16 fileName, lUInt32 sourceSize, lUInt32 sourceCrc )
+{
+    if ( !LVFileExists( fileName ) )
+        return false;
+    LVStreamRef stream = LVMapFileStream( fileName.c_str(), LVOM_READ, 0 );
+    if ( stream.isNull() )
+        return false;
+    LVStreamBufferRef buffer = stream->GetReadBuffer( 0, stream->GetSize() );
+    if ( buffer.isNull() || !buffer->getReadOnly() )
+        return false;
+    if ( !attach( buffer->getReadOnly(), buffer->getSize() ) )  {
+        CRLog::error("TexHyph: broken compiled dictionary %s", LCSTR(fileName));
+        return false;
+    }
+    if ( _header->source_size!=sourceSize || _header->source_crc!=sourceCrc ) {
+        CRLog::debug("TexHyph: stale compiled dictionary %s", LCSTR(fileName));
+        _header = NULL;
+        _nodes = NULL;
+        _edges = NULL;
+        _attrs = NULL;
+        return false;
+    }
+    _imageStream = stream;
+    _imageBuffer = buffer;
+    _hash = _header->hash;
+    return true;
+}
+
+bool TexHyph::saveCompiled( lString16 fileName )
+{
+    LVStreamRef stream = LVOpenFileStream( fileName.c_str(), LVOM_WRITE );
+    if ( stream.isNull() ) {
+        CRLog::debug("TexHyph: cannot write compiled dictionary %s", LCSTR(fileName));
+        return false;
+    }
+    if ( !save( stream ) ) {
+        stream.Clear();
+        LVDeleteFile( fileName );
+        CRLog::error("TexHyph: failed to write compiled dictionary %s", LCSTR(fileName));
+        return false;
+    }
+    return true;
+}
+
+bool TexHyph::loadSource( LVStreamRef stream, lUInt32 sourceSize, lUInt32 sourceCrc )
+{
+    // Dictionary hash is crc of its source, computed once by caller
+    _hash = sourceCrc;
+    LVPtrVector<TexPattern> patterns;
+    if ( !loadPatterns( stream, patterns ) )
+        return false;
+    return compile( patterns, sourceSize, sourceCrc );
+}
+
+bool TexHyph::load( LVStreamRef stream )
+{
+    return loadSource( stream, (lUInt32)stream->GetSize(), stream->getcrc32() );
 }
 
 bool TexHyph::load( lString16 fileName )
@@ -544,32 +732,70 @@ bool TexHyph::load( lString16 fileName )
     LVStreamRef stream = LVOpenFileStream( fileName.c_str(), LVOM_READ );
     if ( stream.isNull() )
         return false;
-    return load( stream );
+    lUInt32 sourceSize = (lUInt32)stream->GetSize();
+    lUInt32 sourceCrc = stream->getcrc32();
+    // Dictionaries are often read only, so compiled trie goes to cache directory
+    lString16 cacheName;
+    if ( !HyphMan::getCacheDir().empty() ) {
+        cacheName = LVCombinePaths( HyphMan::getCacheDir(), LVExtractFilename( fileName ) + HYPH_TRIE_SUFFIX );
+        if ( loadCompiled( cacheName, sourceSize, sourceCrc ) )
+            return true;
+    }
+    if ( !loadSource( stream, sourceSize, sourceCrc ) )
+        return false;
+    if ( !cacheName.empty() )
+        saveCompiled( cacheName );
+    return true;
 }
 
-
 bool TexHyph::match( const lChar16 * str, char * mask )
 {
     bool found = false;
-    TexPattern * res = table[ TexPattern::hash( str ) ];
-    if ( res ) {
-        found = res->match( str, mask ) || found;
-    }
-    res = table[ TexPattern::hash3( str ) ];
-    if ( res ) {
-        found = res->match( str, mask ) || found;
-    }
-    res = table[ TexPattern::hash2( str ) ];
-    if ( res ) {
-        found = res->match( str, mask ) || found;
-    }
-    res = table[ TexPattern::hash1( str ) ];
-    if ( res ) {
-        found = res->match( str, mask ) || found;
+    const HyphTrieNode * node = _nodes;
+    for ( int i=0; i<MAX_PATTERN_SIZE && str[i]; i++ ) {
+        // Edges are sorted by char
+        const HyphTrieEdge * edge = _edges + node->first_edge;
+        const HyphTrieEdge * end = edge + node->edge_count;
+        lUInt32 ch = (lUInt32)str[i];
+        while ( edge < end ) {
+            const HyphTrieEdge * mid = edge + (end - edge) / 2;
+            if ( mid->ch < ch )
+                edge = mid + 1;
+            else
+                end = mid;
+        }
+        if ( edge == _edges + node->first_edge + node->edge_count || edge->ch != ch )
+            break;
+        node = _nodes + edge->node;
+        if ( node->attr ) {
+#if DUMP_PATTERNS==1
+            CRLog::debug("Pattern matched: %s %s on %s %s", LCSTR(lString16(str, i + 1)), _attrs + node->attr, LCSTR(lString16(str)), mask);
+#endif
+            char * m = mask;
+            for ( const char * p = _attrs + node->attr; *p && *m; p++, m++ ) {
+                if ( *m < *p )
+                    *m = *p;
+            }
+            found = true;
+        }
     }
     return found;
 }
 
+HyphWordCacheItem * TexHyph::getWordCacheItem( const lChar16 * word, int len )
+{
+    if ( len > HYPH_WORD_CACHE_MAX_LENGTH )
+        return NULL;
+    if ( !_wordCache ) {
+        _wordCache = new HyphWordCacheItem[HYPH_WORD_CACHE_SIZE];
+        memset( _wordCache, 0, sizeof(HyphWordCacheItem) * HYPH_WORD_CACHE_SIZE );
+    }
+    lUInt32 hash = 0;
+    for ( int i=0; i<len; i++ )
+        hash = hash * 31 + (lUInt32)word[i];
+    return &_wordCache[hash % HYPH_WORD_CACHE_SIZE];
+}
+
 //TODO: do we need it?
 ///// returns false if there is rule disabling hyphenation at specified point
 //static bool checkHyphenRules( const lChar16 * str, int len, int pos )
@@ -615,8 +841,20 @@ bool TexHyph::hyphenate( const lChar16 * str, int len, lUInt16 * widths, lUInt8
     memset( mask, '0', len+3 );
     mask[len+3] = 0;
     bool found = false;
-    for ( int i=0; i<len; i++ ) {
-        found = match( word + i, mask + i ) || found;
+    HyphWordCacheItem * cached = getWordCacheItem( word + 1, len );
+    if ( cached && cached->len==len && !memcmp( cached->word, word + 1, len * sizeof(lChar16) ) ) {
+        found = cached->found;
+        memcpy( mask, cached->mask, len+3 );
+    } else {
+        for ( int i=0; i<len; i++ ) {
+            found = match( word + i, mask + i ) || found;
+        }
+        if ( cached ) {
+            cached->len = len;
+            cached->found = found;
+            memcpy( cached->word, word + 1, len * sizeof(lChar16) );
+            memcpy( cached->mask, mask, len+3 );
+        }
     }
     if ( !found )
         return false;
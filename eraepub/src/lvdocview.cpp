@@ -13,6 +13,7 @@
 
  *******************************************************/
 
+#include <algorithm>
 #include <map>
 #include <set>
 
@@ -28,6 +29,7 @@
 #include "include/crcss.h"
 #include "include/crconfig.h"
 #include "include/fb2fmt.h"
+#include "include/charProps.h"
 #include "include/fb3fmt.h"
 #include "include/odthandler.h"
 
@@ -40,6 +42,10 @@
 #endif
 
 static const css_font_family_t DEF_FONT_FAMILY = css_ff_sans_serif;
+// Final blocks laid out by RenderPrefix(), a few dozen pages of plain text
+static const int RENDER_PREFIX_FINAL_BLOCKS = 2000;
+// Text files bigger than this are imported by RenderPrefix() sized parts
+static const lvsize_t TXT_PREFIX_IMPORT_SIZE = 4 * 1024 * 1024;
 
 LVDocView::LVDocView()
         : stream_(NULL),
@@ -48,6 +54,9 @@ LVDocView::LVDocView()
           page_(0),
           offset_(0),
           is_rendered_(false),
+          layout_incomplete_(false),
+          txt_import_(NULL),
+          txt_import_writer_(NULL),
           highlight_bookmarks_(1),
           margins_(),
           show_cover_(false),
@@ -66,6 +75,7 @@ LVDocView::LVDocView()
           cfg_embeded_fonts_(false),
           cfg_enable_footnotes_(true),
           cfg_firstpage_thumb_(false),
+          cfg_progressive_render_(false),
           cfg_txt_smart_format_(true)
 {
     cfg_font_face_ = lString8("Arial, Roboto");
@@ -81,6 +91,13 @@ LVDocView::~LVDocView()
 
 void LVDocView::Clear()
 {
+    hitboxesCash.reset();
+    pageTextCash.reset();
+    xpointerIndex.reset();
+    SavePhrasesIndex();
+    phraseIndex.reset();
+    phrase_cache_file_.clear();
+    DropImport();
     if (cr_dom_)
     {
         delete cr_dom_;
@@ -91,6 +108,7 @@ void LVDocView::Clear()
     position_is_set_ = false;
     show_cover_ = false;
     is_rendered_ = false;
+    layout_incomplete_ = false;
     bookmark_ = ldomXPointer();
     bookmark_.clear();
     doc_props_->clear();
@@ -123,7 +141,10 @@ void LVDocView::RenderIfDirty()
     {
         return;
     }
+    // Whole document is laid out, so it needs the rest of text
+    CompleteImport();
     is_rendered_ = true;
+    layout_incomplete_ = false;
     position_is_set_ = false;
     if (cr_dom_ && cr_dom_->getRootNode() != NULL)
     {
@@ -144,10 +165,126 @@ void LVDocView::RenderIfDirty()
     }
 }
 
+int LVDocView::RenderPrefix(const lString16& xpath)
+{
+    if (is_rendered_ || !cr_dom_ || cr_dom_->getRootNode() == NULL)
+    {
+        RenderIfDirty();
+        return GetPagesCount();
+    }
+    int dx = page_rects_[0].width() - margins_.left - margins_.right;
+    int dy = page_rects_[0].height() - margins_.top - margins_.bottom;
+    CheckRenderProps(dx, dy);
+    if (base_font_.isNull())
+    {
+        CRLog::error("RenderPrefix base_font_.isNull()");
+        return 0;
+    }
+    is_rendered_ = true;
+    position_is_set_ = false;
+    int y0 = show_cover_ ? dy + margins_.bottom * 4 : 0;
+    ldomNode* keep = xpath.empty() ? NULL : cr_dom_->createXPointer(xpath).getNode();
+    if (keep == NULL && !xpath.empty() && IsImportIncomplete())
+    {
+        // Saved position is past imported start of text
+        CompleteImport();
+        keep = cr_dom_->createXPointer(xpath).getNode();
+    }
+    int estimated = cr_dom_->renderPrefix(&pages_list_, dx, dy, show_cover_, y0, base_font_,
+            cfg_interline_space_, RENDER_PREFIX_FINAL_BLOCKS, keep);
+    fontMan->gc();
+    if (IsImportIncomplete())
+    {
+        // Pages of text not imported yet are estimated by its size
+        int pages = estimated > 0 ? estimated : GetPagesCount();
+        lvpos_t parsed = txt_import_->GetParsedPos();
+        lvsize_t size = txt_import_->getStream()->GetSize();
+        estimated = parsed > 0 ? (int) ((lInt64) pages * size / parsed) : pages;
+        layout_incomplete_ = true;
+        return estimated;
+    }
+    if (estimated == 0)
+    {
+        // Document is small enough, it was laid out at once
+        UpdateSelections();
+        UpdateBookmarksRanges();
+        return GetPagesCount();
+    }
+    layout_incomplete_ = true;
+    return estimated;
+}
+
+void LVDocView::CompleteLayout()
+{
+    if (!layout_incomplete_)
+    {
+        RenderIfDirty();
+        return;
+    }
+    RequestRender();
+    RenderIfDirty();
+}
+
+bool LVDocView::ImportTextPrefix()
+{
+    txt_import_writer_ = new LvDomWriter(cr_dom_);
+    txt_import_ = new LVTextParser(stream_, txt_import_writer_, cfg_txt_smart_format_, false);
+    txt_import_->SetBlockLimit(RENDER_PREFIX_FINAL_BLOCKS);
+    if (!txt_import_->CheckFormat() || !txt_import_->Parse())
+    {
+        DropImport();
+        return false;
+    }
+    if (!txt_import_->IsStopped())
+    {
+        // Text is shorter than the limit
+        DropImport();
+        return true;
+    }
+    txt_import_writer_->initOpenElements();
+    return true;
+}
+
+void LVDocView::CompleteImport()
+{
+    if (txt_import_ == NULL)
+    {
+        return;
+    }
+    CRLog::info("CompleteImport: importing text past %d laid out pages", pages_list_.length());
+    txt_import_->ParseRest();
+    DropImport();
+    // Paragraphs were added to document laid out already
+    cr_dom_->dropRendered();
+}
+
+void LVDocView::DropImport()
+{
+    delete txt_import_;
+    txt_import_ = NULL;
+    // Writer closes elements left open
+    delete txt_import_writer_;
+    txt_import_writer_ = NULL;
+}
+
+void LVDocView::CompleteLayoutForPage(int page)
+{
+    // Last prefix page may still grow with the text following it
+    if (layout_incomplete_ && page >= pages_list_.length() - 1)
+    {
+        CompleteLayout();
+    }
+}
+
 /// Invalidate formatted data, request render
 void LVDocView::RequestRender()
 {
     is_rendered_ = false;
+    hitboxesCash.reset();
+    pageTextCash.reset();
+    xpointerIndex.reset();
+    SavePhrasesIndex();
+    phraseIndex.reset();
     cr_dom_->clearRendBlockCache();
 }
 
@@ -691,6 +828,15 @@ bool LVDocView::LoadDoc(int doc_format, LVStreamRef stream)
             return false;
         }
     }
+    else if (doc_format == DOC_FORMAT_TXT && cfg_progressive_render_ && !cfg_firstpage_thumb_
+            && stream_->GetSize() > TXT_PREFIX_IMPORT_SIZE)
+    {
+        if (!ImportTextPrefix())
+        {
+            CRLog::error("IMPORTING TXT FAILED");
+            return false;
+        }
+    }
     else if (doc_format == DOC_FORMAT_TXT)
     {
         LvDomWriter writer(cr_dom_);
@@ -1907,6 +2053,12 @@ int LVDocView::GetPageForBookmark(ldomXPointer bm)
     else
     {
         lvPoint pt = bm.toPoint();
+        if (pt.y < 0 && layout_incomplete_)
+        {
+            // Node is past laid out prefix
+            CompleteLayout();
+            pt = bm.toPoint();
+        }
         if (pt.y < 0)
         {
             return 0;
@@ -1915,6 +2067,57 @@ int LVDocView::GetPageForBookmark(ldomXPointer bm)
     }
 }
 
+/// get page number by bookmark string, -1 if it can't be resolved
+int LVDocView::GetPageForXPath(const lString16& xpath)
+{
+    CHECK_RENDER("getXPathPage()")
+    XPointerIndex::Entry* entry = xpointerIndex.find(cr_dom_, xpath);
+    if (entry == NULL && IsImportIncomplete())
+    {
+        // Node may be in text not imported yet
+        CompleteLayout();
+        entry = xpointerIndex.find(cr_dom_, xpath);
+    }
+    if (entry == NULL)
+    {
+        return -1;
+    }
+    if (entry->page < 0)
+    {
+        bool incomplete = layout_incomplete_;
+        int page = GetPageForBookmark(ldomXPointer(cr_dom_->getTinyNode(entry->node), entry->offset));
+        if (incomplete != layout_incomplete_)
+        {
+            // Layout was completed for this lookup, index was reset with it
+            entry = xpointerIndex.find(cr_dom_, xpath);
+            if (entry == NULL)
+            {
+                return -1;
+            }
+        }
+        entry->page = page;
+    }
+    return entry->page;
+}
+
+/// returns xpointer of bookmark string, resolved through xpointer index
+ldomXPointer LVDocView::CreateXPointer(const lString16& xpath)
+{
+    CHECK_RENDER("createXPointer()")
+    XPointerIndex::Entry* entry = xpointerIndex.find(cr_dom_, xpath);
+    if (entry == NULL && IsImportIncomplete())
+    {
+        // Node may be in text not imported yet
+        CompleteLayout();
+        entry = xpointerIndex.find(cr_dom_, xpath);
+    }
+    if (entry == NULL)
+    {
+        return ldomXPointer();
+    }
+    return ldomXPointer(cr_dom_->getTinyNode(entry->node), entry->offset);
+}
+
 void LVDocView::UpdateScrollInfo()
 {
     CheckPos();
@@ -2070,6 +2273,45 @@ LVRef<ldomXRange> LVDocView::GetPageDocRange(int page_index , bool one_column)
     return res;
 }
 
+// Max number of elements to look through for images on each page
+#define PREWARM_MAX_ELEMENTS 2048
+
+void LVDocView::PrewarmPageImages()
+{
+    if (IsScrollMode() || gJapaneseVerticalMode || pages_list_.empty())
+    {
+        return;
+    }
+    LVImageSurfaceCache& cache = cr_dom_->getImageSurfaceCache();
+    // Requests for pages left behind are stale
+    cache.cancelPrewarm();
+    int columns = GetColumns();
+    int page = GetCurrPage();
+    int pages[2] = { page + columns, page - columns };
+    for (int i = 0; i < 2; i++)
+    {
+        if (pages[i] < 0 || pages[i] >= pages_list_.length())
+        {
+            continue;
+        }
+        LVRef<ldomXRange> range = GetPageDocRange(pages[i]);
+        if (range.isNull())
+        {
+            continue;
+        }
+        ldomXPointerEx ptr(range->getStart());
+        ldomXPointerEx end(range->getEnd());
+        for (int n = 0; n < PREWARM_MAX_ELEMENTS && ptr.nextElement() && ptr.compare(end) <= 0; n++)
+        {
+            ldomNode* node = ptr.getNode();
+            if (node->isImage())
+            {
+                cache.prewarm(node, width_, height_);
+            }
+        }
+    }
+}
+
 void LVDocView::GetImageScaleParams(ldomNode* node, int &imgheight, int &imgwidth)
 {
     lvRect margins = this->cfg_margins_;
@@ -2944,6 +3186,11 @@ static void UpdateOutline(LVDocView *doc_view,
 void LVDocView::GetOutline(LVPtrVector<LvTocItem, false> &outline)
 {
     outline.clear();
+    // Headings of text not imported yet are missing from TOC, not just unpositioned
+    if (IsImportIncomplete())
+    {
+        CompleteLayout();
+    }
     if (cr_dom_)
     {
         LvTocItem *outline_root = cr_dom_->getToc();
@@ -3394,18 +3641,18 @@ void printLongMsg(lString16 input)
 #endif
 
 
-SearchResult LVDocView::FindAndTrimNextPage(lString16 base1, lString16 query, int page, int start_last)
+SearchResult LVDocView::FindAndTrimNextPage(PageText& page_text, lString16 query, int start_last)
 {
     SearchResult result;
 
+    lString16 base1 = page_text.normalized();
     if (base1.empty())
     {
         return result;
     }
 
-    lString16 text1 = base1;
-
-    text1.lowercase();
+    int page = page_text.getPage();
+    lString16 text1 = page_text.lower();
     query.lowercase();
 
     int tlen1 = text1.length();
@@ -3437,15 +3684,8 @@ SearchResult LVDocView::FindAndTrimNextPage(lString16 base1, lString16 query, in
         return result;
     }
 
-    lString16 base2;
-    if (GetColumns() == 2)
-    {
-        base2 = GetPageText(page + 2);
-    }
-    else
-    {
-        base2 = GetPageText(page + 1);
-    }
+    PageText& page_text2 = GetPageTextData((GetColumns() == 2) ? page + 2 : page + 1);
+    lString16 base2 = page_text2.text();
 
     int qlen2 = qlen - qlen1;
 
@@ -3458,9 +3698,7 @@ SearchResult LVDocView::FindAndTrimNextPage(lString16 base1, lString16 query, in
         return result;
     }
 
-    LVRef<ldomXRange> range1ref = GetPageDocRange(page);
-    ldomXRange *range1 = range1ref.get();
-    ldomXPointer xp1 = range1->getXpointerByOffsetInPageText(pos);
+    ldomXPointer xp1 = page_text.getXPointer(pos);
     if(xp1.isNull())
     {
         return result;
@@ -3471,21 +3709,9 @@ SearchResult LVDocView::FindAndTrimNextPage(lString16 base1, lString16 query, in
         return result;
     }
 
-    LVRef<ldomXRange> range2ref1 = GetPageDocRange(page+1);
-    LVRef<ldomXRange> range2ref2 = GetPageDocRange(page+2);
-
-    ldomXRange *range2;
-    if (GetColumns() == 2)
-    {
-        range2 = range2ref2.get();
-    }
-    else
-    {
-        range2 = range2ref1.get();
-    }
     int lastIndex = qlen2-1;
     //CRLog::error("lastIndex PREVIEWS [%d] = [%d-%d-1]",lastIndex,qlen,qlen1);
-    ldomXPointer xp2 = range2->getXpointerByOffsetInPageText(lastIndex);
+    ldomXPointer xp2 = page_text2.getXPointer(lastIndex);
     if(xp2.isNull())
     {
         return result;
@@ -3515,23 +3741,22 @@ SearchResult LVDocView::FindAndTrimNextPage(lString16 base1, lString16 query, in
     return result;
 }
 
-LVArray<SearchResult> LVDocView::FindAndTrim(lString16 base, lString16 query, bool IgnoreCase, int page, int &end)
+LVArray<SearchResult> LVDocView::FindAndTrim(PageText& page_text, lString16 query, bool IgnoreCase, int &end)
 {
     LVArray<SearchResult> result;
 
-    lString16 text = base;
-    if (text.empty())
+    lString16 base = page_text.normalized();
+    if (base.empty())
     {
         return result;
     }
 
+    lString16 text = base;
     if (IgnoreCase)
     {
-        text.lowercase();
+        text = page_text.lower();
         query.lowercase();
     }
-    LVRef<ldomXRange> rangep = GetPageDocRange(page);
-    ldomXRange *range = rangep.get();
 
     LVArray<int> pos_arr;
     LVArray<ldomXPointer> xp_arr;
@@ -3552,7 +3777,7 @@ LVArray<SearchResult> LVDocView::FindAndTrim(lString16 base, lString16 query, bo
     {
         return result;
     }
-    xp_arr = range->getXpointerByOffsetInPageText(pos_arr);
+    xp_arr = page_text.getXPointers(pos_arr);
 
     if(pos_arr.length() != xp_arr.length())
     {
@@ -3775,54 +4000,38 @@ void ldomXRange::getRangeWordsNoRect(LVArray<ldomWord> &words_list)
     forEach2(&collector);
 }
 
-ldomXPointer ldomXRange::getXpointerByOffsetInPageText(int pos)
+PageText::PageText(int page, CrDom* dom, LVRef<ldomXRange> range)
+        : page_(page), dom_(dom), range_(range), runs_ready_(false)
 {
-    LVArray<int> pos_arr;
-    pos_arr.add(pos);
-    LVArray<ldomXPointer> xp_arr = this->getXpointerByOffsetInPageText(pos_arr);
-    if(!xp_arr.empty() && xp_arr.length()>0)
+    if (!range_.isNull())
     {
-        return xp_arr.get(0);
+        text_ = range_->GetRangeText();
     }
-    return ldomXPointer();
+    normalized_ = text_.ReplaceUnusualSpaces();
+    lower_ = normalized_;
+    lower_.lowercase();
 }
 
-LVArray<ldomXPointer> ldomXRange::getXpointerByOffsetInPageText(LVArray<int> pos_arr)
+void PageText::collectRuns()
 {
-    if (isNull())
+    runs_ready_ = true;
+    if (range_.isNull() || range_->isNull())
     {
-        //CRLog::error("range is null");
-        return LVArray<ldomXPointer>();
+        range_.Clear();
+        return;
     }
-    class CharCollector2 : public ldomNodeCallback
+    // Counts offsets same way as search preview text: chars of every visible
+    // text node from range start, and a space after every node but the last one
+    class RunsCollector : public ldomNodeCallback
     {
-        int counter_ = 0 ;
-        int curr_pos = -1;
-        int index = 0;
-        LVArray<int> pos_arr_;
-        LVArray<ldomXPointer> result;
-
-        bool endnode_found_;
-
+        int counter_ = 0;
+        LVArray<lInt32>& pos_;
+        LVArray<lInt32>& lens_;
+        LVArray<lUInt32>& nodes_;
+        LVArray<lInt32>& offsets_;
     public:
-
-        CharCollector2(LVArray<int> pos_arr){
-            if(!pos_arr.empty())
-            {
-                pos_arr_ = pos_arr;
-                curr_pos = pos_arr_.get(0);
-            }
-        }
-
-        int nextpos()
-        {
-            index++;
-            if(index>=pos_arr_.length())
-            {
-                return -1;
-            }
-            return pos_arr_.get(index);
-        }
+        RunsCollector(LVArray<lInt32>& pos, LVArray<lInt32>& lens, LVArray<lUInt32>& nodes,
+                LVArray<lInt32>& offsets) : pos_(pos), lens_(lens), nodes_(nodes), offsets_(offsets) {}
 
         // Called for each text fragment in range
         void processText(ldomNode *node, ldomXRange *range)
@@ -3831,69 +4040,86 @@ LVArray<ldomXPointer> ldomXRange::getXpointerByOffsetInPageText(LVArray<int> pos
             {
                 return;
             }
-
-            ldomXRange noderange = ldomXRange(node);
-
             int start = 0;
-            if(node == range->getStartNode() )
+            if (node == range->getStartNode())
             {
                 start = range->getStart().getOffset();
             }
-
             int len = node->getText().length();
-
-            for (int i = start; i < len; i++)
+            if (start < len)
             {
-                if(counter_== curr_pos)
-                {
-                    ldomXPointer xp = ldomXPointer(node,i);
-                    result.add(xp);
-
-
-                    ldomXPointerEx end(xp);
-                    curr_pos = nextpos();
-                    if(curr_pos == -1)
-                    {
-                        range->setEnd(end); //foreach2 escape command
-                        return;
-                    }
-                }
-                counter_++;
+                pos_.add(counter_);
+                lens_.add(len - start);
+                nodes_.add(node->getDataIndex());
+                offsets_.add(start);
+                counter_ += len - start;
             }
-            if(noderange.getEnd() != range->getEnd())
+            if (ldomXRange(node).getEnd() != range->getEnd())
             {
                 counter_++; // adding space in the end of the node
             }
-            //todo rewrite this without cycle, using node text length
-            /*
-            counter_ += len;
-            if(counter_>=pos_temp)
-            {
-                resNode_ = node;
-                offsetInNode_ = len - (counter_ - pos_temp);
-                ldomXPointerEx end(node,offsetInNode_);
-                range->setEnd(end); //foreach2 escape command
-            }
-            */
         }
 
-        bool onElement(ldomNode * node) {
+        bool onElement(ldomNode * node)
+        {
             return node->getRendMethod() != erm_invisible;
         }
+    };
+    RunsCollector collector(run_pos_, run_lens_, run_nodes_, run_offsets_);
+    range_->forEach2(&collector);
+    range_.Clear();
+}
 
-        bool processElement(ldomNode* node, ldomXRange * range)
+ldomXPointer PageText::getXPointer(int pos)
+{
+    if (!runs_ready_)
+    {
+        collectRuns();
+    }
+    // last run starting at or before pos
+    int a = 0;
+    int b = run_pos_.length();
+    while (a < b)
+    {
+        int mid = (a + b) / 2;
+        if (run_pos_[mid] <= pos)
         {
-            return ldomNodeCallback::processElement(node,range);
+            a = mid + 1;
         }
-
-        LVArray<ldomXPointer> getResult() {
-            return result;
+        else
+        {
+            b = mid;
         }
-    };
+    }
+    int run = a - 1;
+    if (run < 0 || pos >= run_pos_[run] + run_lens_[run])
+    {
+        return ldomXPointer();
+    }
+    ldomNode* node = dom_->getTinyNode(run_nodes_[run]);
+    return ldomXPointer(node, run_offsets_[run] + pos - run_pos_[run]);
+}
 
-    CharCollector2 collector = CharCollector2(pos_arr);
-    forEach2(&collector);
-    return collector.getResult();
+LVArray<ldomXPointer> PageText::getXPointers(const LVArray<int>& pos_arr)
+{
+    LVArray<ldomXPointer> result;
+    int last = -1;
+    for (int i = 0; i < pos_arr.length(); i++)
+    {
+        int pos = pos_arr[i];
+        if (pos <= last)
+        {
+            break;
+        }
+        ldomXPointer xp = getXPointer(pos);
+        if (xp.isNull())
+        {
+            break;
+        }
+        result.add(xp);
+        last = pos;
+    }
+    return result;
 }
 
 LVArray<Hitbox> LVDocView::unionRects(LVArray<Hitbox> rects)
@@ -3993,19 +4219,18 @@ LVArray<SearchResult> LVDocView::SearchForTextPreviews(int page, lString16 query
     }
 
 
-    lString16 pagetext = GetPageText(page);
-    if (pagetext.empty())
+    PageText& page_text = GetPageTextData(page);
+    if (page_text.text().empty())
     {
         return result;
     }
 
-    pagetext = pagetext.ReplaceUnusualSpaces();
     int end = 0;
-    result = FindAndTrim(pagetext, query, true, page, end);
+    result = FindAndTrim(page_text, query, true, end);
 
-    if (page < GetPagesCount() && CheckNextPagePreviews(pagetext, query, end))
+    if (page < GetPagesCount() && CheckNextPagePreviews(page_text.normalized(), query, end))
     {
-        SearchResult last = FindAndTrimNextPage(pagetext, query, page, end);
+        SearchResult last = FindAndTrimNextPage(page_text, query, end);
         if (!last.preview_.empty())
         {
             result.add(last);
@@ -4372,29 +4597,273 @@ LVArray<Hitbox> LVDocView::SearchForTextHitboxes(int page, lString16 query)
     return unionRectsTCheck(result);
 }
 
-LVArray<Hitbox> LVDocView::GetPageHitboxesRTL(ldomXRange *in_range, int page)
+// Two spreads of pages in two columns mode, with previous and next ones
+#define PAGE_GEOMETRY_CACHE_PAGES 8
+// Current and next spread for search previews, with previous ones
+#define PAGE_TEXT_CACHE_PAGES 8
+
+PageGeometry::PageGeometry(int page, CrDom* dom, const LVArray<Hitbox>& hitboxes)
+        : page_(page), dom_(dom)
 {
-    LVArray<Hitbox> Hitboxes;
-    LVArray<Hitbox> Result;
-    if (page != hitboxesCash.getPage() || hitboxesCash.isEmpty())
+    int count = hitboxes.length();
+    rects_.reserve(count * 4);
+    nodes_.reserve(count);
+    starts_.reserve(count);
+    ends_.reserve(count);
+    text_pos_.reserve(count + 1);
+    for (int i = 0; i < count; i++)
     {
-        //CRLog::error("Generating new cash for page %d ",page);
-        //CRLog::error("old page = %d",hitboxesCash.getPage());
-        GoToPage(page);
-        hitboxesCash = PageHitboxesCash(page, GetPageHitboxes());
+        Hitbox hitbox = hitboxes.get(i);
+        rects_.add(hitbox.left_);
+        rects_.add(hitbox.right_);
+        rects_.add(hitbox.top_);
+        rects_.add(hitbox.bottom_);
+        ldomNode* node = hitbox.word_.getNode();
+        nodes_.add(node ? node->getDataIndex() : 0);
+        starts_.add(hitbox.word_.getStart());
+        ends_.add(hitbox.word_.getEnd());
+        text_pos_.add(text_pool_.length());
+        text_pool_.append(hitbox.text_);
+    }
+    text_pos_.add(text_pool_.length());
+}
+
+PageGeometry* PageGeometryCache::find(int page)
+{
+    for (int i = 0; i < pages_.length(); i++)
+    {
+        if (pages_[i]->getPage() == page)
+        {
+            if (i > 0)
+            {
+                pages_.move(0, i);
+            }
+            return pages_[0];
+        }
     }
-    Hitboxes = hitboxesCash.getArray();
+    return NULL;
+}
 
-    if (Hitboxes.empty())
+PageGeometry* PageGeometryCache::add(PageGeometry* geometry)
+{
+    while (pages_.length() >= PAGE_GEOMETRY_CACHE_PAGES)
     {
-        return Hitboxes ;
+        delete pages_.remove(pages_.length() - 1);
     }
+    pages_.insert(0, geometry);
+    return geometry;
+}
+
+PageText* PageTextCache::find(int page)
+{
+    for (int i = 0; i < pages_.length(); i++)
+    {
+        if (pages_[i]->getPage() == page)
+        {
+            if (i > 0)
+            {
+                pages_.move(0, i);
+            }
+            return pages_[0];
+        }
+    }
+    return NULL;
+}
+
+PageText* PageTextCache::add(PageText* text)
+{
+    while (pages_.length() >= PAGE_TEXT_CACHE_PAGES)
+    {
+        delete pages_.remove(pages_.length() - 1);
+    }
+    pages_.insert(0, text);
+    return text;
+}
+
+// Text nodes are grouped after elements of any name
+#define XPOINTER_TEXT_KEY 0x10000
+
+int XPointerIndex::getTable(ldomNode* parent)
+{
+    lUInt32 parent_index = parent->getDataIndex();
+    int table;
+    if (tables_.get(parent_index, table))
+    {
+        return table;
+    }
+    int count = parent->getChildCount();
+    // key in high bits and child position in low ones, so sort keeps document order
+    LVArray<lUInt64> order(count, 0);
+    LVArray<lUInt32> children(count, 0);
+    for (int i = 0; i < count; i++)
+    {
+        ldomNode* child = parent->getChildNode(i);
+        lUInt64 key = child->isText() ? XPOINTER_TEXT_KEY : child->getNodeId();
+        order[i] = (key << 32) | (lUInt32) i;
+        children[i] = child->getDataIndex();
+    }
+    std::sort(order.get(), order.get() + count);
+    table = table_starts_.length();
+    table_starts_.add(keys_.length());
+    table_lens_.add(count);
+    for (int i = 0; i < count; i++)
+    {
+        keys_.add((lUInt32) (order[i] >> 32));
+        nodes_.add(children[(int) (order[i] & 0xFFFFFFFF)]);
+    }
+    tables_.set(parent_index, table);
+    return table;
+}
+
+ldomNode* XPointerIndex::findChild(ldomNode* parent, lUInt32 key, int ordinal, int* count)
+{
+    if (count)
+    {
+        *count = 0;
+    }
+    if (!parent->isElement())
+    {
+        return NULL;
+    }
+    int table = getTable(parent);
+    int start = table_starts_[table];
+    const lUInt32* keys = keys_.get() + start;
+    const lUInt32* end = keys + table_lens_[table];
+    const lUInt32* first = std::lower_bound(keys, end, key);
+    if (count)
+    {
+        *count = (int) (std::upper_bound(first, end, key) - first);
+    }
+    if (ordinal < 0 || ordinal >= end - first || first[ordinal] != key)
+    {
+        return NULL;
+    }
+    return parent->getCrDom()->getTinyNode(nodes_[start + (int) (first - keys) + ordinal]);
+}
+
+// Same steps as CrDom::createXPointer(), with child lookups through tables
+ldomXPointer XPointerIndex::createXPointer(CrDom* dom, const lString16& xpath)
+{
+    if (xpath.empty() || xpath[0] == '#')
+    {
+        return dom->createXPointer(xpath);
+    }
+    const lChar16* str = xpath.c_str();
+    ldomNode* currNode = dom->getRootNode();
+    lString16 name;
+    int index = -1;
+    while (*str)
+    {
+        switch (ParseXPathStep(str, name, index))
+        {
+            case xpath_step_error:
+                return ldomXPointer();
+            case xpath_step_element:
+            {
+                lUInt32 key = dom->getElementNameIndex(name.c_str());
+                int ordinal = index > 0 ? index - 1 : 0;
+                ldomNode* foundItem = findChild(currNode, key, ordinal);
+                if (foundItem == NULL && currNode->getChildCount() == 1)
+                {
+                    // saved pointers work after moving of some part of path one element deeper
+                    foundItem = findChild(currNode->getChildNode(0), key, ordinal);
+                }
+                if (foundItem == NULL)
+                {
+                    return ldomXPointer();
+                }
+                currNode = foundItem;
+                break;
+            }
+            case xpath_step_text:
+            {
+                int count;
+                ldomNode* foundItem = findChild(currNode, XPOINTER_TEXT_KEY, index == -1 ? 0 : index - 1, &count);
+                if (foundItem == NULL || (index == -1 && count > 1))
+                {
+                    return ldomXPointer();
+                }
+                currNode = foundItem;
+                break;
+            }
+            case xpath_step_nodeindex:
+                if (index <= 0 || index > (int) currNode->getChildCount())
+                {
+                    return ldomXPointer();
+                }
+                currNode = currNode->getChildNode(index - 1);
+                break;
+            case xpath_step_point:
+                if (*str)
+                {
+                    return ldomXPointer();
+                }
+                if (currNode->isElement())
+                {
+                    if (index < 0 || index > (int) currNode->getChildCount())
+                    {
+                        return ldomXPointer();
+                    }
+                }
+                else if (index < 0 || index > (int) currNode->getText().length())
+                {
+                    return ldomXPointer();
+                }
+                return ldomXPointer(currNode, index);
+        }
+    }
+    return ldomXPointer(currNode, -1);
+}
+
+XPointerIndex::Entry* XPointerIndex::find(CrDom* dom, const lString16& xpath)
+{
+    int id;
+    if (!ids_.get(xpath, id))
+    {
+        ldomXPointer xp = createXPointer(dom, xpath);
+        id = -1;
+        if (!xp.isNull())
+        {
+            id = entries_.length();
+            entries_.add(Entry(xp.getNode()->getDataIndex(), xp.getOffset()));
+        }
+        ids_.set(xpath, id);
+    }
+    return id < 0 ? NULL : &entries_[id];
+}
+
+void XPointerIndex::reset()
+{
+    ids_.clear();
+    entries_.clear();
+    tables_.clear();
+    table_starts_.clear();
+    table_lens_.clear();
+    keys_.clear();
+    nodes_.clear();
+}
+
+const PageGeometry& LVDocView::GetPageGeometry(int page)
+{
+    PageGeometry* geometry = hitboxesCash.find(page);
+    if (geometry == NULL)
+    {
+        GoToPage(page);
+        geometry = hitboxesCash.add(new PageGeometry(page, cr_dom_, GetPageHitboxes()));
+    }
+    return *geometry;
+}
+
+LVArray<Hitbox> LVDocView::GetPageHitboxesRTL(ldomXRange *in_range, int page)
+{
+    LVArray<Hitbox> Result;
+    const PageGeometry& geometry = GetPageGeometry(page);
     int startIndex = -1;
     int endIndex   = -1;
 
-    for (int i = 0; i < Hitboxes.length(); i++)
+    for (int i = 0; i < geometry.length(); i++)
     {
-        ldomWord word = Hitboxes.get(i).word_;
+        ldomWord word = geometry.word(i);
         ldomXRange hbrange(word.getStartXPointer(), word.getEndXPointer(), 0);
         if ( in_range->isNull()) { break; }
         if ( hbrange.isNull())   { continue; }
@@ -4405,13 +4874,16 @@ LVArray<Hitbox> LVDocView::GetPageHitboxesRTL(ldomXRange *in_range, int page)
 
     if(startIndex ==-1 || endIndex == -1)
     {
-        CRLog::error("failed to get startindex or endindex (%d)(%d)",startIndex,endIndex);
+        if (geometry.length() > 0)
+        {
+            CRLog::error("failed to get startindex or endindex (%d)(%d)",startIndex,endIndex);
+        }
         return Result;
     }
 
     for (int i = startIndex; i <= endIndex; i++)
     {
-        Result.add(Hitboxes.get(i));
+        Result.add(geometry.get(i));
     }
     return Result;
 }
@@ -4544,8 +5016,7 @@ LVArray<Hitbox> LVDocView::GetPageHitboxes(ldomXRange* in_range, bool rtl_enable
                 //        LCSTR(word_chars.get(i+4).getText()));
 #endif //OREDEBUG
                 lString16 para_end = lString16("\n");// + lString16::itoa(para_counter);
-                Hitbox *hitbox = new Hitbox(l, r, t, b, para_end);
-                result.add(*hitbox);
+                result.add(Hitbox(l, r, t, b, para_end));
                 para_repeat_counter++;
                 last_top = para_rect.top;
             }
@@ -4663,8 +5134,7 @@ LVArray<Hitbox> LVDocView::GetPageHitboxes(ldomXRange* in_range, bool rtl_enable
             }
 
             //CRLog::error("linebreak letter = %s",LCSTR(text));
-            Hitbox *hitbox = new Hitbox(l, r, t, b, text, word);
-            result.add(*hitbox);
+            result.add(Hitbox(l, r, t, b, text, word));
         }
         else
         { //usual single-line words
@@ -4730,8 +5200,7 @@ LVArray<Hitbox> LVDocView::GetPageHitboxes(ldomXRange* in_range, bool rtl_enable
             //CRLog::error("usual letter = %s rect [%f:%f]:[%f:%f]", LCSTR(text),l*page_width,t*page_height,r*page_width,b*page_height);
             //CRLog::error("usual letter = %s rect %d;%f:%f:%f:%f", LCSTR(text),page_,l,r,t,b);
 
-            Hitbox *hitbox = new Hitbox(l, r, t, b, text, word);
-            result.add(*hitbox);
+            result.add(Hitbox(l, r, t, b, text, word));
         }
     }
     //adding last para end on page if needed
@@ -4774,8 +5243,7 @@ LVArray<Hitbox> LVDocView::GetPageHitboxes(ldomXRange* in_range, bool rtl_enable
                 float b = rect.bottom / page_height;
 #endif // DEBUG_PARA_END_BLOCKS
                 lString16 para_end = lString16("\n");
-                Hitbox *hitbox = new Hitbox(l, r, t, b, para_end);
-                result.add(*hitbox);
+                result.add(Hitbox(l, r, t, b, para_end));
             }
         }
     }
@@ -4791,8 +5259,7 @@ LVArray<Hitbox> LVDocView::GetPageHitboxes(ldomXRange* in_range, bool rtl_enable
 			float t = (imgrect.top) / page_height;
 			float b = (imgrect.bottom) / page_height;
 			lString16 imagestring = lString16("IMAGE");
-			Hitbox *hitbox = new Hitbox(l, r, t, b, imagestring);
-			result.add(*hitbox);
+			result.add(Hitbox(l, r, t, b, imagestring));
 		}
 	}
 #endif
@@ -4827,8 +5294,7 @@ LVArray<Hitbox> LVDocView::GetPageLinks()
         float t = rect.top / page_height;
         float r = (rect.right + gTextLeftShift) / page_width;
         float b = rect.bottom / page_height;
-        Hitbox *hitbox = new Hitbox(l, r, t, b, href);
-        result.add(*hitbox);
+        result.add(Hitbox(l, r, t, b, href));
     }
     return result;
 }
@@ -4842,27 +5308,48 @@ lString16 LVDocView::GetPageText(int page_index)
     {
         page_index = GetCurrPage();
     }
-    lString16 text;
-    LVRef<ldomXRange> range = GetPageDocRange(page_index);
-    text = range->GetRangeText();
-    return text;
+    return GetPageTextData(page_index).text();
+}
+
+PageText& LVDocView::GetPageTextData(int page_index)
+{
+    CHECK_RENDER("GetPageTextData()")
+    if (page_index < 0 || page_index >= pages_list_.length())
+    {
+        page_index = GetCurrPage();
+    }
+    // Callers may hold text of an earlier page while asking for the next one,
+    // so cached texts are never dropped here
+    PageText* text = pageTextCash.find(page_index);
+    if (text == NULL)
+    {
+        text = pageTextCash.add(new PageText(page_index, cr_dom_, GetPageDocRange(page_index)));
+    }
+    return *text;
 }
 
 lString16 LVDocView::GetHitboxHash(float l,float r,float t,float b)
 {
-    lString16 result;
-    result<<lString16(std::to_string(l).c_str()).substr(0,6).c_str();
-    result<<":";
-    result<<lString16(std::to_string(r).c_str()).substr(0,6).c_str();
-    result<<":";
-    result<<lString16(std::to_string(t).c_str()).substr(0,6).c_str();
-    result<<":";
-    result<<lString16(std::to_string(b).c_str()).substr(0,6).c_str();
-    //CRLog::error("hitboxhash = %s",LCSTR(result));
-    return result;
+    // First 6 chars of std::to_string() of every coord, formatted in one buffer
+    float coords[4] = { l, r, t, b };
+    char buf[4 * 7];
+    int len = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        char num[64];
+        int n = snprintf(num, sizeof(num), "%f", coords[i]);
+        n = (n < 6) ? n : 6;
+        if (i > 0)
+        {
+            buf[len++] = ':';
+        }
+        memcpy(buf + len, num, n);
+        len += n;
+    }
+    return lString16(buf, len);
 }
 
-ldomWord LVDocView::FindldomWordFromMap(ldomWordMap m, lString16 key)
+ldomWord LVDocView::FindldomWordFromMap(const ldomWordMap& m, lString16 key)
 {
     lUInt32 in_key = key.getHash();
     ldomWord result;
@@ -4877,14 +5364,12 @@ ldomWordMap LVDocView::GetldomWordMapFromPage(int page)
 {
     ldomWordMap m;
 
-    this->GoToPage(page);
-
-    LVArray<Hitbox> hitboxes = this->GetPageHitboxes();
-    for (int i = 0; i < hitboxes.length(); i++)
+    const PageGeometry& geometry = GetPageGeometry(page);
+    for (int i = 0; i < geometry.length(); i++)
     {
-        Hitbox curr = hitboxes.get(i);
-        lUInt32 key = GetHitboxHash(curr.left_,curr.right_,curr.top_,curr.bottom_).getHash();
-        m[key] = curr.word_;
+        lUInt32 key = GetHitboxHash(geometry.left(i), geometry.right(i),
+                geometry.top(i), geometry.bottom(i)).getHash();
+        m[key] = geometry.word(i);
     }
     return m;
 }
@@ -4892,26 +5377,14 @@ ldomWordMap LVDocView::GetldomWordMapFromPage(int page)
 lString16 LVDocView::GetXpathFromPageById(int page, int id, bool IsEndXpath)
 {
     //CRLog::error("GetXpathFromPageById %d , %d ",page, id);
-    if (page != hitboxesCash.getPage() || hitboxesCash.isEmpty())
-    {
-        //CRLog::error("Generating new cash for page %d ",page);
-        //CRLog::error("old page = %d",hitboxesCash.getPage());
-        this->GoToPage(page);
-        hitboxesCash = PageHitboxesCash( page, this->GetPageHitboxes() );
-    }
-    //else
-    //{
-    //    CRLog::error("Using Cash for page %d ",page);
-    //}
-    ldomWord word;
-
-    if (id < 0 && id >= hitboxesCash.length())
+    const PageGeometry& geometry = GetPageGeometry(page);
+    if (id < 0 || id >= geometry.length())
     {
         //CRLog::error("out of range");
         return lString16("-");
     }
 
-    word = hitboxesCash.get(id).word_;
+    ldomWord word = geometry.word(id);
 
     if (word.isNull())
     {
@@ -4947,23 +5420,14 @@ lString16 LVDocView::GetXpathFromPageById(int page, int id, bool IsEndXpath)
 ldomXPointer LVDocView::GetXpointerFromPageById(int page, int id, bool IsEndXpath)
 {
     //CRLog::error("GetXpathFromPageById %d , %d ",page, id);
-    if (page != hitboxesCash.getPage() || hitboxesCash.isEmpty())
-    {
-        //CRLog::error("Generating new cash for page %d ",page);
-        //CRLog::error("old page = %d",hitboxesCash.getPage());
-        this->GoToPage(page);
-        hitboxesCash = PageHitboxesCash( page, this->GetPageHitboxes() );
-    }
-
-    ldomWord word;
-
-    if (id < 0 && id >= hitboxesCash.length())
+    const PageGeometry& geometry = GetPageGeometry(page);
+    if (id < 0 || id >= geometry.length())
     {
         //CRLog::error("out of range");
         return ldomXPointer();
     }
 
-    word = hitboxesCash.get(id).word_;
+    ldomWord word = geometry.word(id);
 
     if (word.isNull())
     {
@@ -4988,7 +5452,7 @@ ldomXPointer LVDocView::GetXpointerFromPageById(int page, int id, bool IsEndXpat
 }
 
 
-lString16 LVDocView::GetXpathByRectCoords(lString16 key, ldomWordMap m)
+lString16 LVDocView::GetXpathByRectCoords(lString16 key, const ldomWordMap& m)
 {
     if (key == lString16("-"))
     {
@@ -5027,10 +5491,9 @@ lString16Map LVDocView::GetWordsIndexesMap()
     for (int page_index = 0; page_index < this->GetPagesCount(); page_index++)
     {
 
-        lString16 pagetext = this->GetPageText(page_index);
+        lString16 pagetext = GetPageTextData(page_index).normalized();
 
         pagetext.replaceAllPunctuation(L" ");
-        pagetext = pagetext.ReplaceUnusualSpaces();
         pagetext.trimDoubleSpaces(false, false, false);
         lString16Collection collection;
         collection.parse(pagetext, ' ', true);
@@ -5047,102 +5510,355 @@ lString16Map LVDocView::GetWordsIndexesMap()
     return result;
 }
 
-LVArray<lString16> subset(LVArray<lString16> arr, int startindex, int num)
+// Chars that aren't letters become separate tokens, same as for search
+#define PHRASE_WORD_PROPS (CH_PROP_ALPHA | CH_PROP_SPACE | CH_PROP_HIEROGLYPH)
+// Words shorter than this don't start or end phrases
+#define PHRASE_MIN_WORD 3
+
+// Separators of former per-page splitting: unusual spaces were replaced with ' ',
+// and trimDoubleSpaces() folded '\t', '\r' and '\n' of block breaks into ' ' too,
+// so phrases go on across paragraphs as they did
+static inline bool isPhraseSpace(lChar16 ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n'
+            || ch == 0x00A0 || ch == 0x180E || (ch >= 0x2000 && ch <= 0x200B)
+            || ch == 0x202F || ch == 0x205F || ch == 0x3000 || ch == 0xFEFF;
+}
+
+void PhraseIndex::addPhrase(const lChar16* text, int first, int count)
 {
-    LVArray<lString16> result;
-    if(num==0)
+    for (int i = first; i < first + count; i++)
     {
-        return result;
+        // single char token is a letter or punctuation mark, the latter breaks phrase
+        if (tok_lens_[i] == 1 && !(lGetCharProps(text[tok_starts_[i]]) & PHRASE_WORD_PROPS))
+        {
+            return;
+        }
     }
-    if(num==1)
+    int last = first + count - 1;
+    if (tok_lens_[first] < PHRASE_MIN_WORD || tok_lens_[last] < PHRASE_MIN_WORD)
     {
-        return arr;
+        return;
     }
-
-    for (int j = startindex; j < startindex + num; j++)
+    key_.reset(64);
+    for (int i = first; i <= last; i++)
     {
-        if (j >= arr.length())
+        if (i > first)
         {
-            break;
+            key_.append(1, ' ');
         }
-        result.add(arr.get(j));
+        key_.append(text + tok_starts_[i], tok_lens_[i]);
+    }
+    int id = intern(key_);
+    int slot = slots_[id];
+    if (slot)
+    {
+        postings_[slot - 1].count++;
+    }
+    else
+    {
+        postings_.add(Posting(id, 1));
+        slots_[id] = postings_.length();
     }
-    return result;
 }
 
-bool CheckIfSetHasPunctuation(LVArray<lString16> set)
+int PhraseIndex::intern(const lString16& phrase)
 {
-    for (int i = 0; i < set.length(); i++)
+    int id;
+    if (!ids_.get(phrase, id))
     {
-        lString16 curr = set.get(i);
-        if (curr.CheckIfHasPunctuation())
-        {
-            return true;
-        }
+        id = phrases_.length();
+        phrases_.add(phrase);
+        ids_.set(phrase, id);
+        slots_.add(0);
+        totals_.add(0);
     }
-    return false;
+    return id;
 }
 
-lString16Map LVDocView::GetPhrasesIndexesMapForPage(int page_index)
+void PhraseIndex::addPage(int page, const lString16& text)
 {
-    lString16Map result;
-
-    lString16 pagetext = this->GetPageText(page_index);
+    if (page < 0 || hasPage(page))
+    {
+        return;
+    }
+    while (page_starts_.length() <= page)
+    {
+        page_starts_.add(-1);
+        page_ends_.add(-1);
+    }
+    int page_start = postings_.length();
 
-    pagetext.lowercase();
-    pagetext.AddtoAllPunctuation(L" ", L" ");
+    const lChar16* s = text.c_str();
+    int len = text.length();
+    tok_starts_.clear();
+    tok_lens_.clear();
+    for (int i = 0; i < len;)
+    {
+        lChar16 ch = s[i];
+        if (isPhraseSpace(ch))
+        {
+            i++;
+            continue;
+        }
+        int start = i++;
+        if (lGetCharProps(ch) & PHRASE_WORD_PROPS)
+        {
+            while (i < len && !isPhraseSpace(s[i]) && (lGetCharProps(s[i]) & PHRASE_WORD_PROPS))
+            {
+                i++;
+            }
+        }
+        tok_starts_.add(start);
+        tok_lens_.add(i - start);
+    }
 
-    pagetext = pagetext.ReplaceUnusualSpaces();
-    pagetext.trimDoubleSpaces(false, false, false);
-    lString16Collection collection;
-    collection.parse(pagetext, ' ', true);
-    LVArray<lString16> coll;
-    for (int i = 0; i < collection.length(); i++)
+    int count = tok_starts_.length();
+    for (int i = 0; i < count; i++)
     {
-        coll.add(collection.at(i));
+        if (tok_lens_[i] >= PHRASE_MIN_WORD)
+        {
+            addPhrase(s, i, 1);
+        }
+        // Phrases are cut at the end of page, so last words are counted
+        // again as shorter phrases
+        addPhrase(s, i, count - i < 2 ? count - i : 2);
+        addPhrase(s, i, count - i < 3 ? count - i : 3);
     }
-    LVArray<LVArray<lString16>> bigarray;
 
-    for (int i = 0; i < coll.length(); i++)
+    // postings of page are ordered by phrase, clear slots for next page
+    for (int i = page_start; i < postings_.length(); i++)
     {
-        LVArray<lString16> temp2 = subset(coll, i, 2);
-        LVArray<lString16> temp3 = subset(coll, i, 3);
-        bigarray.add(temp2);
-        bigarray.add(temp3);
+        slots_[postings_[i].phrase] = 0;
+        totals_[postings_[i].phrase] += postings_[i].count;
     }
+    const lString16Collection& phrases = phrases_;
+    std::sort(postings_.get() + page_start, postings_.get() + postings_.length(),
+            [&phrases](const Posting& p1, const Posting& p2) {
+                return phrases[p1.phrase].compare(phrases[p2.phrase]) < 0;
+            });
+    page_starts_[page] = page_start;
+    page_ends_[page] = postings_.length();
+    modified_ = true;
+}
 
-    for (int i = 0; i < coll.length(); i++)
+void PhraseIndex::findPrefix(const lString16& prefix, int max_count, LVArray<Posting>& result)
+{
+    result.clear();
+    const lString16Collection& phrases = phrases_;
+    if (sorted_.length() != phrases_.length())
     {
-        lString16 curr = coll.get(i);
-        if (curr.length() < 3 || curr.CheckIfHasPunctuation())
+        sorted_.clear();
+        sorted_.reserve(phrases_.length());
+        for (int i = 0; i < phrases_.length(); i++)
         {
-            continue;
+            sorted_.add(i);
         }
-        insert(result, std::string(LCSTR(curr)));
+        std::sort(sorted_.get(), sorted_.get() + sorted_.length(),
+                [&phrases](int id1, int id2) {
+                    return phrases[id1].compare(phrases[id2]) < 0;
+                });
+    }
+    int* it = std::lower_bound(sorted_.get(), sorted_.get() + sorted_.length(), prefix,
+            [&phrases](int id, const lString16& key) {
+                return phrases[id].compare(key) < 0;
+            });
+    for (; it < sorted_.get() + sorted_.length() && phrases_[*it].startsWith(prefix); it++)
+    {
+        result.add(Posting(*it, totals_[*it]));
     }
+    std::sort(result.get(), result.get() + result.length(),
+            [&phrases](const Posting& p1, const Posting& p2) {
+                if (p1.count != p2.count)
+                {
+                    return p1.count > p2.count;
+                }
+                return phrases[p1.phrase].compare(phrases[p2.phrase]) < 0;
+            });
+    if (max_count > 0 && result.length() > max_count)
+    {
+        result.erase(max_count, result.length() - max_count);
+    }
+}
+
+static const char* phrase_index_magic = "PhrIndex";
 
-    for (int i = 0; i < bigarray.length(); i++)
+bool PhraseIndex::serialize(SerialBuf& buf)
+{
+    if (buf.error())
+    {
+        return false;
+    }
+    buf.putMagic(phrase_index_magic);
+    int pos = buf.pos();
+    buf << layout_;
+    buf << (lUInt32) phrases_.length();
+    for (int i = 0; i < phrases_.length(); i++)
+    {
+        buf << phrases_[i];
+    }
+    buf << (lUInt32) page_starts_.length();
+    for (int i = 0; i < page_starts_.length(); i++)
     {
-        LVArray<lString16> currarr = bigarray.get(i);
-        if (CheckIfSetHasPunctuation(currarr))
+        buf << (lInt32) page_starts_[i] << (lInt32) page_ends_[i];
+    }
+    buf << (lUInt32) postings_.length();
+    for (int i = 0; i < postings_.length(); i++)
+    {
+        buf << (lUInt32) postings_[i].phrase << (lUInt32) postings_[i].count;
+    }
+    buf.putMagic(phrase_index_magic);
+    buf.putCRC(buf.pos() - pos);
+    return !buf.error();
+}
+
+bool PhraseIndex::deserialize(SerialBuf& buf, lUInt32 layout)
+{
+    reset();
+    if (buf.error() || !buf.checkMagic(phrase_index_magic))
+    {
+        return false;
+    }
+    int pos = buf.pos();
+    lUInt32 saved_layout;
+    buf >> saved_layout;
+    if (buf.error() || saved_layout != layout)
+    {
+        return false;
+    }
+    lUInt32 count;
+    buf >> count;
+    for (lUInt32 i = 0; i < count && !buf.error(); i++)
+    {
+        lString16 phrase;
+        buf >> phrase;
+        intern(phrase);
+    }
+    buf >> count;
+    for (lUInt32 i = 0; i < count && !buf.error(); i++)
+    {
+        lInt32 start, end;
+        buf >> start >> end;
+        page_starts_.add(start);
+        page_ends_.add(end);
+    }
+    buf >> count;
+    for (lUInt32 i = 0; i < count && !buf.error(); i++)
+    {
+        lUInt32 phrase, n;
+        buf >> phrase >> n;
+        if (phrase >= (lUInt32) phrases_.length())
         {
-            continue;
+            buf.seterror();
+            break;
         }
-        if (currarr.get(0).length() < 3 || currarr.get(currarr.length() - 1).length() < 3)
+        postings_.add(Posting(phrase, n));
+        totals_[phrase] += n;
+    }
+    for (int i = 0; i < page_starts_.length() && !buf.error(); i++)
+    {
+        if (page_starts_[i] > page_ends_[i] || page_ends_[i] > postings_.length())
         {
-            continue;
+            buf.seterror();
         }
-        lString16 str;
-        for (int j = 0; j < currarr.length(); j++)
+    }
+    if (!buf.checkMagic(phrase_index_magic))
+    {
+        buf.seterror();
+    }
+    buf.checkCRC(buf.pos() - pos);
+    if (buf.error())
+    {
+        reset();
+        return false;
+    }
+    layout_ = layout;
+    return true;
+}
+
+void PhraseIndex::reset()
+{
+    ids_.clear();
+    phrases_.clear();
+    totals_.clear();
+    sorted_.clear();
+    page_starts_.clear();
+    page_ends_.clear();
+    postings_.clear();
+    slots_.clear();
+    layout_ = 0;
+    modified_ = false;
+}
+
+PhraseIndex& LVDocView::GetPhrasesIndex(int page_start, int page_end)
+{
+    CHECK_RENDER("GetPhrasesIndex()")
+    CompleteLayoutForPage(page_end);
+    if (phraseIndex.empty())
+    {
+        if (phrase_cache_file_.empty() && !cfg_phrase_cache_dir_.empty() && !stream_.isNull())
+        {
+            lString16 name = lString16::itoa((lUInt32) stream_->GetSize());
+            name << "-" << lString16::itoa(stream_->getcrc32()) << ".phrases";
+            phrase_cache_file_ = LVCombinePaths(cfg_phrase_cache_dir_, name);
+        }
+        // Saved index is for full layout, prefix pages can't be checked against it
+        if ((layout_incomplete_ || IsImportIncomplete())
+                && !phrase_cache_file_.empty() && LVFileExists(phrase_cache_file_))
+        {
+            CompleteLayout();
+        }
+        // Postings are bound to pages, saved index is only used for same layout
+        SerialBuf layout(0, true);
+        pages_list_.serialize(layout);
+        lUInt32 checksum = layout.getCRC();
+        LVStreamRef stream = phrase_cache_file_.empty()
+                ? LVStreamRef() : LVOpenFileStream(phrase_cache_file_.c_str(), LVOM_READ);
+        if (!stream.isNull())
+        {
+            lvsize_t size = stream->GetSize();
+            SerialBuf buf((int) size, false);
+            lvsize_t bytes_read = 0;
+            if (stream->Read(buf.buf(), size, &bytes_read) != LVERR_OK || bytes_read != size
+                    || !phraseIndex.deserialize(buf, checksum))
+            {
+                CRLog::debug("GetPhrasesIndex: no phrases saved for current layout");
+            }
+        }
+        phraseIndex.setLayout(checksum);
+    }
+    for (int page_index = page_start; page_index < page_end; page_index++)
+    {
+        if (page_index >= 0 && page_index < pages_list_.length() && !phraseIndex.hasPage(page_index))
         {
-            str += currarr.get(j);
-            str += L" ";
+            phraseIndex.addPage(page_index, GetPageTextData(page_index).lower());
         }
-        str = str.substr(0, str.length() - 1);
-        insert(result, std::string(LCSTR(str)));
     }
+    return phraseIndex;
+}
 
-    return result;
+void LVDocView::SavePhrasesIndex()
+{
+    // Index of prefix layout would replace the one saved for full layout
+    if (phrase_cache_file_.empty() || !phraseIndex.isModified()
+            || layout_incomplete_ || IsImportIncomplete())
+    {
+        return;
+    }
+    SerialBuf buf(64 * 1024, true);
+    if (!phraseIndex.serialize(buf))
+    {
+        return;
+    }
+    LVStreamRef stream = LVOpenFileStream(phrase_cache_file_.c_str(), LVOM_WRITE);
+    lvsize_t bytes_written = 0;
+    if (stream.isNull() || stream->Write(buf.buf(), buf.pos(), &bytes_written) != LVERR_OK
+            || bytes_written != (lvsize_t) buf.pos())
+    {
+        CRLog::debug("SavePhrasesIndex: cannot write %s", LCSTR(phrase_cache_file_));
+        stream.Clear();
+        LVDeleteFile(phrase_cache_file_);
+    }
 }
 
 void LVDocView::clearStylesheetToBase()
@@ -19,6 +19,14 @@
 #include <ore_log.h>
 #include "include/lvdrawbuf.h"
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define GLYPH_BLEND_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define GLYPH_BLEND_SSE2 1
+#endif
+
 #define GRAY_INVERSE 0
 #define GUARD_BYTE 0xa5
 #define CHECK_GUARD_BYTE \
@@ -1497,6 +1505,206 @@ void LVColorDrawBuf::InvertRect(int x0, int y0, int x1, int y1)
     CR_UNUSED4(x0, y0, x1, y1);
 }
 
+/// blends one row of 8 bit glyph coverage into 16bpp pixels, reference for SIMD kernels
+static void BlendGlyphRow16Scalar( lUInt16 * dst, const lUInt8 * src, int count, lUInt16 bmpcl16 )
+{
+    for (; count>0; --count)
+    {
+        lUInt32 opaque = ((*(src++))>>4)&0x0F;
+        if ( opaque>=0xF )
+            *dst = bmpcl16;
+        else if ( opaque>0 ) {
+            lUInt32 alpha = 0xF-opaque;
+            lUInt16 cl1 = (lUInt16)(((alpha*((*dst)&0xF81F) + opaque*(bmpcl16&0xF81F))>>4) & 0xF81F);
+            lUInt16 cl2 = (lUInt16)(((alpha*((*dst)&0x07E0) + opaque*(bmpcl16&0x07E0))>>4) & 0x07E0);
+            *dst = cl1 | cl2;
+        }
+        /* next pixel */
+        dst++;
+    }
+}
+
+/// blends one row of 8 bit glyph coverage into 32bpp pixels, reference for SIMD kernels
+static void BlendGlyphRow32Scalar( lUInt32 * dst, const lUInt8 * src, int count, lUInt32 bmpcl )
+{
+    for (; count>0; --count)
+    {
+        lUInt32 opaque = ((*(src++))>>1)&0x7F;
+        if ( opaque>=0x78 )
+            *dst = bmpcl;
+        else if ( opaque>0 ) {
+            lUInt32 alpha = 0x7F-opaque;
+            lUInt32 cl1 = ((alpha*((*dst)&0xFF00FF) + opaque*(bmpcl&0xFF00FF))>>7) & 0xFF00FF;
+            lUInt32 cl2 = ((alpha*((*dst)&0x00FF00) + opaque*(bmpcl&0x00FF00))>>7) & 0x00FF00;
+            *dst = cl1 | cl2;
+        }
+        /* next pixel */
+        dst++;
+    }
+}
+
+// SIMD kernels blend each channel separately in 16 bit lanes. Packed scalar math
+// never carries between channels (alpha+opaque is 0xF or 0x7F), so per channel
+// (alpha*dst + opaque*color) >> shift gives bit exact results. Alpha byte of
+// blended 32bpp pixels is cleared, same as in scalar code.
+// Kernels return number of processed pixels, the rest is left to scalar code.
+
+#if defined(GLYPH_BLEND_NEON)
+
+static int BlendGlyphRow16Simd( lUInt16 * dst, const lUInt8 * src, int count, lUInt16 bmpcl16 )
+{
+    const uint16x8_t color = vdupq_n_u16(bmpcl16);
+    const uint16x8_t color_r = vdupq_n_u16((lUInt16)(bmpcl16 >> 11));
+    const uint16x8_t color_g = vdupq_n_u16((lUInt16)((bmpcl16 >> 5) & 0x3F));
+    const uint16x8_t color_b = vdupq_n_u16((lUInt16)(bmpcl16 & 0x1F));
+    const uint16x8_t mask_g = vdupq_n_u16(0x3F);
+    const uint16x8_t mask_b = vdupq_n_u16(0x1F);
+    const uint16x8_t full = vdupq_n_u16(0xF);
+    const uint16x8_t none = vdupq_n_u16(0);
+    int done = 0;
+    for (; done + 8 <= count; done += 8, src += 8, dst += 8) {
+        uint8x8_t coverage = vshr_n_u8(vld1_u8(src), 4);
+        if (vget_lane_u64(vreinterpret_u64_u8(coverage), 0) == 0)
+            continue;
+        uint16x8_t opaque = vmovl_u8(coverage);
+        uint16x8_t alpha = vsubq_u16(full, opaque);
+        uint16x8_t px = vld1q_u16(dst);
+        uint16x8_t r = vmlaq_u16(vmulq_u16(alpha, vshrq_n_u16(px, 11)), opaque, color_r);
+        uint16x8_t g = vmlaq_u16(vmulq_u16(alpha, vandq_u16(vshrq_n_u16(px, 5), mask_g)), opaque, color_g);
+        uint16x8_t b = vmlaq_u16(vmulq_u16(alpha, vandq_u16(px, mask_b)), opaque, color_b);
+        uint16x8_t res = vorrq_u16(vorrq_u16(vshlq_n_u16(vshrq_n_u16(r, 4), 11),
+                vshlq_n_u16(vshrq_n_u16(g, 4), 5)), vshrq_n_u16(b, 4));
+        res = vbslq_u16(vceqq_u16(opaque, full), color, res);
+        res = vbslq_u16(vceqq_u16(opaque, none), px, res);
+        vst1q_u16(dst, res);
+    }
+    return done;
+}
+
+static int BlendGlyphRow32Simd( lUInt32 * dst, const lUInt8 * src, int count, lUInt32 bmpcl )
+{
+    uint8x8_t color[4];
+    color[0] = vdup_n_u8((lUInt8)(bmpcl & 0xFF));
+    color[1] = vdup_n_u8((lUInt8)((bmpcl >> 8) & 0xFF));
+    color[2] = vdup_n_u8((lUInt8)((bmpcl >> 16) & 0xFF));
+    color[3] = vdup_n_u8((lUInt8)((bmpcl >> 24) & 0xFF));
+    const uint8x8_t max = vdup_n_u8(0x7F);
+    const uint8x8_t full = vdup_n_u8(0x78);
+    const uint8x8_t none = vdup_n_u8(0);
+    int done = 0;
+    for (; done + 8 <= count; done += 8, src += 8, dst += 8) {
+        uint8x8_t opaque = vshr_n_u8(vld1_u8(src), 1);
+        if (vget_lane_u64(vreinterpret_u64_u8(opaque), 0) == 0)
+            continue;
+        uint8x8_t alpha = vsub_u8(max, opaque);
+        uint8x8_t is_full = vcge_u8(opaque, full);
+        uint8x8_t is_none = vceq_u8(opaque, none);
+        uint8x8x4_t px = vld4_u8((const uint8_t *)dst);
+        uint8x8x4_t res;
+        for (int i = 0; i < 3; i++)
+            res.val[i] = vshrn_n_u16(vmlal_u8(vmull_u8(alpha, px.val[i]), opaque, color[i]), 7);
+        res.val[3] = none;
+        for (int i = 0; i < 4; i++) {
+            res.val[i] = vbsl_u8(is_full, color[i], res.val[i]);
+            res.val[i] = vbsl_u8(is_none, px.val[i], res.val[i]);
+        }
+        vst4_u8((uint8_t *)dst, res);
+    }
+    return done;
+}
+
+#elif defined(GLYPH_BLEND_SSE2)
+
+static int BlendGlyphRow16Simd( lUInt16 * dst, const lUInt8 * src, int count, lUInt16 bmpcl16 )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i color = _mm_set1_epi16((short)bmpcl16);
+    const __m128i color_r = _mm_set1_epi16((short)(bmpcl16 >> 11));
+    const __m128i color_g = _mm_set1_epi16((short)((bmpcl16 >> 5) & 0x3F));
+    const __m128i color_b = _mm_set1_epi16((short)(bmpcl16 & 0x1F));
+    const __m128i mask_g = _mm_set1_epi16(0x3F);
+    const __m128i mask_b = _mm_set1_epi16(0x1F);
+    const __m128i full = _mm_set1_epi16(0xF);
+    int done = 0;
+    for (; done + 8 <= count; done += 8, src += 8, dst += 8) {
+        __m128i opaque = _mm_srli_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)src), zero), 4);
+        __m128i is_none = _mm_cmpeq_epi16(opaque, zero);
+        if (_mm_movemask_epi8(is_none) == 0xFFFF)
+            continue;
+        __m128i is_full = _mm_cmpeq_epi16(opaque, full);
+        __m128i alpha = _mm_sub_epi16(full, opaque);
+        __m128i px = _mm_loadu_si128((const __m128i *)dst);
+        __m128i r = _mm_add_epi16(_mm_mullo_epi16(alpha, _mm_srli_epi16(px, 11)), _mm_mullo_epi16(opaque, color_r));
+        __m128i g = _mm_add_epi16(_mm_mullo_epi16(alpha, _mm_and_si128(_mm_srli_epi16(px, 5), mask_g)), _mm_mullo_epi16(opaque, color_g));
+        __m128i b = _mm_add_epi16(_mm_mullo_epi16(alpha, _mm_and_si128(px, mask_b)), _mm_mullo_epi16(opaque, color_b));
+        __m128i res = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(r, 4), 11),
+                _mm_slli_epi16(_mm_srli_epi16(g, 4), 5)), _mm_srli_epi16(b, 4));
+        res = _mm_or_si128(_mm_and_si128(is_full, color), _mm_andnot_si128(is_full, res));
+        res = _mm_or_si128(_mm_and_si128(is_none, px), _mm_andnot_si128(is_none, res));
+        _mm_storeu_si128((__m128i *)dst, res);
+    }
+    return done;
+}
+
+static int BlendGlyphRow32Simd( lUInt32 * dst, const lUInt8 * src, int count, lUInt32 bmpcl )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i color = _mm_set1_epi32((int)bmpcl);
+    const __m128i color16 = _mm_unpacklo_epi8(color, zero);
+    const __m128i max = _mm_set1_epi16(0x7F);
+    const __m128i almost_full = _mm_set1_epi32(0x77);
+    const __m128i rgb_mask = _mm_set1_epi32(0x00FFFFFF);
+    int done = 0;
+    for (; done + 4 <= count; done += 4, src += 4, dst += 4) {
+        lUInt32 coverage;
+        memcpy(&coverage, src, sizeof(coverage));
+        __m128i opaque = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)coverage), zero), zero);
+        opaque = _mm_srli_epi32(opaque, 1);
+        __m128i is_none = _mm_cmpeq_epi32(opaque, zero);
+        if (_mm_movemask_epi8(is_none) == 0xFFFF)
+            continue;
+        __m128i is_full = _mm_cmpgt_epi32(opaque, almost_full);
+        // spread coverage of each pixel over its 4 channels
+        __m128i spread = _mm_or_si128(opaque, _mm_slli_epi32(opaque, 16));
+        __m128i opaque_lo = _mm_unpacklo_epi32(spread, spread);
+        __m128i opaque_hi = _mm_unpackhi_epi32(spread, spread);
+        __m128i px = _mm_loadu_si128((const __m128i *)dst);
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(max, opaque_lo), _mm_unpacklo_epi8(px, zero)),
+                _mm_mullo_epi16(opaque_lo, color16));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(max, opaque_hi), _mm_unpackhi_epi8(px, zero)),
+                _mm_mullo_epi16(opaque_hi, color16));
+        __m128i res = _mm_and_si128(_mm_packus_epi16(_mm_srli_epi16(lo, 7), _mm_srli_epi16(hi, 7)), rgb_mask);
+        res = _mm_or_si128(_mm_and_si128(is_full, color), _mm_andnot_si128(is_full, res));
+        res = _mm_or_si128(_mm_and_si128(is_none, px), _mm_andnot_si128(is_none, res));
+        _mm_storeu_si128((__m128i *)dst, res);
+    }
+    return done;
+}
+
+#endif
+
+static void BlendGlyphRow16( lUInt16 * dst, const lUInt8 * src, int count, lUInt16 bmpcl16 )
+{
+#if defined(GLYPH_BLEND_NEON) || defined(GLYPH_BLEND_SSE2)
+    int done = BlendGlyphRow16Simd(dst, src, count, bmpcl16);
+    dst += done;
+    src += done;
+    count -= done;
+#endif
+    BlendGlyphRow16Scalar(dst, src, count, bmpcl16);
+}
+
+static void BlendGlyphRow32( lUInt32 * dst, const lUInt8 * src, int count, lUInt32 bmpcl )
+{
+#if defined(GLYPH_BLEND_NEON) || defined(GLYPH_BLEND_SSE2)
+    int done = BlendGlyphRow32Simd(dst, src, count, bmpcl);
+    dst += done;
+    src += done;
+    count -= done;
+#endif
+    BlendGlyphRow32Scalar(dst, src, count, bmpcl);
+}
+
 /// draws bitmap (1 byte per pixel) using specified palette
 void LVColorDrawBuf::Draw( int x, int y, const lUInt8 * bitmap, int width, int height, lUInt32 * palette )
 {
@@ -1504,10 +1712,8 @@ void LVColorDrawBuf::Draw( int x, int y, const lUInt8 * bitmap, int width, int h
     int initial_height = height;
     int bx = 0;
     int by = 0;
-    int xx;
     int bmp_width = width;
     lUInt32 bmpcl = palette?palette[0]:GetTextColor();
-    const lUInt8 * src;
 
     if (x<_clip.left)
     {
@@ -1546,69 +1752,20 @@ void LVColorDrawBuf::Draw( int x, int y, const lUInt8 * bitmap, int width, int h
     if (height<=0)
         return;
 
-    xx = width;
-
     bitmap += bx + by*bmp_width;
 
     if ( _bpp==16 ) {
-
         lUInt16 bmpcl16 = rgb888to565(bmpcl);
-
-        lUInt16 * dst;
-        lUInt16 * dstline;
-
-
         for (;height;height--)
         {
-            src = bitmap;
-            dstline = ((lUInt16*)GetScanLine(y++)) + x;
-            dst = dstline;
-
-            for (xx = width; xx>0; --xx)
-            {
-                lUInt32 opaque = ((*(src++))>>4)&0x0F;
-                if ( opaque>=0xF )
-                    *dst = bmpcl16;
-                else if ( opaque>0 ) {
-                    lUInt32 alpha = 0xF-opaque;
-                    lUInt16 cl1 = (lUInt16)(((alpha*((*dst)&0xF81F) + opaque*(bmpcl16&0xF81F))>>4) & 0xF81F);
-                    lUInt16 cl2 = (lUInt16)(((alpha*((*dst)&0x07E0) + opaque*(bmpcl16&0x07E0))>>4) & 0x07E0);
-                    *dst = cl1 | cl2;
-                }
-                /* next pixel */
-                dst++;
-            }
+            BlendGlyphRow16(((lUInt16*)GetScanLine(y++)) + x, bitmap, width, bmpcl16);
             /* new dest line */
             bitmap += bmp_width;
         }
-
     } else {
-
-
-        lUInt32 * dst;
-        lUInt32 * dstline;
-
-
         for (;height;height--)
         {
-            src = bitmap;
-            dstline = ((lUInt32*)GetScanLine(y++)) + x;
-            dst = dstline;
-
-            for (xx = width; xx>0; --xx)
-            {
-                lUInt32 opaque = ((*(src++))>>1)&0x7F;
-                if ( opaque>=0x78 )
-                    *dst = bmpcl;
-                else if ( opaque>0 ) {
-                    lUInt32 alpha = 0x7F-opaque;
-                    lUInt32 cl1 = ((alpha*((*dst)&0xFF00FF) + opaque*(bmpcl&0xFF00FF))>>7) & 0xFF00FF;
-                    lUInt32 cl2 = ((alpha*((*dst)&0x00FF00) + opaque*(bmpcl&0x00FF00))>>7) & 0x00FF00;
-                    *dst = cl1 | cl2;
-                }
-                /* next pixel */
-                dst++;
-            }
+            BlendGlyphRow32(((lUInt32*)GetScanLine(y++)) + x, bitmap, width, bmpcl);
             /* new dest line */
             bitmap += bmp_width;
         }
@@ -466,27 +466,29 @@ static lChar16 getReplacementChar(lUInt16 code)
 }
 
 
+#define GLYPH_WIDTH_UNKNOWN 0xFFFF
+
 class LVFontGlyphWidthCache
 {
 private:
-    lUInt8 * ptrs[128];
+    lUInt16 * ptrs[128];
 public:
-    lUInt8 get( lChar16 ch )
+    lUInt16 get( lChar16 ch )
     {
         int inx = (ch>>9) & 0x7f;
-        lUInt8 * ptr = ptrs[inx];
+        lUInt16 * ptr = ptrs[inx];
         if ( !ptr )
-            return 0xFF;
+            return GLYPH_WIDTH_UNKNOWN;
         return ptr[ch & 0x1FF ];
     }
-    void put( lChar16 ch, lUInt8 w )
+    void put( lChar16 ch, lUInt16 w )
     {
         int inx = (ch>>9) & 0x7f;
-        lUInt8 * ptr = ptrs[inx];
+        lUInt16 * ptr = ptrs[inx];
         if ( !ptr ) {
-            ptr = new lUInt8[512];
+            ptr = new lUInt16[512];
             ptrs[inx] = ptr;
-            memset( ptr, 0xFF, sizeof(lUInt8) * 512 );
+            memset( ptr, 0xFF, sizeof(lUInt16) * 512 );
         }
         ptr[ ch & 0x1FF ] = w;
     }
@@ -500,7 +502,7 @@ public:
     }
     LVFontGlyphWidthCache()
     {
-        memset( ptrs, 0, 128*sizeof(lUInt8*) );
+        memset( ptrs, 0, 128*sizeof(lUInt16*) );
     }
     ~LVFontGlyphWidthCache()
     {
@@ -508,6 +510,190 @@ public:
     }
 };
 
+#define KERNING_CACHE_SIZE 4096
+
+/// Kerning of glyph pairs already looked up in face, FreeType has no way to list all pairs
+class LVFontKerningCache
+{
+private:
+    struct Item {
+        lUInt32 left;
+        lUInt32 right;
+        int delta;
+    };
+    Item * items_;
+public:
+    /// returns true and sets delta if pair is cached
+    bool get( lUInt32 left, lUInt32 right, int & delta )
+    {
+        if ( !items_ )
+            return false;
+        Item & item = items_[(left * 31 + right) % KERNING_CACHE_SIZE];
+        if ( item.left!=left || item.right!=right )
+            return false;
+        delta = item.delta;
+        return true;
+    }
+    void put( lUInt32 left, lUInt32 right, int delta )
+    {
+        if ( !items_ ) {
+            items_ = new Item[KERNING_CACHE_SIZE];
+            // Glyph 0 is never kerned, so zeroed items never match
+            memset( items_, 0, sizeof(Item) * KERNING_CACHE_SIZE );
+        }
+        Item & item = items_[(left * 31 + right) % KERNING_CACHE_SIZE];
+        item.left = left;
+        item.right = right;
+        item.delta = delta;
+    }
+    void clear()
+    {
+        if ( items_ )
+            delete [] items_;
+        items_ = NULL;
+    }
+    LVFontKerningCache() : items_(NULL) { }
+    ~LVFontKerningCache() { clear(); }
+};
+
+#define WORD_WIDTH_CACHE_SIZE 1024
+#define WORD_WIDTH_CACHE_HASH_SIZE 2048
+#define WORD_WIDTH_CACHE_MAX_LEN 24
+#define WORD_WIDTH_FAILED 0xFFFF
+
+/// Char widths of recently measured words, so reformatting same text doesn't
+/// measure it char by char again; least recently used words are replaced
+class LVFontWordWidthCache
+{
+public:
+    struct Item {
+        lChar16 text[WORD_WIDTH_CACHE_MAX_LEN];
+        /// widths from word start without kerning against previous text,
+        /// WORD_WIDTH_FAILED for chars without glyph
+        lUInt16 widths[WORD_WIDTH_CACHE_MAX_LEN];
+        int len;
+        int letter_spacing;
+        lChar16 def_char;
+        lUInt32 hash;
+        /// index of first char with glyph, len if there is no such char
+        int kern_from;
+        /// glyph of kern_from char, kerned with previous text
+        lUInt32 first_glyph;
+        /// glyph of last char with glyph, kerned with next text
+        lUInt32 last_glyph;
+        int hash_next;
+        int lru_prev;
+        int lru_next;
+    };
+private:
+    Item * items_;
+    int * buckets_;
+    int count_;
+    // most and least recently used items
+    int head_;
+    int tail_;
+    void unlink( int index )
+    {
+        Item & item = items_[index];
+        if ( item.lru_prev>=0 )
+            items_[item.lru_prev].lru_next = item.lru_next;
+        else
+            head_ = item.lru_next;
+        if ( item.lru_next>=0 )
+            items_[item.lru_next].lru_prev = item.lru_prev;
+        else
+            tail_ = item.lru_prev;
+    }
+    void pushFront( int index )
+    {
+        Item & item = items_[index];
+        item.lru_prev = -1;
+        item.lru_next = head_;
+        if ( head_>=0 )
+            items_[head_].lru_prev = index;
+        head_ = index;
+        if ( tail_<0 )
+            tail_ = index;
+    }
+    void removeFromBucket( int index )
+    {
+        int * p = &buckets_[items_[index].hash % WORD_WIDTH_CACHE_HASH_SIZE];
+        while ( *p>=0 && *p!=index )
+            p = &items_[*p].hash_next;
+        if ( *p==index )
+            *p = items_[index].hash_next;
+    }
+public:
+    static lUInt32 calcHash( const lChar16 * text, int len, int letter_spacing )
+    {
+        lUInt32 hash = (lUInt32)letter_spacing;
+        for ( int i=0; i<len; i++ )
+            hash = hash * 31 + (lUInt32)text[i];
+        return hash;
+    }
+    Item * find( const lChar16 * text, int len, int letter_spacing, lChar16 def_char, lUInt32 hash )
+    {
+        if ( !items_ )
+            return NULL;
+        for ( int i = buckets_[hash % WORD_WIDTH_CACHE_HASH_SIZE]; i>=0; i = items_[i].hash_next ) {
+            Item & item = items_[i];
+            if ( item.hash==hash && item.len==len && item.letter_spacing==letter_spacing
+                    && item.def_char==def_char
+                    && !memcmp( item.text, text, len * sizeof(lChar16) ) ) {
+                if ( head_!=i ) {
+                    unlink( i );
+                    pushFront( i );
+                }
+                return &item;
+            }
+        }
+        return NULL;
+    }
+    /// returns item for new word, caller fills widths and glyphs
+    Item * add( const lChar16 * text, int len, int letter_spacing, lChar16 def_char, lUInt32 hash )
+    {
+        if ( !items_ ) {
+            items_ = new Item[WORD_WIDTH_CACHE_SIZE];
+            buckets_ = new int[WORD_WIDTH_CACHE_HASH_SIZE];
+            for ( int i=0; i<WORD_WIDTH_CACHE_HASH_SIZE; i++ )
+                buckets_[i] = -1;
+        }
+        int index;
+        if ( count_<WORD_WIDTH_CACHE_SIZE ) {
+            index = count_++;
+        } else {
+            index = tail_;
+            unlink( index );
+            removeFromBucket( index );
+        }
+        Item & item = items_[index];
+        memcpy( item.text, text, len * sizeof(lChar16) );
+        item.len = len;
+        item.letter_spacing = letter_spacing;
+        item.def_char = def_char;
+        item.hash = hash;
+        int & bucket = buckets_[hash % WORD_WIDTH_CACHE_HASH_SIZE];
+        item.hash_next = bucket;
+        bucket = index;
+        pushFront( index );
+        return &item;
+    }
+    void clear()
+    {
+        if ( items_ ) {
+            delete [] items_;
+            delete [] buckets_;
+        }
+        items_ = NULL;
+        buckets_ = NULL;
+        count_ = 0;
+        head_ = -1;
+        tail_ = -1;
+    }
+    LVFontWordWidthCache() : items_(NULL), buckets_(NULL), count_(0), head_(-1), tail_(-1) { }
+    ~LVFontWordWidthCache() { clear(); }
+};
+
 class LVFreeTypeFace;
 static LVFontGlyphCacheItem * newItem( LVFontLocalGlyphCache * local_cache, lChar16 ch, FT_GlyphSlot slot ) // , bool drawMonochrome
 {
@@ -579,18 +765,28 @@ void LVFontLocalGlyphCache::clear()
 
 LVFontGlyphCacheItem * LVFontLocalGlyphCache::get( lUInt16 ch )
 {
-    LVFontGlyphCacheItem * ptr = head;
-    for ( ; ptr; ptr = ptr->next_local ) {
-        if ( ptr->ch == ch ) {
-            global_cache->refresh( ptr );
-            return ptr;
-        }
+    LVFontGlyphCacheItem * * page = index[ch >> GLYPH_INDEX_PAGE_SHIFT];
+    if ( !page )
+        return NULL;
+    LVFontGlyphCacheItem * ptr = page[ch & (GLYPH_INDEX_PAGE_SIZE - 1)];
+    if ( ptr && ptr->ch == ch ) {
+        global_cache->refresh( ptr );
+        return ptr;
     }
     return NULL;
 }
 
 void LVFontLocalGlyphCache::put( LVFontGlyphCacheItem * item )
 {
+    // get() takes 16 bit chars, so other items are never looked up
+    if ( item->ch < 0x10000 ) {
+        LVFontGlyphCacheItem * * & page = index[item->ch >> GLYPH_INDEX_PAGE_SHIFT];
+        if ( !page ) {
+            page = new LVFontGlyphCacheItem * [GLYPH_INDEX_PAGE_SIZE];
+            memset( page, 0, sizeof(LVFontGlyphCacheItem *) * GLYPH_INDEX_PAGE_SIZE );
+        }
+        page[item->ch & (GLYPH_INDEX_PAGE_SIZE - 1)] = item;
+    }
     global_cache->put( item );
     item->next_local = head;
     if ( head )
@@ -603,6 +799,11 @@ void LVFontLocalGlyphCache::put( LVFontGlyphCacheItem * item )
 /// remove from list, but don't delete
 void LVFontLocalGlyphCache::remove( LVFontGlyphCacheItem * item )
 {
+    if ( item->ch < 0x10000 ) {
+        LVFontGlyphCacheItem * * page = index[item->ch >> GLYPH_INDEX_PAGE_SHIFT];
+        if ( page && page[item->ch & (GLYPH_INDEX_PAGE_SIZE - 1)] == item )
+            page[item->ch & (GLYPH_INDEX_PAGE_SIZE - 1)] = NULL;
+    }
     if ( item==head )
         head = item->next_local;
     if ( item==tail )
@@ -619,7 +820,8 @@ void LVFontLocalGlyphCache::remove( LVFontGlyphCacheItem * item )
 
 void LVFontGlobalGlyphCache::refresh( LVFontGlyphCacheItem * item )
 {
-    if ( tail!=item ) {
+    // most recently used item is at head
+    if ( head!=item ) {
         //move to head
         removeNoLock( item );
         putNoLock( item );
@@ -660,6 +862,7 @@ void LVFontGlobalGlyphCache::remove( LVFontGlyphCacheItem * item )
 
 void LVFontGlobalGlyphCache::removeNoLock( LVFontGlyphCacheItem * item )
 {
+    size -= item->getSize();
     if ( item==head )
         head = item->next_global;
     if ( item==tail )
@@ -672,7 +875,6 @@ void LVFontGlobalGlyphCache::removeNoLock( LVFontGlyphCacheItem * item )
         item->next_global->prev_global = item->prev_global;
     item->next_global = NULL;
     item->prev_global = NULL;
-    size -= item->getSize();
 }
 
 void LVFontGlobalGlyphCache::clear()
@@ -683,6 +885,50 @@ void LVFontGlobalGlyphCache::clear()
         ptr->local_cache->remove( ptr );
         LVFontGlyphCacheItem::freeItem( ptr );
     }
+    allocator.clear();
+}
+
+void * LVFontGlyphSlabAllocator::alloc( int size )
+{
+    int cls = (size + GLYPH_SIZE_CLASS_STEP - 1) / GLYPH_SIZE_CLASS_STEP - 1;
+    if ( cls >= GLYPH_SIZE_CLASS_COUNT )
+        return ::malloc( size );
+    void * ptr = free_lists[cls];
+    if ( ptr ) {
+        free_lists[cls] = *(void **)ptr;
+        return ptr;
+    }
+    int blockSize = (cls + 1) * GLYPH_SIZE_CLASS_STEP;
+    if ( slab_left < blockSize ) {
+        slab_pos = (lUInt8 *)::malloc( GLYPH_SLAB_SIZE );
+        slab_left = GLYPH_SLAB_SIZE;
+        slabs.add( slab_pos );
+    }
+    ptr = slab_pos;
+    slab_pos += blockSize;
+    slab_left -= blockSize;
+    return ptr;
+}
+
+void LVFontGlyphSlabAllocator::free( void * ptr, int size )
+{
+    int cls = (size + GLYPH_SIZE_CLASS_STEP - 1) / GLYPH_SIZE_CLASS_STEP - 1;
+    if ( cls >= GLYPH_SIZE_CLASS_COUNT ) {
+        ::free( ptr );
+        return;
+    }
+    *(void **)ptr = free_lists[cls];
+    free_lists[cls] = ptr;
+}
+
+void LVFontGlyphSlabAllocator::clear()
+{
+    for ( int i=0; i<slabs.length(); i++ )
+        ::free( slabs[i] );
+    slabs.clear();
+    memset( free_lists, 0, sizeof(free_lists) );
+    slab_pos = NULL;
+    slab_left = 0;
 }
 
 lString8 familyName( FT_Face face )
@@ -807,6 +1053,8 @@ protected:
     int            _weight;
     int            _italic;
     LVFontGlyphWidthCache _wcache;
+    LVFontKerningCache _kcache;
+    LVFontWordWidthCache _word_cache;
     LVFontLocalGlyphCache _glyph_cache;
     bool          _drawMonochrome;
     bool          _allowKerning;
@@ -913,7 +1161,13 @@ public:
     /// get kerning mode: true==ON, false=OFF
     virtual bool getKerning() const { return _allowKerning; }
     /// get kerning mode: true==ON, false=OFF
-    virtual void setKerning( bool kerningEnabled ) { _allowKerning = kerningEnabled; }
+    virtual void setKerning( bool kerningEnabled )
+    {
+        if ( _allowKerning == kerningEnabled )
+            return;
+        _allowKerning = kerningEnabled;
+        _word_cache.clear();
+    }
 
     /// sets current hinting mode
     virtual void setHintingMode(hinting_mode_t mode) {
@@ -922,6 +1176,7 @@ public:
         _hintingMode = mode;
         _glyph_cache.clear();
         _wcache.clear();
+        _word_cache.clear();
     }
     /// returns current hinting mode
     virtual hinting_mode_t  getHintingMode() const { return _hintingMode; }
@@ -936,6 +1191,7 @@ public:
         _drawMonochrome = drawBitmap;
         _glyph_cache.clear();
         _wcache.clear();
+        _word_cache.clear();
     }
 
     bool loadFromBuffer(LVByteArrayRef buf, int index, int size, css_font_family_t fontFamily, bool monochrome, bool italicize )
@@ -1521,10 +1777,69 @@ public:
         glyph->blackBoxY = (lUInt8)(_slot->metrics.height >> 6);
         glyph->originX =   (lInt8)(_slot->metrics.horiBearingX >> 6);
         glyph->originY =   (lInt8)(_slot->metrics.horiBearingY >> 6);
-        glyph->width =     (lUInt8)(myabs(_slot->metrics.horiAdvance) >> 6);
+        glyph->width =     (lUInt16)(myabs(_slot->metrics.horiAdvance) >> 6);
         return true;
     }
 
+    /// returns kerning of glyph pair in 26.6 pixels
+    int getKerning( FT_UInt left, FT_UInt right )
+    {
+        int delta = 0;
+        if ( _kcache.get( left, right, delta ) )
+            return delta;
+        FT_Vector vec;
+        int error = FT_Get_Kerning( _face,          /* handle to face object */
+                                    left,           /* left glyph index      */
+                                    right,          /* right glyph index     */
+                                    FT_KERNING_DEFAULT,  /* kerning mode     */
+                                    &vec );         /* target vector         */
+        if ( !error )
+            delta = vec.x;
+        _kcache.put( left, right, delta );
+        return delta;
+    }
+
+    /// fills cached item with widths of its chars from word start
+    void measureWord( LVFontWordWidthCache::Item * item, bool use_kerning )
+    {
+        FT_UInt previous = 0;
+        int prev_width = 0;
+        item->kern_from = item->len;
+        item->first_glyph = 0;
+        item->last_glyph = 0;
+        for ( int i=0; i<item->len; i++ ) {
+            lChar16 ch = item->text[i];
+            FT_UInt ch_glyph_index = 0;
+            int kerning = 0;
+            if ( use_kerning ) {
+                ch_glyph_index = getCharIndex( ch, item->def_char );
+                if ( previous>0 && ch_glyph_index>0 )
+                    kerning = getKerning( previous, ch_glyph_index );
+            }
+            int w = _wcache.get(ch);
+            if ( w==GLYPH_WIDTH_UNKNOWN ) {
+                glyph_info_t glyph;
+                if ( getGlyphInfo( ch, &glyph, item->def_char ) ) {
+                    w = glyph.width;
+                    _wcache.put(ch, w);
+                } else {
+                    item->widths[i] = WORD_WIDTH_FAILED;
+                    continue;  /* ignore errors */
+                }
+            }
+            int width = prev_width + w + (kerning >> 6) + item->letter_spacing;
+            item->widths[i] = (lUInt16)width;
+            if ( item->kern_from==item->len ) {
+                item->kern_from = i;
+                item->first_glyph = ch_glyph_index;
+            }
+            item->last_glyph = ch_glyph_index;
+            previous = ch_glyph_index;
+            if ( ch!=UNICODE_SOFT_HYPHEN_CODE ) // avoid soft hyphens inside text string
+                prev_width = width;
+        }
+    }
+
     /** \brief measure text
         \param text is text string pointer
         \param len is number of characters to measure
@@ -1542,77 +1857,57 @@ public:
     {
         if ( len <= 0 || _face==NULL )
             return 0;
-        int error;
 
+        bool use_kerning = false;
 #if (ALLOW_KERNING==1)
-        int use_kerning = _allowKerning && FT_HAS_KERNING( _face );
+        use_kerning = _allowKerning && FT_HAS_KERNING( _face );
 #endif
         if ( letter_spacing<0 || letter_spacing>50 )
             letter_spacing = 0;
 
-        //int i;
-
         FT_UInt previous = 0;
-        lUInt16 prev_width = 0;
+        int prev_width = 0;
         int nchars = 0;
         int lastFitChar = 0;
+        bool fit = true;
         updateTransform();
-        // measure character widths
-        for ( nchars=0; nchars<len; nchars++) {
-            lChar16 ch = text[nchars];
-            bool isHyphen = (ch==UNICODE_SOFT_HYPHEN_CODE);
-            FT_UInt ch_glyph_index = (FT_UInt)-1;
-            int kerning = 0;
-#if (ALLOW_KERNING==1)
-            if ( use_kerning && previous>0  ) {
-                if ( ch_glyph_index==(FT_UInt)-1 )
-                    ch_glyph_index = getCharIndex( ch, def_char );
-                if ( ch_glyph_index != 0 ) {
-                    FT_Vector delta;
-                    error = FT_Get_Kerning( _face,          /* handle to face object */
-                                  previous,          /* left glyph index      */
-                                  ch_glyph_index,         /* right glyph index     */
-                                  FT_KERNING_DEFAULT,  /* kerning mode          */
-                                  &delta );    /* target vector         */
-                    if ( !error )
-                        kerning = delta.x;
-                }
+        // measure text by words, widths of each word are cached without
+        // kerning against previous word, which is added here
+        while ( fit && nchars<len ) {
+            int wordLen = 0;
+            while ( nchars + wordLen < len && wordLen < WORD_WIDTH_CACHE_MAX_LEN ) {
+                if ( text[nchars + wordLen++]==' ' )
+                    break;
             }
-#endif
-
-            flags[nchars] = GET_CHAR_FLAGS(ch); //calcCharFlags( ch );
-
-            /* load glyph image into the slot (erase previous one) */
-            int w = _wcache.get(ch);
-            if ( w==0xFF ) {
-                glyph_info_t glyph;
-                if ( getGlyphInfo( ch, &glyph, def_char ) ) {
-                    w = glyph.width;
-                    _wcache.put(ch, w);
-                } else {
+            const lChar16 * word = text + nchars;
+            lUInt32 hash = LVFontWordWidthCache::calcHash( word, wordLen, letter_spacing );
+            LVFontWordWidthCache::Item * item = _word_cache.find( word, wordLen, letter_spacing, def_char, hash );
+            if ( !item ) {
+                item = _word_cache.add( word, wordLen, letter_spacing, def_char, hash );
+                measureWord( item, use_kerning );
+            }
+            int kerning = 0;
+            if ( use_kerning && previous>0 && item->first_glyph>0 )
+                kerning = getKerning( previous, item->first_glyph ) >> 6;
+            int base = prev_width;
+            for ( int k=0; k<wordLen; k++, nchars++ ) {
+                lChar16 ch = word[k];
+                flags[nchars] = GET_CHAR_FLAGS(ch); //calcCharFlags( ch );
+                if ( item->widths[k]==WORD_WIDTH_FAILED ) {
                     widths[nchars] = prev_width;
                     continue;  /* ignore errors */
                 }
-                if ( ch_glyph_index==(FT_UInt)-1 )
-                    ch_glyph_index = getCharIndex( ch, 0 );
-//                error = FT_Load_Glyph( _face,          /* handle to face object */
-//                        ch_glyph_index,                /* glyph index           */
-//                        FT_LOAD_DEFAULT );             /* load flags, see below */
-//                if ( error ) {
-//                    widths[nchars] = prev_width;
-//                    continue;  /* ignore errors */
-//                }
-            }
-            widths[nchars] = prev_width + w + (kerning >> 6) + letter_spacing;
-            previous = ch_glyph_index;
-            if ( !isHyphen ) // avoid soft hyphens inside text string
-                prev_width = widths[nchars];
-            if ( prev_width > max_width ) {
-                if ( lastFitChar < nchars + 7)
+                widths[nchars] = base + kerning + item->widths[k];
+                if ( ch!=UNICODE_SOFT_HYPHEN_CODE ) // avoid soft hyphens inside text string
+                    prev_width = widths[nchars];
+                if ( prev_width > max_width ) {
+                    fit = false;
                     break;
-            } else {
+                }
                 lastFitChar = nchars + 1;
             }
+            if ( item->kern_from < item->len )
+                previous = item->last_glyph;
         }
 
         // fill props for rest of chars
@@ -2075,7 +2370,7 @@ public:
     virtual int getCharWidth( lChar16 ch, lChar16 def_char='?' )
     {
         int w = _wcache.get(ch);
-        if ( w==0xFF ) {
+        if ( w==GLYPH_WIDTH_UNKNOWN ) {
             glyph_info_t glyph;
             if ( getGlyphInfo( ch, &glyph, def_char ) ) {
                 w = glyph.width;
@@ -2118,15 +2413,7 @@ public:
     		FT_UInt ch_glyph_index1 = getCharIndex( ch1, def_char );
 			FT_UInt ch_glyph_index2 = getCharIndex( ch2, def_char );
             if (ch_glyph_index1 > 0 && ch_glyph_index2 > 0) {
-                FT_Vector delta;
-                int error = FT_Get_Kerning(
-                		_face,          /* handle to face object */
-                		ch_glyph_index1,          /* left glyph index      */
-                		ch_glyph_index2,         /* right glyph index     */
-                        FT_KERNING_DEFAULT,  /* kerning mode          */
-                        &delta );    /* target vector         */
-                if ( !error )
-                    return delta.x;
+                return getKerning(ch_glyph_index1, ch_glyph_index2);
             }
 		#endif
         return 0;
@@ -2146,8 +2433,6 @@ public:
         if ( y + _height < clip.top || y >= clip.bottom )
             return;
 
-        int error;
-
 #if (ALLOW_KERNING==1)
         int use_kerning = _allowKerning && FT_HAS_KERNING( _face );
 #endif
@@ -2182,14 +2467,7 @@ public:
             int kerning = 0;
 #if (ALLOW_KERNING==1)
             if ( use_kerning && previous>0 && ch_glyph_index>0 ) {
-                FT_Vector delta;
-                error = FT_Get_Kerning( _face,          /* handle to face object */
-                              previous,          /* left glyph index      */
-                              ch_glyph_index,         /* right glyph index     */
-                              FT_KERNING_DEFAULT,  /* kerning mode          */
-                              &delta );    /* target vector         */
-                if ( !error )
-                    kerning = delta.x;
+                kerning = getKerning( previous, ch_glyph_index );
             }
 #endif
 
@@ -2295,6 +2573,8 @@ public:
         if ( _face )
             FT_Done_Face( _face );
         _face = NULL;
+        _kcache.clear();
+        _word_cache.clear();
     }
 
 };
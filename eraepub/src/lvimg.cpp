@@ -14,6 +14,10 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
 
 #define USE_LIBJPEG                          1
 #define USE_LIBPNG                           1
@@ -484,6 +488,115 @@ cr_jpeg_error (j_common_ptr cinfo)
     longjmp(myerr->setjmp_buffer, -1);
 }
 
+/// returns largest IDCT scale denominator keeping width*height image at least dx*dy
+static int JpegDecodeScale( int width, int height, int dx, int dy )
+{
+    for ( int scale = 8; scale > 1; scale >>= 1 ) {
+        if ( (width + scale - 1) / scale >= dx && (height + scale - 1) / scale >= dy )
+            return scale;
+    }
+    return 1;
+}
+
+/*
+ * Memory source: whole image is in buffer already, so running out of data
+ * means truncated file, which gets fake EOI marker same as stream source does.
+ */
+
+METHODDEF(wxjpeg_boolean)
+cr_mem_fill_input_buffer (j_decompress_ptr cinfo)
+{
+    static const JOCTET eoi[2] = { (JOCTET) 0xFF, (JOCTET) JPEG_EOI };
+    WARNMS(cinfo, JWRN_JPEG_EOF);
+    cinfo->src->next_input_byte = eoi;
+    cinfo->src->bytes_in_buffer = 2;
+    return TRUE;
+}
+
+METHODDEF(void)
+cr_mem_skip_input_data (j_decompress_ptr cinfo, long num_bytes)
+{
+    struct jpeg_source_mgr * src = cinfo->src;
+    if ( num_bytes <= 0 )
+        return;
+    if ( num_bytes > (long) src->bytes_in_buffer ) {
+        (void) cr_mem_fill_input_buffer(cinfo);
+        return;
+    }
+    src->next_input_byte += (size_t) num_bytes;
+    src->bytes_in_buffer -= (size_t) num_bytes;
+}
+
+GLOBAL(void)
+cr_jpeg_mem_src (j_decompress_ptr cinfo, const lUInt8 * data, int size)
+{
+    struct jpeg_source_mgr * src = (struct jpeg_source_mgr *) (*cinfo->mem->alloc_small)
+            ((j_common_ptr) cinfo, JPOOL_PERMANENT, sizeof(struct jpeg_source_mgr));
+    src->init_source = cr_term_source;
+    src->fill_input_buffer = cr_mem_fill_input_buffer;
+    src->skip_input_data = cr_mem_skip_input_data;
+    src->resync_to_restart = jpeg_resync_to_restart; /* use default method */
+    src->term_source = cr_term_source;
+    src->next_input_byte = data;
+    src->bytes_in_buffer = size;
+    cinfo->src = src;
+}
+
+/// Decodes JPEG image from memory to 0x00RRGGBB pixels, reduced by IDCT scaling as much
+/// as it keeps image at least dx*dy. Returns malloc'ed pixels or NULL on error or if decoded
+/// image is larger than maxBytes. Uses no engine objects, so can run on any thread.
+static lUInt32 * DecodeJpegBuffer( const lUInt8 * data, int size, int dx, int dy, int maxBytes,
+        int & width, int & height )
+{
+    jpeg_decompress_struct cinfo;
+    my_error_mgr jerr;
+    lUInt8 * volatile buffer = NULL;
+    lUInt32 * volatile pixels = NULL;
+    memset(&cinfo, 0, sizeof(jpeg_decompress_struct));
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = cr_jpeg_error;
+    jpeg_create_decompress(&cinfo);
+    if (setjmp(jerr.setjmp_buffer)) {
+        free( buffer );
+        free( pixels );
+        jpeg_destroy_decompress(&cinfo);
+        return NULL;
+    }
+    cr_jpeg_mem_src( &cinfo, data, size );
+    (void) jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = JpegDecodeScale( cinfo.image_width, cinfo.image_height, dx, dy );
+    (void) jpeg_start_decompress(&cinfo);
+    width = cinfo.output_width;
+    height = cinfo.output_height;
+    if ( (lInt64)width * height * 4 <= maxBytes ) {
+        buffer = (lUInt8 *) malloc( width * cinfo.output_components );
+        pixels = (lUInt32 *) malloc( width * height * sizeof(lUInt32) );
+    }
+    if ( !buffer || !pixels ) {
+        free( buffer );
+        free( pixels );
+        jpeg_destroy_decompress(&cinfo);
+        return NULL;
+    }
+    while (cinfo.output_scanline < cinfo.output_height) {
+        lUInt32 * row = pixels + cinfo.output_scanline * width;
+        JSAMPROW line = buffer;
+        (void) jpeg_read_scanlines(&cinfo, &line, 1);
+        lUInt8 * p = buffer;
+        for (int x=0; x<width; x++)
+        {
+            row[x] = (((lUInt32)p[0])<<16) | (((lUInt32)p[1])<<8) | (((lUInt32)p[2])<<0);
+            p += 3;
+        }
+    }
+    free( buffer );
+    lUInt32 * res = pixels;
+    jpeg_destroy_decompress(&cinfo);
+    return res;
+}
+
 #endif
 
 #if (USE_LIBPNG==1)
@@ -702,6 +815,14 @@ public:
     virtual ~LVJpegImageSource() {}
     virtual void   Compact() { }
     virtual bool   Decode( LVImageDecoderCallback * callback )
+    {
+        return DecodeScaled( callback, 1 );
+    }
+    virtual int    GetDecodeScale( int dx, int dy )
+    {
+        return JpegDecodeScale( _width, _height, dx, dy );
+    }
+    virtual bool   DecodeScaled( LVImageDecoderCallback * callback, int scale )
     {
     	//CRLog::trace("LVJpegImageSource::decode called");
         memset(&cinfo, 0, sizeof(jpeg_decompress_struct));
@@ -762,6 +883,9 @@ public:
                  * jpeg_read_header(), so we do nothing here.
                  */
                 cinfo.out_color_space = JCS_RGB;
+                // IDCT scaling, output size is rounded up
+                cinfo.scale_num = 1;
+                cinfo.scale_denom = scale;
 
                 /* Step 5: Start decompressor */
 
@@ -2351,4 +2475,348 @@ LVImageSourceRef LVCreateUnpackedImageSource( LVImageSourceRef srcImage, int max
 LVImageSourceRef LVCreateDrawBufImageSource( LVColorDrawBuf * buf, bool own )
 {
     return LVImageSourceRef( new LVDrawBufImgSource( buf, own ) );
-}
\ No newline at end of file
+}
+
+/// Point samples decoded rows into buffer of other size, with same mapping as drawing uses
+class LVImageScaleCallback : public LVImageDecoderCallback
+{
+    LVColorDrawBuf * _dst;
+    int _src_dx;
+    int _src_dy;
+    int _dst_dx;
+    int _dst_dy;
+    int * _xmap;
+public:
+    LVImageScaleCallback( LVColorDrawBuf * dst, int src_dx, int src_dy )
+        : _dst(dst), _src_dx(src_dx), _src_dy(src_dy)
+        , _dst_dx(dst->GetWidth()), _dst_dy(dst->GetHeight())
+    {
+        _xmap = new int[_dst_dx];
+        for ( int i=0; i<_dst_dx; i++ )
+            _xmap[i] = i * _src_dx / _dst_dx;
+    }
+    virtual ~LVImageScaleCallback()
+    {
+        delete[] _xmap;
+    }
+    virtual void OnStartDecode( LVImageSource * )
+    {
+    }
+    virtual bool OnLineDecoded( LVImageSource *, int y, lUInt32 * data )
+    {
+        // destination rows yy with yy * _src_dy / _dst_dy == y
+        for ( int yy = (y * _dst_dy + _src_dy - 1) / _src_dy; yy < _dst_dy && yy * _src_dy / _dst_dy == y; yy++ ) {
+            lUInt32 * row = (lUInt32 *)_dst->GetScanLine( yy );
+            for ( int x=0; x<_dst_dx; x++ )
+                row[x] = data[_xmap[x]];
+        }
+        return true;
+    }
+    virtual void OnEndDecode( LVImageSource *, bool )
+    {
+    }
+};
+
+// Max packed size of image to read for decoding ahead
+#define IMAGE_SURFACE_MAX_PACKED_SIZE (4*1024*1024)
+// Max number of images waiting for worker
+#define IMAGE_SURFACE_MAX_QUEUED 8
+
+/// Decodes JPEG images for LVImageSurfaceCache on its own thread. Only plain
+/// buffers cross threads: refcounts of engine objects aren't atomic.
+class LVImageSurfaceWorker
+{
+public:
+    struct Job {
+        lUInt32 node;
+        lUInt8 * data;
+        int size;
+        int dx;
+        int dy;
+        int maxBytes;
+        lUInt32 * pixels;
+        int width;
+        int height;
+    };
+private:
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::vector<Job> _queue;
+    std::vector<Job> _done;
+    lUInt32 _busyNode;
+    bool _busy;
+    bool _stop;
+
+    void run()
+    {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                while (!_stop && _queue.empty())
+                    _cond.wait(lock);
+                if (_stop)
+                    return;
+                job = _queue.front();
+                _queue.erase(_queue.begin());
+                _busy = true;
+                _busyNode = job.node;
+            }
+            job.pixels = DecodeJpegBuffer(job.data, job.size, job.dx, job.dy, job.maxBytes,
+                    job.width, job.height);
+            free(job.data);
+            job.data = NULL;
+            std::lock_guard<std::mutex> lock(_mutex);
+            _busy = false;
+            _done.push_back(job);
+        }
+    }
+public:
+    LVImageSurfaceWorker() : _busyNode(0), _busy(false), _stop(false)
+    {
+        _thread = std::thread(&LVImageSurfaceWorker::run, this);
+    }
+    ~LVImageSurfaceWorker()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cond.notify_all();
+        _thread.join();
+        cancel();
+        std::vector<Job> done;
+        take(done);
+        for (size_t i = 0; i < done.size(); i++)
+            free(done[i].pixels);
+    }
+    /// returns true if image of node is queued, being decoded or decoded and not taken yet
+    bool has( lUInt32 node )
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_busy && _busyNode == node)
+            return true;
+        for (size_t i = 0; i < _queue.size(); i++)
+            if (_queue[i].node == node)
+                return true;
+        for (size_t i = 0; i < _done.size(); i++)
+            if (_done[i].node == node)
+                return true;
+        return false;
+    }
+    /// queues job, takes ownership of its data
+    bool add( const Job & job )
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_queue.size() >= IMAGE_SURFACE_MAX_QUEUED)
+                return false;
+            _queue.push_back(job);
+        }
+        _cond.notify_one();
+        return true;
+    }
+    /// drops jobs not started yet
+    void cancel()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (size_t i = 0; i < _queue.size(); i++)
+            free(_queue[i].data);
+        _queue.clear();
+    }
+    /// moves finished jobs to done, caller frees their pixels
+    void take( std::vector<Job> & done )
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        done.insert(done.end(), _done.begin(), _done.end());
+        _done.clear();
+    }
+};
+
+LVImageSurfaceCache::LVImageSurfaceCache( int maxSize )
+    : _head(NULL), _tail(NULL), _size(0), _maxSize(maxSize), _worker(NULL)
+{
+}
+
+LVImageSurfaceCache::~LVImageSurfaceCache()
+{
+    delete _worker;
+    clear();
+}
+
+LVImageSurfaceCache::Item * LVImageSurfaceCache::find( lUInt32 node, int dx, int dy )
+{
+    for ( Item * item = _head; item; item = item->next ) {
+        if ( item->node == node && item->dx == dx && item->dy == dy )
+            return item;
+    }
+    return NULL;
+}
+
+void LVImageSurfaceCache::moveToHead( Item * item )
+{
+    if ( item == _head )
+        return;
+    item->prev->next = item->next;
+    if ( item->next )
+        item->next->prev = item->prev;
+    else
+        _tail = item->prev;
+    item->prev = NULL;
+    item->next = _head;
+    _head->prev = item;
+    _head = item;
+}
+
+void LVImageSurfaceCache::remove( Item * item )
+{
+    if ( item->prev )
+        item->prev->next = item->next;
+    else
+        _head = item->next;
+    if ( item->next )
+        item->next->prev = item->prev;
+    else
+        _tail = item->prev;
+    _size -= item->buf->GetWidth() * item->buf->GetHeight() * 4;
+    delete item->buf;
+    delete item;
+}
+
+void LVImageSurfaceCache::add( lUInt32 node, int dx, int dy, LVColorDrawBuf * buf )
+{
+    int size = buf->GetWidth() * buf->GetHeight() * 4;
+    while ( _tail && _size + size > _maxSize )
+        remove( _tail );
+    Item * item = new Item();
+    item->node = node;
+    item->dx = dx;
+    item->dy = dy;
+    item->buf = buf;
+    item->prev = NULL;
+    item->next = _head;
+    if ( _head )
+        _head->prev = item;
+    else
+        _tail = item;
+    _head = item;
+    _size += size;
+}
+
+void LVImageSurfaceCache::collect()
+{
+    if ( !_worker )
+        return;
+    std::vector<LVImageSurfaceWorker::Job> done;
+    _worker->take( done );
+    for ( size_t i = 0; i < done.size(); i++ ) {
+        LVImageSurfaceWorker::Job & job = done[i];
+        if ( job.pixels && !find( job.node, 0, 0 ) ) {
+            LVColorDrawBuf * buf = new LVColorDrawBuf( job.width, job.height, 32 );
+            for ( int y=0; y<job.height; y++ )
+                memcpy( buf->GetScanLine(y), job.pixels + y * job.width, job.width * sizeof(lUInt32) );
+            add( job.node, 0, 0, buf );
+        }
+        free( job.pixels );
+    }
+}
+
+LVImageSourceRef LVImageSurfaceCache::get( ldomNode * node, int dx, int dy )
+{
+    collect();
+    lUInt32 index = node->getDataIndex();
+    Item * item = find( index, dx, dy );
+    if ( item ) {
+        moveToHead( item );
+        return LVCreateDrawBufImageSource( item->buf, false );
+    }
+    LVImageSourceRef src;
+    item = find( index, 0, 0 );
+    if ( item ) {
+        moveToHead( item );
+        src = LVCreateDrawBufImageSource( item->buf, false );
+    } else {
+        src = node->getObjectImageSource();
+    }
+    if ( src.isNull() || dx <= 0 || dy <= 0 || dx * dy * 4 > _maxSize / 4 || src->GetNinePatchInfo() )
+        return src;
+    int scale = src->GetDecodeScale( dx, dy );
+    int src_dx = (src->GetWidth() + scale - 1) / scale;
+    int src_dy = (src->GetHeight() + scale - 1) / scale;
+    if ( src_dx <= 0 || src_dy <= 0 )
+        return src;
+    LVColorDrawBuf * buf = new LVColorDrawBuf( dx, dy, 32 );
+    // rows never decoded stay transparent
+    buf->Clear( 0xFF000000 );
+    LVImageScaleCallback callback( buf, src_dx, src_dy );
+    if ( !src->DecodeScaled( &callback, scale ) ) {
+        delete buf;
+        return src;
+    }
+    add( index, dx, dy, buf );
+    return LVCreateDrawBufImageSource( buf, false );
+}
+
+void LVImageSurfaceCache::prewarm( ldomNode * node, int maxDx, int maxDy )
+{
+    lUInt32 index = node->getDataIndex();
+    for ( Item * item = _head; item; item = item->next ) {
+        if ( item->node == index )
+            return;
+    }
+#if (USE_LIBJPEG==1)
+    if ( _worker && _worker->has( index ) )
+        return;
+    LVStreamRef stream = node->getObjectImageStream();
+    if ( stream.isNull() )
+        return;
+    lvsize_t size = stream->GetSize();
+    if ( size < 4 || size > IMAGE_SURFACE_MAX_PACKED_SIZE )
+        return;
+    lUInt8 * data = (lUInt8 *) malloc( size );
+    lvsize_t bytesRead = 0;
+    if ( stream->Read( data, size, &bytesRead ) != LVERR_OK || bytesRead != size ) {
+        free( data );
+        return;
+    }
+    if ( LVJpegImageSource::CheckPattern( data, (int)size ) ) {
+        if ( !_worker )
+            _worker = new LVImageSurfaceWorker();
+        LVImageSurfaceWorker::Job job;
+        memset( &job, 0, sizeof(job) );
+        job.node = index;
+        job.data = data;
+        job.size = (int)size;
+        job.dx = maxDx;
+        job.dy = maxDy;
+        job.maxBytes = _maxSize / 4;
+        if ( !_worker->add( job ) )
+            free( data );
+        return;
+    }
+    // Other formats would be decoded on caller thread and block the next request
+    free( data );
+#else
+    CR_UNUSED2(maxDx, maxDy);
+#endif
+}
+
+void LVImageSurfaceCache::cancelPrewarm()
+{
+    if ( _worker )
+        _worker->cancel();
+}
+
+void LVImageSurfaceCache::clear()
+{
+    if ( _worker ) {
+        _worker->cancel();
+        std::vector<LVImageSurfaceWorker::Job> done;
+        _worker->take( done );
+        for ( size_t i = 0; i < done.size(); i++ )
+            free( done[i].pixels );
+    }
+    while ( _tail )
+        remove( _tail );
+}
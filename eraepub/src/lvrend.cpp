@@ -1963,23 +1963,46 @@ void ApplyInlineStyle(ldomNode * enode, css_style_rec_t* pstyle)
 void setNodeStyleRend(ldomNode* enode, css_style_ref_t parent_style, LVFontRef parent_font)
 {
     //lvdomElementFormatRec * fmt = node->getRenderData();
-    css_style_ref_t style(new css_style_rec_t);
-    css_style_rec_t* pstyle = style.get();
 #ifdef OREDEBUG
     if (parent_style.isNull()) {
         CRLog::error("setNodeStyleRend: parent style is null");
     }
 #endif
+    CrDom* doc = enode->getCrDom();
+    LVStyleSheet* stylesheet = doc->getStylesheet();
+    int baseFontSize = doc->getDefaultFont()->getSize();
+
+    // Computed style of node depends only on these values if stylesheet
+    // doesn't look at its neighbours, so it is shared with previous such node
+    ldomStyleShareKey share_key;
+    bool shareable = !parent_style.isNull() && !enode->isRoot() && stylesheet->isContextFree(enode);
+    if (shareable) {
+        share_key.parent = parent_style.get();
+        share_key.id = enode->getNodeId();
+        share_key.class_index = enode->getAttributeValueIndex(LXML_NS_ANY, attr_class);
+        share_key.style_index = enode->getAttributeValueIndex(LXML_NS_ANY, attr_style);
+        share_key.base_font_size = baseFontSize;
+        share_key.embedded_lvl = gEmbeddedStylesLVL;
+        share_key.sheet_generation = stylesheet->getGeneration();
+        css_style_ref_t shared = doc->getStyleShareCache().get(share_key);
+        if (!shared.isNull()) {
+            enode->setStyle(shared);
+            enode->initNodeFont();
+            return;
+        }
+    }
+
+    css_style_ref_t style(new css_style_rec_t);
+    css_style_rec_t* pstyle = style.get();
     // Init default style attribute values
     const css_elem_def_props_t* type_ptr = enode->getElementTypePtr();
     if (type_ptr) {
         pstyle->display = type_ptr->display;
         pstyle->white_space = type_ptr->white_space;
     }
-    int baseFontSize = enode->getCrDom()->getDefaultFont()->getSize();
 
     // Apply style sheet
-    enode->getCrDom()->getStylesheet()->applyCss(enode, pstyle);
+    stylesheet->applyCss(enode, pstyle);
 
     //inilne style goes second, to have more priority over stylesheet
     //apply inline style
@@ -2118,6 +2141,9 @@ void setNodeStyleRend(ldomNode* enode, css_style_ref_t parent_style, LVFontRef p
         CRLog::error("NULL style set!!!");
         enode->setStyle(style);
     }
+    if (shareable) {
+        doc->getStyleShareCache().put(share_key, parent_style, enode->getStyle());
+    }
     // set font
     enode->initNodeFont();
 }
@@ -2090,6 +2090,8 @@ struct ZipHd2
 //#define ARC_OUTBUF_SIZE 16384
 #define ARC_INBUF_SIZE  5000
 #define ARC_OUTBUF_SIZE 10000
+// Larger items are read through LVZipDecodeStream only
+#define ARC_PACKED_ITEM_MAX_SIZE (32*1024*1024)
 
 class LVZipDecodeStream : public LVNamedStream
 {
@@ -2457,19 +2459,52 @@ public:
     }
 };
 
+bool LVInflatePackedItem(LVPackedItem & item)
+{
+    if (item.packed == NULL || item.data != NULL)
+        return false;
+    item.data = (lUInt8 *) malloc(item.unpSize);
+    if (item.data == NULL)
+        return false;
+    if (item.method == 0)
+    {
+        memcpy(item.data, item.packed, item.unpSize);
+        return true;
+    }
+    z_stream_s zstream;
+    memset(&zstream, 0, sizeof(zstream));
+    if (inflateInit2(&zstream, -15) != Z_OK)
+    {
+        free(item.data);
+        item.data = NULL;
+        return false;
+    }
+    zstream.next_in = item.packed;
+    zstream.avail_in = item.packSize;
+    zstream.next_out = item.data;
+    zstream.avail_out = item.unpSize;
+    int res = inflate(&zstream, Z_FINISH);
+    bool ok = (res == Z_STREAM_END && zstream.total_out == item.unpSize);
+    inflateEnd(&zstream);
+    if (!ok)
+    {
+        free(item.data);
+        item.data = NULL;
+    }
+    return ok;
+}
+
 class LVZipArc : public LVArcContainerBase
 {
 public:
-    virtual LVStreamRef OpenStream( const wchar_t * fname, lvopen_mode_t /*mode*/ )
+    int FindItem( const wchar_t * fname )
     {
-        if ( fname[0]=='/' )
-            fname++;
         int found_index = -1;
         for (int i=0; i<m_list.length(); i++) {
             if ( !lStr_cmp( fname, m_list[i]->GetName() ) ) {
                 if ( m_list[i]->IsContainer() ) {
                     // found directory with same name!!!
-                    return LVStreamRef();
+                    return -1;
                 }
                 found_index = i;
                 break;
@@ -2484,13 +2519,21 @@ public:
                     if (m_list[i]->IsContainer())
                     {
                         // found directory with same name!!!
-                        return LVStreamRef();
+                        return -1;
                     }
                     found_index = i;
                     break;
                 }
             }
         }
+        return found_index;
+    }
+
+    virtual LVStreamRef OpenStream( const wchar_t * fname, lvopen_mode_t /*mode*/ )
+    {
+        if ( fname[0]=='/' )
+            fname++;
+        int found_index = FindItem(fname);
         if (found_index<0)
             return LVStreamRef(); // not found
         // make filename
@@ -2511,6 +2554,51 @@ public:
         }
         return stream;
     }
+    virtual bool ReadPackedItem( const lChar16 * fname, LVPackedItem & item )
+    {
+        if ( fname[0]=='/' )
+            fname++;
+        int found_index = FindItem(fname);
+        // Stream opened by decoded name would carry the stored one
+        if (found_index<0 || lStr_cmp( fname, m_list[found_index]->GetName() ))
+            return false;
+        ZipLocalFileHdr hdr;
+        unsigned hdr_size = 0x1E; //sizeof(hdr);
+        lvpos_t pos = m_list[found_index]->GetSrcPos();
+        lvsize_t sz = 0;
+        if ( m_stream->Seek( pos, LVSEEK_SET, NULL )!=LVERR_OK )
+            return false;
+        if ( m_stream->Read( &hdr, hdr_size, &sz)!=LVERR_OK || sz!=hdr_size )
+            return false;
+        hdr.byteOrderConv();
+        pos += 0x1e + hdr.getNameLen() + hdr.getAddLen();
+        // Only items LVZipDecodeStream::Create reads purely from local header,
+        // so unpacked data is exactly what OpenStream would give
+        lUInt32 packSize = hdr.getPackSize();
+        lUInt32 unpSize = hdr.getUnpSize();
+        int method = hdr.getMethod();
+        if (packSize == 0 || unpSize == 0 || unpSize > ARC_PACKED_ITEM_MAX_SIZE)
+            return false;
+        if (method != 0 && method != 8)
+            return false;
+        if (method == 0 && packSize != unpSize)
+            return false;
+        if ((lvpos_t)(pos + packSize) > (lvpos_t)m_stream->GetSize())
+            return false;
+        if ( m_stream->Seek( pos, LVSEEK_SET, NULL )!=LVERR_OK )
+            return false;
+        item.packed = (lUInt8 *) malloc(packSize);
+        if ( m_stream->Read( item.packed, packSize, &sz)!=LVERR_OK || sz!=packSize )
+        {
+            free(item.packed);
+            item.packed = NULL;
+            return false;
+        }
+        item.packSize = packSize;
+        item.unpSize = unpSize;
+        item.method = method;
+        return true;
+    }
     virtual LVStreamRef OpenStreamByPackedSize(uint32_t size)
     {
         int found_index = -1;
@@ -25,6 +25,14 @@
 #include "include/charProps.h"
 #include "include/lStringCollection.h"
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define ASCII_SIMD_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define ASCII_SIMD_SSE2 1
+#endif
+
 ref_count_rec_t ref_count_rec_t::null_ref(NULL);
 
 #define LS_DEBUG_CHECK
@@ -32,6 +40,14 @@ ref_count_rec_t ref_count_rec_t::null_ref(NULL);
 // set to 1 to enable debugging
 #define DEBUG_STATIC_STRING_ALLOC 0
 #define STRING_HASH_MULT 31
+// set to 1 to count string chunk and buffer allocations, see lStr_dumpAllocStats
+#define STRING_ALLOC_STATS 0
+// chunk block size past header, strings up to this size are stored in the block itself
+#define STRING_INLINE_BYTES 64
+#define STRING_INLINE_CHARS_8  ((int)(STRING_INLINE_BYTES / sizeof(lChar8)) - 1)
+#define STRING_INLINE_CHARS_16 ((int)(STRING_INLINE_BYTES / sizeof(lChar16)) - 1)
+// max number of free chunk blocks cached by each thread
+#define STRING_FREE_BLOCKS_MAX 4096
 #define CONT_BYTE(index,shift) (((lChar16)(s[index]) & 0x3F) << shift)
 
 
@@ -43,6 +59,156 @@ static lChar16 empty_str_16[] = {0};
 static lstring16_chunk_t empty_chunk_16(empty_str_16);
 lstring16_chunk_t * lString16::EMPTY_STR_16 = &empty_chunk_16;
 
+//================================================================================
+// string chunk blocks
+//================================================================================
+
+#if STRING_ALLOC_STATS == 1
+static int stat_blocks_malloc = 0;
+static int stat_blocks_reused = 0;
+static int stat_buffers_malloc = 0;
+static int stat_buffers_realloc = 0;
+#define STRING_ALLOC_STAT(counter) (counter++)
+#else
+#define STRING_ALLOC_STAT(counter)
+#endif
+
+void lStr_dumpAllocStats(const char * title)
+{
+#if STRING_ALLOC_STATS == 1
+    CRLog::debug("String allocations %s: %d chunk blocks allocated, %d reused, %d buffers allocated, %d reallocated",
+            title, stat_blocks_malloc, stat_blocks_reused, stat_buffers_malloc, stat_buffers_realloc);
+    stat_blocks_malloc = stat_blocks_reused = stat_buffers_malloc = stat_buffers_realloc = 0;
+#endif
+}
+
+/// Free list of chunk blocks, each thread has its own to avoid locking.
+/// Block freed on another thread than allocated just goes to that thread's list.
+struct lstring_block_list_t {
+    void * head;
+    int count;
+    lstring_block_list_t() : head(NULL), count(0) { }
+    ~lstring_block_list_t()
+    {
+        while (head) {
+            void * next = *(void **)head;
+            ::free(head);
+            head = next;
+        }
+        // strings released later on thread exit are freed directly
+        count = STRING_FREE_BLOCKS_MAX;
+    }
+    inline void * get()
+    {
+        if (!head) {
+            STRING_ALLOC_STAT(stat_blocks_malloc);
+            // 8 and 16 bit chunk headers have the same layout
+            return ::malloc(sizeof(lstring16_chunk_t) + STRING_INLINE_BYTES);
+        }
+        STRING_ALLOC_STAT(stat_blocks_reused);
+        void * p = head;
+        head = *(void **)p;
+        count--;
+        return p;
+    }
+    inline void put(void * p)
+    {
+        if (count >= STRING_FREE_BLOCKS_MAX) {
+            ::free(p);
+            return;
+        }
+        *(void **)p = head;
+        head = p;
+        count++;
+    }
+};
+
+static thread_local lstring_block_list_t string_blocks;
+
+lstring8_chunk_t * lstring8_chunk_t::alloc()
+{
+    lstring8_chunk_t * chunk = (lstring8_chunk_t *)string_blocks.get();
+    chunk->buf8 = (lChar8 *)(chunk + 1);
+    chunk->size = STRING_INLINE_CHARS_8;
+    chunk->len = 0;
+    chunk->nref = 1;
+    return chunk;
+}
+
+void lstring8_chunk_t::free(lstring8_chunk_t * pChunk)
+{
+    if (!pChunk->isInline())
+        ::free(pChunk->buf8);
+    string_blocks.put(pChunk);
+}
+
+void lstring8_chunk_t::resizeBuffer(lInt32 n)
+{
+    if (n <= STRING_INLINE_CHARS_8) {
+        if (!isInline()) {
+            // shrinking, move chars back to block
+            lChar8 * inl = (lChar8 *)(this + 1);
+            memcpy(inl, buf8, sizeof(lChar8) * (len < n ? len + 1 : n + 1));
+            ::free(buf8);
+            buf8 = inl;
+        }
+        size = STRING_INLINE_CHARS_8;
+        return;
+    }
+    if (isInline()) {
+        STRING_ALLOC_STAT(stat_buffers_malloc);
+        lChar8 * p = (lChar8 *)::malloc(sizeof(lChar8) * (n + 1));
+        memcpy(p, buf8, sizeof(lChar8) * (len + 1));
+        buf8 = p;
+    } else {
+        STRING_ALLOC_STAT(stat_buffers_realloc);
+        buf8 = (lChar8 *)::realloc(buf8, sizeof(lChar8) * (n + 1));
+    }
+    size = n;
+}
+
+lstring16_chunk_t * lstring16_chunk_t::alloc()
+{
+    lstring16_chunk_t * chunk = (lstring16_chunk_t *)string_blocks.get();
+    chunk->buf16 = (lChar16 *)(chunk + 1);
+    chunk->size = STRING_INLINE_CHARS_16;
+    chunk->len = 0;
+    chunk->nref = 1;
+    return chunk;
+}
+
+void lstring16_chunk_t::free(lstring16_chunk_t * pChunk)
+{
+    if (!pChunk->isInline())
+        ::free(pChunk->buf16);
+    string_blocks.put(pChunk);
+}
+
+void lstring16_chunk_t::resizeBuffer(lInt32 n)
+{
+    if (n <= STRING_INLINE_CHARS_16) {
+        if (!isInline()) {
+            // shrinking, move chars back to block
+            lChar16 * inl = (lChar16 *)(this + 1);
+            memcpy(inl, buf16, sizeof(lChar16) * (len < n ? len + 1 : n + 1));
+            ::free(buf16);
+            buf16 = inl;
+        }
+        size = STRING_INLINE_CHARS_16;
+        return;
+    }
+    if (isInline()) {
+        STRING_ALLOC_STAT(stat_buffers_malloc);
+        lChar16 * p = (lChar16 *)::malloc(sizeof(lChar16) * (n + 1));
+        memcpy(p, buf16, sizeof(lChar16) * (len + 1));
+        buf16 = p;
+    } else {
+        STRING_ALLOC_STAT(stat_buffers_realloc);
+        buf16 = (lChar16 *)::realloc(buf16, sizeof(lChar16) * (n + 1));
+    }
+    size = n;
+}
+
 //================================================================================
 // atomic string storages for string literals
 //================================================================================
@@ -473,17 +639,18 @@ void lString16::free()
     if (pchunk==EMPTY_STR_16)
         return;
     //assert(pchunk->buf16[pchunk->len]==0);
-    ::free(pchunk->buf16);
-    ::free(pchunk);
+    lstring_chunk_t::free(pchunk);
 }
 
 void lString16::alloc(int sz)
 {
-    pchunk = (lstring_chunk_t*) ::malloc(sizeof(lstring_chunk_t));
-    pchunk->buf16 = (lChar16*) ::malloc(sizeof(lChar16) * (sz + 1));
-    assert(pchunk->buf16 != NULL);
-    pchunk->size = sz;
-    pchunk->nref = 1;
+    pchunk = lstring_chunk_t::alloc();
+    if (sz > pchunk->size) {
+        STRING_ALLOC_STAT(stat_buffers_malloc);
+        pchunk->buf16 = (lChar16*) ::malloc(sizeof(lChar16) * (sz + 1));
+        assert(pchunk->buf16 != NULL);
+        pchunk->size = sz;
+    }
 }
 
 lString16::lString16(const lChar16 * str)
@@ -574,8 +741,7 @@ lString16 & lString16::assign(const lChar16 * str)
             if (pchunk->size<=len)
             {
                 // resize is necessary
-                pchunk->buf16 = (lChar16*) ::realloc( pchunk->buf16, sizeof(lChar16)*(len+1) );
-                pchunk->size = len+1;
+                pchunk->resizeBuffer(len);
             }
         }
         else
@@ -603,8 +769,7 @@ lString16 & lString16::assign(const lChar8 * str)
             if (pchunk->size<=len)
             {
                 // resize is necessary
-                pchunk->buf16 = (lChar16*) ::realloc( pchunk->buf16, sizeof(lChar16)*(len+1) );
-                pchunk->size = len+1;
+                pchunk->resizeBuffer(len);
             }
         }
         else
@@ -632,8 +797,7 @@ lString16 & lString16::assign(const lChar16 * str, size_type count)
             if (pchunk->size<=len)
             {
                 // resize is necessary
-                pchunk->buf16 = (lChar16*) ::realloc( pchunk->buf16, sizeof(lChar16)*(len+1) );
-                pchunk->size = len+1;
+                pchunk->resizeBuffer(len);
             }
         }
         else
@@ -661,8 +825,7 @@ lString16 & lString16::assign(const lChar8 * str, size_type count)
             if (pchunk->size<=len)
             {
                 // resize is necessary
-                pchunk->buf16 = (lChar16*) ::realloc( pchunk->buf16, sizeof(lChar16)*(len+1) );
-                pchunk->size = len+1;
+                pchunk->resizeBuffer(len);
             }
         }
         else
@@ -706,8 +869,7 @@ lString16 & lString16::assign(const lString16 & str, size_type offset, size_type
                 if (pchunk->size<=count)
                 {
                     // resize is necessary
-                    pchunk->buf16 = (lChar16*) ::realloc( pchunk->buf16, sizeof(lChar16)*(count+1) );
-                    pchunk->size = count+1;
+                    pchunk->resizeBuffer(count);
                 }
             }
             else
@@ -758,8 +920,10 @@ void lString16::reserve(size_type n)
     {
         if (pchunk->size < n)
         {
-            pchunk->buf16 = (lChar16*) ::realloc( pchunk->buf16, sizeof(lChar16)*(n+1) );
-            pchunk->size = n;
+            // string being appended to grows by half, so building it by appends takes few reallocs
+            if (pchunk->len > 0 && n < pchunk->size + pchunk->size / 2)
+                n = pchunk->size + pchunk->size / 2;
+            pchunk->resizeBuffer(n);
         }
     }
     else
@@ -805,8 +969,7 @@ void lString16::resize(size_type n, lChar16 e)
     lock( n );
     if (n>=pchunk->size)
     {
-        pchunk->buf16 = (lChar16*) ::realloc( pchunk->buf16, sizeof(lChar16)*(n+1) );
-        pchunk->size = n;
+        pchunk->resizeBuffer(n);
     }
     // fill with data if expanded
     for (size_type i=pchunk->len; i<n; i++)
@@ -932,8 +1095,7 @@ lString16 & lString16::pack()
         }
         else
         {
-            pchunk->buf16 = (lChar16 *) realloc( pchunk->buf16, sizeof(lChar16)*(pchunk->len+1) );
-            pchunk->size = pchunk->len;
+            pchunk->resizeBuffer(pchunk->len);
         }
     }
     return *this;
@@ -1212,17 +1374,18 @@ void lString8::free()
 {
     if ( pchunk==EMPTY_STR_8 )
         return;
-    ::free(pchunk->buf8);
-    ::free(pchunk);
+    lstring_chunk_t::free(pchunk);
 }
 
 void lString8::alloc(int sz)
 {
-    pchunk = (lstring_chunk_t*)::malloc(sizeof(lstring_chunk_t));
-    pchunk->buf8 = (lChar8*) ::malloc( sizeof(lChar8) * (sz+1) );
-    assert( pchunk->buf8!=NULL );
-    pchunk->size = sz;
-    pchunk->nref = 1;
+    pchunk = lstring_chunk_t::alloc();
+    if (sz > pchunk->size) {
+        STRING_ALLOC_STAT(stat_buffers_malloc);
+        pchunk->buf8 = (lChar8*) ::malloc( sizeof(lChar8) * (sz+1) );
+        assert( pchunk->buf8!=NULL );
+        pchunk->size = sz;
+    }
 }
 
 lString8::lString8(const lChar8 * str)
@@ -1299,8 +1462,7 @@ lString8 & lString8::assign(const lChar8 * str)
             if (pchunk->size<=len)
             {
                 // resize is necessary
-                pchunk->buf8 = (lChar8*) ::realloc( pchunk->buf8, sizeof(lChar8)*(len+1) );
-                pchunk->size = len+1;
+                pchunk->resizeBuffer(len);
             }
         }
         else
@@ -1328,8 +1490,7 @@ lString8 & lString8::assign(const lChar8 * str, size_type count)
             if (pchunk->size<=len)
             {
                 // resize is necessary
-                pchunk->buf8 = (lChar8*) ::realloc( pchunk->buf8, sizeof(lChar8)*(len+1) );
-                pchunk->size = len+1;
+                pchunk->resizeBuffer(len);
             }
         }
         else
@@ -1373,8 +1534,7 @@ lString8 & lString8::assign(const lString8 & str, size_type offset, size_type co
                 if (pchunk->size<=count)
                 {
                     // resize is necessary
-                    pchunk->buf8 = (lChar8*) ::realloc( pchunk->buf8, sizeof(lChar8)*(count+1) );
-                    pchunk->size = count+1;
+                    pchunk->resizeBuffer(count);
                 }
             }
             else
@@ -1425,8 +1585,10 @@ void lString8::reserve(size_type n)
     {
         if (pchunk->size < n)
         {
-            pchunk->buf8 = (lChar8*) ::realloc( pchunk->buf8, sizeof(lChar8)*(n+1) );
-            pchunk->size = n;
+            // string being appended to grows by half, so building it by appends takes few reallocs
+            if (pchunk->len > 0 && n < pchunk->size + pchunk->size / 2)
+                n = pchunk->size + pchunk->size / 2;
+            pchunk->resizeBuffer(n);
         }
     }
     else
@@ -1472,8 +1634,7 @@ void lString8::resize(size_type n, lChar8 e)
     lock( n );
     if (n>=pchunk->size)
     {
-        pchunk->buf8 = (lChar8*) ::realloc( pchunk->buf8, sizeof(lChar8)*(n+1) );
-        pchunk->size = n;
+        pchunk->resizeBuffer(n);
     }
     // fill with data if expanded
     for (size_type i=pchunk->len; i<n; i++)
@@ -1928,8 +2089,7 @@ lString8 & lString8::pack()
         }
         else
         {
-            pchunk->buf8 = (lChar8 *) realloc( pchunk->buf8, sizeof(lChar8)*(pchunk->len+1) );
-            pchunk->size = pchunk->len;
+            pchunk->resizeBuffer(pchunk->len);
         }
     }
     return *this;
@@ -2294,6 +2454,141 @@ lUInt32 lString8::getHash() const
 
 const lString8 lString8::empty_str;
 
+// Plain ASCII is checked 16 bytes at a time: byte 0 and bytes with high bit set stop the run,
+// then scalar loop finds exact position. lChar16 is wchar_t, 4 bytes wide on all targets except Windows.
+
+int lStr_asciiLength(const lUInt8 * src, int len)
+{
+    int i = 0;
+#if defined(ASCII_SIMD_NEON)
+    const uint8x16_t one = vdupq_n_u8(1);
+    const uint8x16_t limit = vdupq_n_u8(0x7E);
+    for ( ; i + 16 <= len; i += 16) {
+        // 0 wraps to 0xFF after subtraction, so both 0 and 0x80..0xFF become greater than 0x7E
+        uint64x2_t bad = vreinterpretq_u64_u8(vcgtq_u8(vsubq_u8(vld1q_u8(src + i), one), limit));
+        if (vgetq_lane_u64(bad, 0) | vgetq_lane_u64(bad, 1))
+            break;
+    }
+#elif defined(ASCII_SIMD_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for ( ; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        if (_mm_movemask_epi8(v) | _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)))
+            break;
+    }
+#endif
+    for ( ; i < len; i++) {
+        lUInt8 ch = src[i];
+        if (ch == 0 || (ch & 0x80))
+            break;
+    }
+    return i;
+}
+
+int lStr_decodeAscii(const lUInt8 * src, int len, lChar16 * dst)
+{
+    int i = 0;
+#if defined(ASCII_SIMD_NEON)
+    const uint8x16_t one = vdupq_n_u8(1);
+    const uint8x16_t limit = vdupq_n_u8(0x7E);
+    for ( ; i + 16 <= len; i += 16) {
+        uint8x16_t v = vld1q_u8(src + i);
+        uint64x2_t bad = vreinterpretq_u64_u8(vcgtq_u8(vsubq_u8(v, one), limit));
+        if (vgetq_lane_u64(bad, 0) | vgetq_lane_u64(bad, 1))
+            break;
+        uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+        uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+        if (sizeof(lChar16) == 4) {
+            vst1q_u32((uint32_t *)(dst + i), vmovl_u16(vget_low_u16(lo)));
+            vst1q_u32((uint32_t *)(dst + i + 4), vmovl_u16(vget_high_u16(lo)));
+            vst1q_u32((uint32_t *)(dst + i + 8), vmovl_u16(vget_low_u16(hi)));
+            vst1q_u32((uint32_t *)(dst + i + 12), vmovl_u16(vget_high_u16(hi)));
+        } else {
+            vst1q_u16((uint16_t *)(dst + i), lo);
+            vst1q_u16((uint16_t *)(dst + i + 8), hi);
+        }
+    }
+#elif defined(ASCII_SIMD_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for ( ; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        if (_mm_movemask_epi8(v) | _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)))
+            break;
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        if (sizeof(lChar16) == 4) {
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi16(lo, zero));
+            _mm_storeu_si128((__m128i *)(dst + i + 4), _mm_unpackhi_epi16(lo, zero));
+            _mm_storeu_si128((__m128i *)(dst + i + 8), _mm_unpacklo_epi16(hi, zero));
+            _mm_storeu_si128((__m128i *)(dst + i + 12), _mm_unpackhi_epi16(hi, zero));
+        } else {
+            _mm_storeu_si128((__m128i *)(dst + i), lo);
+            _mm_storeu_si128((__m128i *)(dst + i + 8), hi);
+        }
+    }
+#endif
+    for ( ; i < len; i++) {
+        lUInt8 ch = src[i];
+        if (ch == 0 || (ch & 0x80))
+            break;
+        dst[i] = ch;
+    }
+    return i;
+}
+
+int lStr_encodeAscii(const lChar16 * src, int len, lUInt8 * dst)
+{
+    int i = 0;
+    if (sizeof(lChar16) == 4) {
+#if defined(ASCII_SIMD_NEON)
+        const uint32x4_t high = vdupq_n_u32(0xFFFFFF80);
+        for ( ; i + 16 <= len; i += 16) {
+            const uint32_t * p = (const uint32_t *)(src + i);
+            uint32x4_t v0 = vld1q_u32(p);
+            uint32x4_t v1 = vld1q_u32(p + 4);
+            uint32x4_t v2 = vld1q_u32(p + 8);
+            uint32x4_t v3 = vld1q_u32(p + 12);
+            uint32x4_t bad = vorrq_u32(vorrq_u32(vtstq_u32(v0, high), vtstq_u32(v1, high)),
+                                       vorrq_u32(vtstq_u32(v2, high), vtstq_u32(v3, high)));
+            uint32x4_t zero = vorrq_u32(vorrq_u32(vceqq_u32(v0, vdupq_n_u32(0)), vceqq_u32(v1, vdupq_n_u32(0))),
+                                        vorrq_u32(vceqq_u32(v2, vdupq_n_u32(0)), vceqq_u32(v3, vdupq_n_u32(0))));
+            uint64x2_t any = vreinterpretq_u64_u32(vorrq_u32(bad, zero));
+            if (vgetq_lane_u64(any, 0) | vgetq_lane_u64(any, 1))
+                break;
+            uint16x8_t lo = vcombine_u16(vmovn_u32(v0), vmovn_u32(v1));
+            uint16x8_t hi = vcombine_u16(vmovn_u32(v2), vmovn_u32(v3));
+            vst1q_u8(dst + i, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+        }
+#elif defined(ASCII_SIMD_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i high = _mm_set1_epi32((int)0xFFFFFF80);
+        for ( ; i + 16 <= len; i += 16) {
+            const __m128i * p = (const __m128i *)(src + i);
+            __m128i v0 = _mm_loadu_si128(p);
+            __m128i v1 = _mm_loadu_si128(p + 1);
+            __m128i v2 = _mm_loadu_si128(p + 2);
+            __m128i v3 = _mm_loadu_si128(p + 3);
+            __m128i any = _mm_and_si128(_mm_or_si128(_mm_or_si128(v0, v1), _mm_or_si128(v2, v3)), high);
+            __m128i zeros = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi32(v0, zero), _mm_cmpeq_epi32(v1, zero)),
+                                         _mm_or_si128(_mm_cmpeq_epi32(v2, zero), _mm_cmpeq_epi32(v3, zero)));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(any, zero)) != 0xFFFF || _mm_movemask_epi8(zeros))
+                break;
+            // all values are 1..127, so saturating packs keep them as is
+            __m128i lo = _mm_packs_epi32(v0, v1);
+            __m128i hi = _mm_packs_epi32(v2, v3);
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+        }
+#endif
+    }
+    for ( ; i < len; i++) {
+        lChar16 ch = src[i];
+        if (ch == 0 || (ch & ~0x7F))
+            break;
+        dst[i] = (lUInt8)ch;
+    }
+    return i;
+}
+
 int Utf8CharCount(const lChar8 * str)
 {
     int count = 0;
@@ -2349,7 +2644,12 @@ int Utf8CharCount(const lChar8 * str, int len)
     int count = 0;
     lUInt8 ch;
     const lChar8 * endp = str + len;
-    while ((ch=*str++)) {
+    for (;;) {
+        int ascii = lStr_asciiLength((const lUInt8 *)str, (int)(endp - str));
+        str += ascii;
+        count += ascii;
+        if (str >= endp || !(ch = *str++))
+            break;
         if ( (ch & 0x80) == 0 ) {
         } else if ( (ch & 0xE0) == 0xC0 ) {
             str++;
@@ -2414,7 +2714,13 @@ static void DecodeUtf8(const char* s,  lChar16* p, int len)
     lChar16 * endp = p + len;
     lUInt32 ch;
     while (p < endp) {
-        ch = *s++;
+        // source has at least one byte per remaining char
+        int ascii = lStr_decodeAscii((const lUInt8 *)s, (int)(endp - p), p);
+        s += ascii;
+        p += ascii;
+        if (p >= endp)
+            break;
+        ch = (lUInt8)*s++;
         if ( (ch & 0x80) == 0 ) {
         	*p++ = (char)ch;
         } else if ( (ch & 0xE0) == 0xC0 ) {
@@ -2461,8 +2767,16 @@ void Utf8ToUnicode(const lUInt8 * src,  int &srclen, lChar16 * dst, int &dstlen)
     while (p < endp && s < ends) {
         ch = *s;
         if ( (ch & 0x80) == 0 ) {
-            *p++ = (char)ch;
-            s++;
+            int left = (int)(ends - s);
+            int room = (int)(endp - p);
+            int ascii = lStr_decodeAscii(s, left < room ? left : room, p);
+            if (ascii) {
+                s += ascii;
+                p += ascii;
+            } else {
+                *p++ = (char)ch;
+                s++;
+            }
         } else if ( (ch & 0xE0) == 0xC0 ) {
             if (s + 2 > ends)
                 break;
@@ -2542,11 +2856,16 @@ lString8 UnicodeToUtf8(const lChar16* s, int count)
     if (count <= 0)
       return lString8::empty_str;
     lString8 dst;
-    int len = Utf8ByteCount(s, count);
-    if (len <= 0)
-      return lString8::empty_str;
-    dst.append(len, ' ');
-    lChar8 * buf = dst.modify(); {
+    dst.append(count, ' ');
+    int ascii = lStr_encodeAscii(s, count, (lUInt8 *)dst.modify());
+    if (ascii == count)
+        return dst;
+    s += ascii;
+    count -= ascii;
+    int len = ascii + Utf8ByteCount(s, count);
+    if (len > ascii + count)
+        dst.append(len - ascii - count, ' ');
+    lChar8 * buf = dst.modify() + ascii; {
         lUInt32 ch;
         while ((count--) > 0) {
             ch = *s++;
@@ -2608,6 +2927,12 @@ lString16 ByteToUnicode(const lString8& str, const lChar16* table)
 {
     lString16 buf;
     buf.reserve( str.length() );
+    int ascii = lStr_asciiLength((const lUInt8 *)str.c_str(), str.length());
+    if (ascii == str.length()) {
+        buf.append(ascii, 0);
+        lStr_decodeAscii((const lUInt8 *)str.c_str(), ascii, buf.modify());
+        return buf;
+    }
     for (int i=0; i < str.length(); i++) {
         lChar16 ch = (unsigned char)str[i];
         lChar16 ch16 = ((ch & 0x80) && table) ? table[ (ch&0x7F) ] : ch;
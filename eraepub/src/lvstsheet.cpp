@@ -605,6 +605,17 @@ bool LVCssSelectorRule::check(const ldomNode*& node)
     return true;
 }
 
+bool LVCssSelector::isContextFree() const
+{
+    for (LVCssSelectorRule* rule = _rules; rule != NULL; rule = rule->getNext()) {
+        LVCssSelectorRuleType type = rule->getType();
+        if (type != cssrt_class && type != cssrt_universal) {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool LVCssSelector::check(const ldomNode* node) const
 {
     // Check main Id
@@ -707,6 +718,48 @@ void LVStyleSheet::applyCssMulticlass(std::vector<lString16> coll, const ldomNod
 }
 */
 
+static bool isSelectorChainContextFree(LVCssSelector* sel)
+{
+    for (; sel != NULL; sel = sel->getNext()) {
+        if (!sel->isContextFree()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const LVStyleSheet::ClassMatch& LVStyleSheet::getClassMatch(const ldomNode* node)
+{
+    lUInt16 id = node->getNodeId();
+    // Class values are interned by document while building DOM, so same
+    // class string has same index and is lowercased and hashed only once
+    lUInt16 class_index = node->getAttributeValueIndex(LXML_NS_ANY, attr_class);
+    lUInt32 key = ((lUInt32) id << 16) | class_index;
+    std::map<lUInt32, ClassMatch>::iterator it = classMatchMap_.find(key);
+    if (it != classMatchMap_.end()) {
+        return it->second;
+    }
+    ClassMatch match;
+    match.selector_class = NULL;
+    if (class_index != LXML_ATTR_VALUE_NONE) {
+        lString16 classname = node->getAttributeValue(attr_class);
+        classname.lowercase();
+        classname = L"." + classname;
+        lString8 classname8 = UnicodeToUtf8(classname);
+        CssSelectorMap::iterator found = selectorMap_.find(classname8.getHash());
+        if (found != selectorMap_.end()) {
+            match.selector_class = found->second;
+        } else {
+            //fallback for map errors
+            match.selector_class = _selectors.length() ? _selectors[0] : NULL;
+        }
+    }
+    LVCssSelector* selector_id = id > 0 && id < _selectors.length() ? _selectors[id] : NULL;
+    match.context_free = isSelectorChainContextFree(match.selector_class)
+            && isSelectorChainContextFree(selector_id);
+    return classMatchMap_[key] = match;
+}
+
 void LVStyleSheet::applyCss(const ldomNode* node, css_style_rec_t* style)
 {
     if (!_selectors.length()) {
@@ -717,46 +770,9 @@ void LVStyleSheet::applyCss(const ldomNode* node, css_style_rec_t* style)
     }
     bool applied = false;
     lUInt16 id = node->getNodeId();
-    lString16 classname;
-    LVCssSelector* selector_class = _selectors[0];
+    LVCssSelector* selector_class = getClassMatch(node).selector_class;
     LVCssSelector* selector_id = id > 0 && id < _selectors.length() ? _selectors[id] : NULL;
 
-    if( node->hasAttribute(attr_class))
-    {
-        classname = node->getAttributeValue(attr_class);
-        classname.lowercase();
-        //lString16 classes = node->getAttributeValue(attr_class);
-        //if(!classes.empty() && classes.pos(" ") != -1)
-        //{
-        //    std::vector<lString16> coll = classes.splitWithStd(' ');
-        //    if (coll.size() > 1)
-        //    {
-        //        applyCssMulticlass(coll, node, style);
-        //        return;
-        //    }
-        //}
-
-        classname = L"." + classname;
-        lString8 classname8 = UnicodeToUtf8(classname);
-        //CRLog::error("looking for %s",classname8.c_str());
-        if(selectorMap_.find(classname8.getHash()) != selectorMap_.end())
-        {
-            selector_class = selectorMap_[classname8.getHash()];
-            //selector_class->setNext(NULL); //leads to map memory corruption due to cutting vector when found element
-            //CRLog::error("%s found: %x",classname8.c_str(),selector_class);
-        }
-        else
-        {
-            //CRLog::error("couldnt find class %s in map",LCSTR(classname));
-            //fallback for map errors
-            selector_class = _selectors[0];
-        }
-    }
-    else
-    {
-        selector_class = NULL;
-    }
-
 #ifdef DEBUG_CSS
     if (id == 0) {
         CRLog::info("LVStyleSheet::applyCss[%s]: node id==0", LCSTR(GetNodeDesc(node)));
@@ -1784,7 +1800,7 @@ void LVStyleSheet::set(LVPtrVector<LVCssSelector>& v)
     }
 }
 
-LVStyleSheet::LVStyleSheet(LVStyleSheet& sheet) : _doc(sheet._doc)
+LVStyleSheet::LVStyleSheet(LVStyleSheet& sheet) : _doc(sheet._doc), generation_(0)
 {
     set(sheet._selectors);
     GenerateClassMap();
@@ -1867,6 +1883,8 @@ lUInt32 LVStyleSheet::getHash()
 void LVStyleSheet::GenerateClassMap()
 {
     selectorMap_.clear();
+    classMatchMap_.clear();
+    generation_++;
     LVCssSelector *sel = _selectors[0];
     while (sel != NULL)
     {
@@ -1611,7 +1611,10 @@ void LFormattedText::Draw( LVDrawBuf * buf, int x, int y, ldomMarkedRangeList *
                 {
                     srcline = &m_pbuffer->srctext[word->src_text_index];
                     ldomNode * node = (ldomNode *) srcline->object;
-                    LVImageSourceRef img = node->getObjectImageSource();
+                    // Vertical mode rotates image while drawing, it isn't cached
+                    LVImageSourceRef img = gJapaneseVerticalMode
+                            ? node->getObjectImageSource()
+                            : node->getCrDom()->getImageSurfaceCache().get( node, word->width, word->o.height );
                     if ( img.isNull() )
                         img = LVCreateDummyImageSource( node, word->width, word->o.height );
                     int xx = x + frmline->x + word->x;
@@ -13,6 +13,9 @@
 
 #include <map>
 #include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <zlib.h>
 #include <eraepub/include/crcss.h>
 #include <erapdf/freetype/include/internal/psaux.h>
@@ -55,6 +58,13 @@
 #define PACK_BUF_SIZE 0x10000
 #define UNPACK_BUF_SIZE 0x40000
 
+#define FAST_PACK_HASH_BITS 12
+#define FAST_PACK_MIN_MATCH 4
+#define FAST_PACK_MAX_OFFSET 0xFFFF
+/// spill file grows by this step, max size is limited by 32-bit chunk offsets
+#define SPILL_FILE_GROW_STEP 0x400000
+#define SPILL_FILE_MAX_SIZE  0x40000000
+
 #define RECT_DATA_CHUNK_ITEMS (1<<RECT_DATA_CHUNK_ITEMS_SHIFT)
 #define RECT_DATA_CHUNK_SIZE (RECT_DATA_CHUNK_ITEMS*sizeof(lvdomElementFormatRec))
 #define RECT_DATA_CHUNK_MASK (RECT_DATA_CHUNK_ITEMS-1)
@@ -522,6 +532,57 @@ void CrDomBase::clearNodeStyle( lUInt32 dataIndex )
     _styleStorage.setStyleData( dataIndex, &info );
 }
 
+lUInt32 ldomStyleShareKey::getHash() const
+{
+    lUInt32 hash = (lUInt32) (size_t) parent;
+    hash = hash * 31 + id;
+    hash = hash * 31 + class_index;
+    hash = hash * 31 + style_index;
+    hash = hash * 31 + (lUInt32) base_font_size;
+    hash = hash * 31 + (lUInt32) embedded_lvl;
+    hash = hash * 31 + sheet_generation;
+    return hash ^ (hash >> 16);
+}
+
+bool ldomStyleShareKey::operator == (const ldomStyleShareKey& v) const
+{
+    return parent == v.parent && id == v.id
+            && class_index == v.class_index && style_index == v.style_index
+            && base_font_size == v.base_font_size && embedded_lvl == v.embedded_lvl
+            && sheet_generation == v.sheet_generation;
+}
+
+css_style_ref_t ldomStyleShareCache::get(const ldomStyleShareKey& key)
+{
+    if (!items_) {
+        return css_style_ref_t();
+    }
+    Item& item = items_[key.getHash() % STYLE_SHARE_CACHE_SIZE];
+    if (item.style.isNull() || !(item.key == key)) {
+        return css_style_ref_t();
+    }
+    return item.style;
+}
+
+void ldomStyleShareCache::put(const ldomStyleShareKey& key, css_style_ref_t parent, css_style_ref_t style)
+{
+    if (!items_) {
+        items_ = new Item[STYLE_SHARE_CACHE_SIZE];
+    }
+    Item& item = items_[key.getHash() % STYLE_SHARE_CACHE_SIZE];
+    item.key = key;
+    item.parent = parent;
+    item.style = style;
+}
+
+void ldomStyleShareCache::clear()
+{
+    if (items_) {
+        delete[] items_;
+        items_ = NULL;
+    }
+}
+
 void CrDomBase::setNodeStyleIndex( lUInt32 dataIndex, lUInt16 index )
 {
     ldomNodeStyleInfo info;
@@ -675,6 +736,10 @@ void CrDomBase::recycleTinyNode( lUInt32 index )
 
 CrDomBase::~CrDomBase()
 {
+    _textStorage.dumpStats();
+    _elemStorage.dumpStats();
+    _rectStorage.dumpStats();
+    _styleStorage.dumpStats();
     // clear all elem parts
     for ( int partindex = 0; partindex<=(_elemCount>>TNC_PART_SHIFT); partindex++ ) {
         ldomNode * part = _elemList[partindex];
@@ -714,6 +779,10 @@ ldomTextStorageChunk * ldomDataStorageManager::getChunk( lUInt32 address )
             _recentChunk->_prevRecent = chunk;
         _recentChunk = chunk;
     }
+    if (!chunk->_buf && chunk->_saved) {
+        swapIn(chunk);
+        compact(0, chunk);
+    }
     return chunk;
 }
 
@@ -887,6 +956,18 @@ ElementDataStorageItem * ldomDataStorageManager::getElem( lUInt32 addr )
     return chunk->getElem(addr&0xFFFF);
 }
 
+ElementDataStorageItem * ldomDataStorageManager::pinElem( lUInt32 addr )
+{
+    ldomTextStorageChunk * chunk = getChunk(addr);
+    chunk->_pinCount++;
+    return chunk->getElem(addr&0xFFFF);
+}
+
+void ldomDataStorageManager::unpinElem( lUInt32 addr )
+{
+    _chunks[addr>>16]->_pinCount--;
+}
+
 /// returns node's parent by address
 lUInt32 ldomDataStorageManager::getParent( lUInt32 addr )
 {
@@ -894,24 +975,348 @@ lUInt32 ldomDataStorageManager::getParent( lUInt32 addr )
     return chunk->getElem(addr&0xFFFF)->parentIndex;
 }
 
-void ldomDataStorageManager::compact(int reservedSpace)
+void ldomDataStorageManager::compact( int reservedSpace, ldomTextStorageChunk * except )
 {
     if (_uncompressedSize + reservedSpace
         > _maxUncompressedSize + _maxUncompressedSize / 10) { // allow +10% overflow
         // do compacting
         int sumsize = reservedSpace;
         for (ldomTextStorageChunk* p = _recentChunk; p; p = p->_nextRecent) {
-            if (p->_bufsize >= 0) {
-                if ((int) p->_bufsize + sumsize < _maxUncompressedSize
-                    || (p == _activeChunk && reservedSpace < 0xFFFFFFF)) {
-                    // fits
-                    sumsize += p->_bufsize;
-                }
+            if (!p->_buf)
+                continue;
+            if ((int) p->_bufsize + sumsize < _maxUncompressedSize
+                || p == _activeChunk || p == except || p->_pinCount > 0) {
+                // fits
+                sumsize += p->_bufsize;
+            } else if (!swapOut(p)) {
+                // can't be unloaded, keep it in memory
+                sumsize += p->_bufsize;
             }
         }
     }
 }
 
+/// Temporary file for unloaded storage chunks, mapped to memory.
+/// File is unlinked right after creation, so it's removed by system when closed.
+class ldomSpillFile
+{
+    int _fd;
+    lUInt8 * _map;
+    lUInt32 _size;
+    lUInt32 _used;
+    ldomSpillFile( int fd ) : _fd(fd), _map(NULL), _size(0), _used(0) { }
+public:
+    static ldomSpillFile * create( const lString8 & dir )
+    {
+        lString8 path = dir;
+        path << "/cr3storage.XXXXXX";
+        int fd = mkstemp(path.modify());
+        if (fd < 0) {
+            CRLog::error("Can't create storage spill file in %s", dir.c_str());
+            return NULL;
+        }
+        unlink(path.c_str());
+        return new ldomSpillFile(fd);
+    }
+    /// allocates space for size bytes, returns false if file can't grow
+    bool reserve( lUInt32 size, lUInt32 & offset )
+    {
+        size = (size + 15) & ~15;
+        if (_used + size > _size) {
+            lUInt32 newSize = (_used + size + SPILL_FILE_GROW_STEP - 1)
+                    / SPILL_FILE_GROW_STEP * SPILL_FILE_GROW_STEP;
+            if (newSize > SPILL_FILE_MAX_SIZE || ftruncate(_fd, newSize) != 0)
+                return false;
+            // old mapping stays valid until new one is created
+            void * map = mmap(NULL, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+            if (map == MAP_FAILED)
+                return false;
+            if (_map)
+                munmap(_map, _size);
+            _map = (lUInt8 *)map;
+            _size = newSize;
+        }
+        offset = _used;
+        _used += size;
+        return true;
+    }
+    lUInt8 * ptr( lUInt32 offset ) { return _map + offset; }
+    lUInt32 size() { return _used; }
+    ~ldomSpillFile()
+    {
+        if (_map)
+            munmap(_map, _size);
+        close(_fd);
+    }
+};
+
+static inline lUInt32 fastPackRead32( const lUInt8 * p )
+{
+    lUInt32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/// writes length extension bytes of sequence token nibble
+static inline int fastPackPutLength( lUInt8 * dst, int pos, int dstsize, int len )
+{
+    for ( ; len >= 255; len -= 255 ) {
+        if (pos >= dstsize)
+            return -1;
+        dst[pos++] = 255;
+    }
+    if (pos >= dstsize)
+        return -1;
+    dst[pos++] = (lUInt8)len;
+    return pos;
+}
+
+/// writes one sequence: token, literals, and match if matchlen is not zero
+static int fastPackPutSequence( lUInt8 * dst, int pos, int dstsize,
+        const lUInt8 * lit, int litlen, int offset, int matchlen )
+{
+    if (pos >= dstsize)
+        return -1;
+    int mlen = matchlen ? matchlen - FAST_PACK_MIN_MATCH : 0;
+    int token = pos++;
+    dst[token] = (lUInt8)(((litlen < 15 ? litlen : 15) << 4) | (mlen < 15 ? mlen : 15));
+    if (litlen >= 15 && (pos = fastPackPutLength(dst, pos, dstsize, litlen - 15)) < 0)
+        return -1;
+    if (pos + litlen > dstsize)
+        return -1;
+    memcpy(dst + pos, lit, litlen);
+    pos += litlen;
+    if (!matchlen)
+        return pos;
+    if (pos + 2 > dstsize)
+        return -1;
+    dst[pos++] = (lUInt8)(offset & 0xFF);
+    dst[pos++] = (lUInt8)(offset >> 8);
+    if (mlen >= 15 && (pos = fastPackPutLength(dst, pos, dstsize, mlen - 15)) < 0)
+        return -1;
+    return pos;
+}
+
+/// LZ4 style packing: sequences of literals followed by match of 4+ bytes with 16-bit offset,
+/// last sequence has literals only. Returns packed size, or 0 if it doesn't fit dstsize.
+static int ldomFastPack( const lUInt8 * src, int srcsize, lUInt8 * dst, int dstsize )
+{
+    lInt32 table[1 << FAST_PACK_HASH_BITS];
+    for ( int i = 0; i < (1 << FAST_PACK_HASH_BITS); i++ )
+        table[i] = -1;
+    int pos = 0;
+    int anchor = 0;
+    int out = 0;
+    while (pos + FAST_PACK_MIN_MATCH < srcsize) {
+        lUInt32 seq = fastPackRead32(src + pos);
+        lUInt32 h = (seq * 2654435761U) >> (32 - FAST_PACK_HASH_BITS);
+        int ref = table[h];
+        table[h] = pos;
+        if (ref < 0 || pos - ref > FAST_PACK_MAX_OFFSET || fastPackRead32(src + ref) != seq) {
+            pos++;
+            continue;
+        }
+        int len = FAST_PACK_MIN_MATCH;
+        while (pos + len < srcsize && src[ref + len] == src[pos + len])
+            len++;
+        out = fastPackPutSequence(dst, out, dstsize, src + anchor, pos - anchor, pos - ref, len);
+        if (out < 0)
+            return 0;
+        pos += len;
+        anchor = pos;
+    }
+    out = fastPackPutSequence(dst, out, dstsize, src + anchor, srcsize - anchor, 0, 0);
+    return out < 0 ? 0 : out;
+}
+
+/// reads length extension bytes of sequence token nibble
+static inline bool fastUnpackGetLength( const lUInt8 * & p, const lUInt8 * end, int & len )
+{
+    lUInt8 b;
+    do {
+        if (p >= end)
+            return false;
+        b = *p++;
+        len += b;
+    } while (b == 255);
+    return true;
+}
+
+/// unpacks data packed by ldomFastPack, unpacked size should be exactly dstsize
+static bool ldomFastUnpack( const lUInt8 * src, int srcsize, lUInt8 * dst, int dstsize )
+{
+    const lUInt8 * p = src;
+    const lUInt8 * end = src + srcsize;
+    int out = 0;
+    while (p < end) {
+        int token = *p++;
+        int litlen = token >> 4;
+        if (litlen == 15 && !fastUnpackGetLength(p, end, litlen))
+            return false;
+        if (litlen > end - p || litlen > dstsize - out)
+            return false;
+        memcpy(dst + out, p, litlen);
+        p += litlen;
+        out += litlen;
+        if (p == end)
+            break; // last sequence
+        if (end - p < 2)
+            return false;
+        int offset = p[0] | (p[1] << 8);
+        p += 2;
+        int matchlen = token & 15;
+        if (matchlen == 15 && !fastUnpackGetLength(p, end, matchlen))
+            return false;
+        matchlen += FAST_PACK_MIN_MATCH;
+        if (offset == 0 || offset > out || matchlen > dstsize - out)
+            return false;
+        // source and destination may overlap, copy forward byte by byte
+        const lUInt8 * ref = dst + out - offset;
+        for ( int i = 0; i < matchlen; i++ )
+            dst[out + i] = ref[i];
+        out += matchlen;
+    }
+    return out == dstsize;
+}
+
+/// packs storage chunk data with specified codec, returns false if data can't be packed smaller
+static bool ldomChunkPack( int codec, const lUInt8 * buf, int bufsize, lUInt8 * &dstbuf, lUInt32 & dstsize )
+{
+    if (bufsize <= 0)
+        return false;
+    if (codec == STORAGE_CODEC_FAST) {
+        int capacity = bufsize - bufsize / 16; // not worth unpacking if saved less
+        lUInt8 * tmp = (lUInt8 *)malloc(capacity);
+        int size = ldomFastPack(buf, bufsize, tmp, capacity);
+        if (!size) {
+            free(tmp);
+            return false;
+        }
+        dstbuf = (lUInt8 *)realloc(tmp, size);
+        dstsize = size;
+        return true;
+    }
+    if (codec == STORAGE_CODEC_ZLIB) {
+        uLongf size = compressBound(bufsize);
+        lUInt8 * tmp = (lUInt8 *)malloc(size);
+        if (compress2(tmp, &size, buf, bufsize, DOC_DATA_COMPRESSION_LEVEL) != Z_OK
+            || (int)size >= bufsize - bufsize / 16) {
+            free(tmp);
+            return false;
+        }
+        dstbuf = (lUInt8 *)realloc(tmp, size);
+        dstsize = (lUInt32)size;
+        return true;
+    }
+    return false;
+}
+
+/// unpacks storage chunk data, unpacked size should be exactly dstsize
+static bool ldomChunkUnpack( int codec, const lUInt8 * src, lUInt32 srcsize, lUInt8 * dst, lUInt32 dstsize )
+{
+    switch (codec) {
+    case STORAGE_CODEC_NONE:
+        if (srcsize != dstsize)
+            return false;
+        memcpy(dst, src, dstsize);
+        return true;
+    case STORAGE_CODEC_FAST:
+        return ldomFastUnpack(src, srcsize, dst, dstsize);
+    case STORAGE_CODEC_ZLIB: {
+        uLongf size = dstsize;
+        return uncompress(dst, &size, src, srcsize) == Z_OK && size == dstsize;
+    }
+    default:
+        return false;
+    }
+}
+
+bool ldomDataStorageManager::swapOut( ldomTextStorageChunk * chunk )
+{
+    if (!chunk->_buf || chunk->_saved || chunk == _activeChunk)
+        return false;
+    if (!_spill && !_spillFailed && !_spillDir.empty()) {
+        _spill = ldomSpillFile::create(_spillDir);
+        _spillFailed = !_spill;
+    }
+    lUInt8 * packed = NULL;
+    lUInt32 packedSize = 0;
+    lUInt8 codec = STORAGE_CODEC_NONE;
+    if (ldomChunkPack(_codec, chunk->_buf, chunk->_bufpos, packed, packedSize)) {
+        codec = (lUInt8)_codec;
+    } else if (!_spill) {
+        // raw copy in memory doesn't free anything
+        return false;
+    } else {
+        packedSize = chunk->_bufpos;
+    }
+    if (_spill) {
+        // packed size of modified chunk may grow, reuse its space in file if it fits
+        if (packedSize > chunk->_spillCapacity) {
+            lUInt32 offset;
+            if (!_spill->reserve(packedSize, offset)) {
+                free(packed);
+                return false;
+            }
+            chunk->_spillOffset = offset;
+            chunk->_spillCapacity = packedSize;
+        }
+        memcpy(_spill->ptr(chunk->_spillOffset), packed ? packed : chunk->_buf, packedSize);
+        free(packed);
+        _stats.spilledBytes += packedSize;
+    } else {
+        chunk->_compbuf = packed;
+    }
+    chunk->_compsize = packedSize;
+    chunk->_codec = codec;
+    chunk->_saved = true;
+    _stats.packCount++;
+    _stats.packedBytes += chunk->_bufpos;
+    _stats.packedResult += packedSize;
+    _uncompressedSize -= chunk->_bufsize;
+    free(chunk->_buf);
+    chunk->_buf = NULL;
+    return true;
+}
+
+bool ldomDataStorageManager::swapIn( ldomTextStorageChunk * chunk )
+{
+    if (chunk->_buf || !chunk->_saved)
+        return false;
+    const lUInt8 * packed = _spill ? _spill->ptr(chunk->_spillOffset) : chunk->_compbuf;
+    lUInt8 * buf = (lUInt8 *)malloc(chunk->_bufsize);
+    if (!ldomChunkUnpack(chunk->_codec, packed, chunk->_compsize, buf, chunk->_bufpos)) {
+        CRLog::error("Can't unpack storage chunk %c%d", _type, chunk->_index);
+        crFatalError(1003, "Unexpected error while unpacking of storage chunk");
+    }
+    memset(buf + chunk->_bufpos, 0, chunk->_bufsize - chunk->_bufpos);
+    chunk->_buf = buf;
+    chunk->_saved = false;
+    if (chunk->_compbuf) {
+        free(chunk->_compbuf);
+        chunk->_compbuf = NULL;
+    }
+    _uncompressedSize += chunk->_bufsize;
+    _stats.unpackCount++;
+    _stats.unpackedBytes += chunk->_bufpos;
+    return true;
+}
+
+void ldomDataStorageManager::dumpStats()
+{
+    if (!_stats.packCount)
+        return;
+    CRLog::debug("Storage %c: %d chunks, %d unloaded (%d kB packed to %d kB), "
+                 "%d loaded back (%d kB), %d kB spilled",
+            _type, _chunks.length(), _stats.packCount,
+            (int)(_stats.packedBytes / 1024), (int)(_stats.packedResult / 1024),
+            _stats.unpackCount, (int)(_stats.unpackedBytes / 1024),
+            (int)(_stats.spilledBytes / 1024));
+}
+
+int ldomDataStorageManager::_defaultCodec = STORAGE_CODEC_FAST;
+lString8 ldomDataStorageManager::_spillDir;
+
 ldomDataStorageManager::ldomDataStorageManager(
         CrDomBase* owner, char type, int maxUnpackedSize, int chunkSize)
         : _owner(owner),
@@ -920,11 +1325,19 @@ ldomDataStorageManager::ldomDataStorageManager(
           _uncompressedSize(0),
           _maxUncompressedSize(maxUnpackedSize),
           _chunkSize(chunkSize),
-          _type(type)
+          _type(type),
+          _codec(_defaultCodec),
+          _spill(NULL),
+          _spillFailed(false)
 {
+    memset(&_stats, 0, sizeof(_stats));
 }
 
-ldomDataStorageManager::~ldomDataStorageManager() { }
+ldomDataStorageManager::~ldomDataStorageManager()
+{
+    _chunks.clear();
+    delete _spill;
+}
 
 ldomTextStorageChunk::ldomTextStorageChunk(
         int preAllocSize,
@@ -942,6 +1355,13 @@ ldomTextStorageChunk::ldomTextStorageChunk(
         /// ? index of chunk in storage
 	, _index(index)
 	, _type( manager->_type )
+	, _compbuf(NULL)
+	, _compsize(0)
+	, _spillOffset(0)
+	, _spillCapacity(0)
+	, _codec(STORAGE_CODEC_NONE)
+	, _saved(false)
+	, _pinCount(0)
 {
     _buf = (lUInt8*)malloc(preAllocSize);
     memset(_buf, 0, preAllocSize);
@@ -957,12 +1377,21 @@ ldomTextStorageChunk::ldomTextStorageChunk(ldomDataStorageManager * manager, lUI
 	, _bufpos(0)     /// _buf (uncompressed) data write position (for appending of new data)
 	, _index(index)      /// ? index of chunk in storage
 	, _type( manager->_type )
+	, _compbuf(NULL)
+	, _compsize(0)
+	, _spillOffset(0)
+	, _spillCapacity(0)
+	, _codec(STORAGE_CODEC_NONE)
+	, _saved(false)
+	, _pinCount(0)
 {
 }
 
 ldomTextStorageChunk::~ldomTextStorageChunk()
 {
     setunpacked(NULL, 0);
+    if (_compbuf)
+        free(_compbuf);
 }
 
 /// get raw data bytes
@@ -1402,6 +1831,9 @@ CrDom::CrDom()
 , _page_height(0)
 , _page_width(0)
 , _rendered(false)
+, _render_prefix_blocks(0)
+, _render_prefix_node(NULL)
+, _render_estimated_pages(0)
 , lists(100)
 , cfg_txt_indent(1)
 , cfg_txt_margin(0)
@@ -1677,6 +2109,7 @@ bool CrDom::setRenderProps(int width, int height, font_ref_t def_font, int inter
 
 void CrDomBase::dropStyles()
 {
+    _styleShareCache.clear();
     _styles.clear(-1);
     _fonts.clear(-1);
     resetNodeNumberingProps();
@@ -1892,8 +2325,26 @@ int CrDom::render(LVRendPageList* pages,
         LVRendPageContext context(pages, _page_height);
         int numFinalBlocks = calcFinalBlocks();
         CRLog::trace("Final block count: %d", numFinalBlocks);
+        LVArray<ldomNode*> hidden;
+        int prefixBlocks = 0;
+        if (_render_prefix_blocks > 0 && numFinalBlocks > _render_prefix_blocks) {
+            prefixBlocks = hideFragmentsAfter(_render_prefix_blocks, _render_prefix_node, hidden);
+        }
         //updateStyles();
         int height = renderBlockElement( context, getRootNode(), 0, y0, width ) + y0;
+        if (hidden.length() > 0) {
+            // Partial layout is neither kept as rendered nor cached
+            for (int i = 0; i < hidden.length(); i++) {
+                hidden[i]->setRendMethod(erm_block);
+            }
+            context.Finalize();
+            _render_estimated_pages = prefixBlocks > 0
+                    ? (int) ((lInt64) pages->length() * numFinalBlocks / prefixBlocks)
+                    : pages->length();
+            CRLog::info("CrDom::render prefix %d of %d final blocks, %d pages, ~%d estimated",
+                    prefixBlocks, numFinalBlocks, pages->length(), _render_estimated_pages);
+            return height;
+        }
         _rendered = true;
         gc();
         //CRLog::trace("finalizing... fonts.length=%d", _fonts.length());
@@ -1913,6 +2364,77 @@ int CrDom::render(LVRendPageList* pages,
     }
 }
 
+static int countFinalBlocks(ldomNode * node)
+{
+    if (!node->isElement()) {
+        return 0;
+    }
+    int rm = node->getRendMethod();
+    if (rm == erm_final) {
+        return 1;
+    }
+    if (rm == erm_invisible) {
+        return 0;
+    }
+    int cnt = 0;
+    for (int i = 0; i < node->getChildCount(); i++) {
+        cnt += countFinalBlocks(node->getChildNode(i));
+    }
+    return cnt;
+}
+
+/// Hides body DocFragments following the first ones with max_blocks final blocks
+/// and the one holding keep node, returns count of final blocks left visible
+int CrDom::hideFragmentsAfter(int max_blocks, ldomNode * keep, LVArray<ldomNode*> & hidden)
+{
+    ldomNode * root = getRootNode();
+    ldomNode * body = NULL;
+    for (int i = 0; i < root->getChildCount(); i++) {
+        ldomNode * child = root->getChildNode(i);
+        if (child->isElement() && child->getNodeId() == el_body) {
+            body = child;
+            break;
+        }
+    }
+    if (body == NULL) {
+        return 0;
+    }
+    // Fragments are not hidden before the one holding saved reading position
+    while (keep != NULL && keep->getParentNode() != body) {
+        keep = keep->getParentNode();
+    }
+    int blocks = 0;
+    for (int i = 0; i < body->getChildCount(); i++) {
+        ldomNode * child = body->getChildNode(i);
+        if (!child->isElement() || child->getNodeId() != el_DocFragment) {
+            continue;
+        }
+        // Only plain block fragments are hidden, so restoring them is exact
+        if (blocks >= max_blocks && keep == NULL && child->getRendMethod() == erm_block) {
+            child->setRendMethod(erm_invisible);
+            hidden.add(child);
+        } else {
+            blocks += countFinalBlocks(child);
+            if (child == keep) {
+                keep = NULL;
+            }
+        }
+    }
+    return blocks;
+}
+
+int CrDom::renderPrefix(LVRendPageList* pages, int width, int dy, bool showCover, int y0,
+        font_ref_t def_font, int interline_space, int max_blocks, ldomNode * keep)
+{
+    _render_prefix_blocks = max_blocks;
+    _render_prefix_node = keep;
+    _render_estimated_pages = 0;
+    render(pages, width, dy, showCover, y0, def_font, interline_space);
+    _render_prefix_blocks = 0;
+    _render_prefix_node = NULL;
+    return _render_estimated_pages;
+}
+
 void CrDomXml::setNodeTypes( const elem_def_t * node_scheme )
 {
     if (!node_scheme)
@@ -2673,6 +3195,20 @@ ldomElementWriter * LvDomWriter::pop( ldomElementWriter * obj, lUInt16 id )
     return tmp2;
 }
 
+void LvDomWriter::initOpenElements()
+{
+    if (!doc_->isDefStyleSet()) {
+        return;
+    }
+    // Innermost first, render method of element depends on its children
+    for (ldomElementWriter * tmp = _currNode; tmp; tmp = tmp->_parent) {
+        if (!tmp->_bodyEnterCalled) {
+            tmp->onBodyEnter();
+        }
+        tmp->getElement()->initNodeRendMethod();
+    }
+}
+
 ldomElementWriter::~ldomElementWriter()
 {
     //CRLog::trace("~ldomElementWriter for element 0x%04x %s",
@@ -3792,8 +4328,6 @@ ldomXPointer CrDom::createXPointer( ldomNode * baseNode, const lString16 & xPoin
     int index = -1;
     ldomNode * currNode = baseNode;
     lString16 name;
-    lString8 ptr8 = UnicodeToUtf8(xPointerStr);
-    //const char * ptr = ptr8.c_str();
     xpath_step_t step_type;
 
     while ( *str ) {
@@ -7599,9 +8133,11 @@ void ldomNode::destroy()
         break;
     case NT_PELEMENT:   // immutable (persistent) element node
         {
-            ElementDataStorageItem * me = getCrDom()->_elemStorage.getElem( _data._pelem_addr );
+            // Children load other chunks, which must not unload this one
+            ElementDataStorageItem * me = getCrDom()->_elemStorage.pinElem( _data._pelem_addr );
             for ( int i=0; i<me->childCount; i++ )
                 getCrDom()->getTinyNode( me->children[i] )->destroy();
+            getCrDom()->_elemStorage.unpinElem( _data._pelem_addr );
             getCrDom()->clearNodeStyle( _handle._dataIndex );
 //            getCrDom()->_styles.release( _data._pelem._styleIndex );
 //            getCrDom()->_fonts.release( _data._pelem._fontIndex );
@@ -7949,24 +8485,27 @@ bool ldomNode::isRTL()
 
 /// returns attribute value by attribute name id and namespace id
 const lString16 & ldomNode::getAttributeValue( lUInt16 nsid, lUInt16 id ) const
+{
+    lUInt16 valueId = getAttributeValueIndex( nsid, id );
+    if ( valueId==LXML_ATTR_VALUE_NONE )
+        return lString16::empty_str;
+    return getCrDom()->getAttrValue(valueId);
+}
+
+/// returns interned attribute value index, LXML_ATTR_VALUE_NONE if there is no such attribute
+lUInt16 ldomNode::getAttributeValueIndex( lUInt16 nsid, lUInt16 id ) const
 {
     ASSERT_NODE_NOT_NULL;
     if ( !isElement() )
-        return lString16::empty_str;
+        return LXML_ATTR_VALUE_NONE;
     if ( !isPersistent() ) {
         // element
         tinyElement * me = _data._elem_ptr;
-        lUInt16 valueId = me->_attrs.get( nsid, id );
-        if ( valueId==LXML_ATTR_VALUE_NONE )
-            return lString16::empty_str;
-        return getCrDom()->getAttrValue(valueId);
+        return me->_attrs.get( nsid, id );
     } else {
         // persistent element
         ElementDataStorageItem * me = getCrDom()->_elemStorage.getElem( _data._pelem_addr );
-        lUInt16 valueId = me->getAttrValueId( nsid, id );
-        if ( valueId==LXML_ATTR_VALUE_NONE )
-            return lString16::empty_str;
-        return getCrDom()->getAttrValue(valueId);
+        return me->getAttrValueId( nsid, id );
     }
 }
 
@@ -44,6 +44,8 @@ typedef unsigned int ucs4_t;
 #define BUF_SIZE_INCREMENT 4096
 #define MIN_BUF_DATA_SIZE 4096
 #define CP_AUTODETECT_BUF_SIZE 0x20000
+// Read first, byte order mark found there makes reading the rest of buffer needless
+#define CP_AUTODETECT_PROBE_SIZE 0x1000
 
 int CalcTabCount(const lChar16 * str, int nlen);
 void ExpandTabs(lString16 & s);
@@ -336,9 +338,16 @@ int LVTextFileBase::ReadChars( lChar16 * buf, int maxsize )
     case ce_8bit_cp:
     case ce_utf8:
         if ( m_conv_table!=NULL ) {
-            for ( ; count<maxsize && m_buf_pos<m_buf_len; count++ ) {
+            while ( count<maxsize && m_buf_pos<m_buf_len ) {
+                int left = m_buf_len - m_buf_pos;
+                int ascii = lStr_decodeAscii(m_buf + m_buf_pos, left < maxsize - count ? left : maxsize - count,
+                                             buf + count);
+                count += ascii;
+                m_buf_pos += ascii;
+                if ( count>=maxsize || m_buf_pos>=m_buf_len )
+                    break;
                 lUInt16 ch = m_buf[m_buf_pos++];
-                buf[count] = ( (ch & 0x80) == 0 ) ? ch : m_conv_table[ch&0x7F];
+                buf[count++] = ( (ch & 0x80) == 0 ) ? ch : m_conv_table[ch&0x7F];
             }
             return count;
         } else  {
@@ -743,8 +752,13 @@ bool LVTextFileBase::AutodetectEncoding( bool utfOnly )
         //return false;
     }
     unsigned char * buf = new unsigned char[ sz ];
+    unsigned probe = sz < CP_AUTODETECT_PROBE_SIZE ? sz : CP_AUTODETECT_PROBE_SIZE;
     lvsize_t bytesRead = 0;
-    if (m_stream->Read(buf, sz, &bytesRead) != LVERR_OK)
+    bool ok = m_stream->Read(buf, probe, &bytesRead) == LVERR_OK;
+    int res = ok ? AutodetectCodePageBom(buf, probe, enc_name, lang_name) : 0;
+    if ( ok && !res && sz > probe )
+        ok = m_stream->Read(buf + probe, sz - probe, &bytesRead) == LVERR_OK;
+    if ( !ok )
     {
         CRLog::error("LVTextFileBase::AutodetectEncoding failed to read");
         delete[] buf;
@@ -752,12 +766,12 @@ bool LVTextFileBase::AutodetectEncoding( bool utfOnly )
         return false;
     }
 
-    int res = 0;
-    bool hasTags = hasXmlTags(buf, sz);
-    if ( utfOnly )
-        res = AutodetectCodePageUtf(buf, sz, enc_name, lang_name);
-    else
-        res = AutodetectCodePage(buf, sz, enc_name, lang_name, hasTags);
+    if ( !res ) {
+        if ( utfOnly )
+            res = AutodetectCodePageUtf(buf, sz, enc_name, lang_name);
+        else
+            res = AutodetectCodePage(buf, sz, enc_name, lang_name, hasXmlTags(buf, sz));
+    }
     delete[] buf;
     m_stream->SetPos( oldpos );
     if ( res) {
@@ -1178,6 +1192,12 @@ private:
     int max_left_second_stats_pos;
     int max_right_stats_pos;
     bool firstpage_thumb_;
+    int block_limit_;
+    bool stopped_;
+    // State of import stopped at block limit
+    int resume_pos_;
+    int short_line_count_;
+    int empty_line_count_;
     enum {
         tftParaPerLine = 1,
         tftParaIdents = 2,
@@ -1207,12 +1227,36 @@ public:
         para_count_ = 0;
         linesToSkip = 0;
         smart_format_flags_ = tftPreFormatted;
+        block_limit_ = 0;
+        stopped_ = false;
+        resume_pos_ = 0;
+        short_line_count_ = 0;
+        empty_line_count_ = 0;
     }
 
     void reinit()
     {
         clear();
         smart_format_flags_ = tftParaPerLine | tftHeadersEmptyLineDelim; //default for txtSmartFormat()
+        stopped_ = false;
+        resume_pos_ = 0;
+        short_line_count_ = 0;
+        empty_line_count_ = 0;
+    }
+
+    /// makes DoTextImport() stop after given count of blocks, 0 for no limit;
+    /// next DoTextImport() call goes on from where it stopped
+    void SetBlockLimit(int block_limit) { block_limit_ = block_limit; }
+    bool IsStopped() { return stopped_; }
+    // Saves queue position to resume import from, once block limit is reached
+    bool StopAt(int pos)
+    {
+        if (block_limit_ <= 0 || blocks_count_ < block_limit_) {
+            return false;
+        }
+        resume_pos_ = pos;
+        stopped_ = true;
+        return true;
     }
 
     // get index of first line of queue
@@ -2152,7 +2196,7 @@ public:
     bool DoParaPerLineImport(LvXMLParserCallback* callback) {
         CRLog::debug("DoParaPerLineImport()");
         bool done = false;
-        int remaining_lines = 0;
+        int remaining_lines = resume_pos_;
         do {
             for (int i = remaining_lines; i < length(); i++) {
                 LVTextFileLine* item = get(i);
@@ -2173,6 +2217,9 @@ public:
                     done = true;
                     break;
                 }
+                if (StopAt(i + 1)) {
+                    return true;
+                }
             }
             if (done) {
                 break;
@@ -2189,7 +2236,7 @@ public:
     bool DoPreFormattedImport(LvXMLParserCallback* callback) {
         CRLog::debug("DoPreFormattedImport()");
         bool done = false;
-        int remaining_lines = 0;
+        int remaining_lines = resume_pos_;
         do {
             for (int i = remaining_lines; i < length(); i++) {
                 LVTextFileLine* item = get(i);
@@ -2210,6 +2257,9 @@ public:
                     done = true;
                     break;
                 }
+                if (StopAt(i + 1)) {
+                    return true;
+                }
             }
             if (done) {
                 break;
@@ -2225,7 +2275,7 @@ public:
     /// delimited by first line ident
     bool DoParaPerIdentImport(LvXMLParserCallback* callback) {
         CRLog::debug("DoParaPerIdentImport()");
-        int pos = 0;
+        int pos = resume_pos_;
         for (;;) {
             if (length() - pos <= MAX_PARA_LINES) {
                 if (pos) {
@@ -2264,6 +2314,9 @@ public:
             if (firstpage_thumb_ && blocks_count_ >= FIRSTPAGE_BLOCKS_MAX) {
                 break;
             }
+            if (StopAt(pos)) {
+                return true;
+            }
         }
         if (inSubSection) {
             callback->OnTagClose(NULL, L"section");
@@ -2273,9 +2326,9 @@ public:
     /// delimited by empty lines
     bool DoParaPerEmptyLinesImport(LvXMLParserCallback* callback) {
         CRLog::debug("DoParaPerEmptyLinesImport()");
-        int pos = 0;   //position of a string in a paragraph
-        int shortLineCount = 0;
-        int emptyLineCount = 0;
+        int pos = resume_pos_;   //position of a string in a paragraph
+        int shortLineCount = short_line_count_;
+        int emptyLineCount = empty_line_count_;
         for (;;) {
             if (length() - pos <= MAX_PARA_LINES) {
                 if (pos) {
@@ -2332,14 +2385,20 @@ public:
             if (firstpage_thumb_ && blocks_count_ >= FIRSTPAGE_BLOCKS_MAX) {
                 break;
             }
+            if (StopAt(pos)) {
+                short_line_count_ = shortLineCount;
+                empty_line_count_ = emptyLineCount;
+                return true;
+            }
         }
         if (inSubSection) {
             callback->OnTagClose(NULL, L"section");
         }
         return true;
     }
-    /// import document body
+    /// import document body, PML is always imported at once
     bool DoTextImport(LvXMLParserCallback* callback) {
+        stopped_ = false;
         if (smart_format_flags_ & tftPML) {
             CRLog::trace("tftPML");
             return DoPMLImport(callback);
@@ -2376,6 +2435,22 @@ lString16 LVTextFileBase::ReadLine(int maxLineSize, lUInt32& flags) {
             flags |= LINE_HAS_EOLN; // EOLN flag
             break;
         }
+        // copy run of printable chars at once, only controls, spaces and eolns
+        // need the checks below
+        if (m_read_buffer_pos < m_read_buffer_len)
+        {
+            const lChar16* start = m_read_buffer + m_read_buffer_pos;
+            const lChar16* end = m_read_buffer + m_read_buffer_len;
+            const lChar16* p = start;
+            while (p < end && *p > 32)
+                p++;
+            if (p > start)
+            {
+                res.append(start, (int)(p - start));
+                m_read_buffer_pos += (int)(p - start);
+                continue;
+            }
+        }
         ch = ReadCharFromBuffer();
         /*ch== L'\u00B1' ||*/
         //lString16 temp;
@@ -2486,9 +2561,14 @@ LVTextParser::LVTextParser(LVStreamRef stream, LvXMLParserCallback* callback, bo
         : LVTextFileBase(stream),
           m_callback(callback),
           smart_format_(smart_format),
-          firstpage_thumb_(firstpage_thumb) {}
+          firstpage_thumb_(firstpage_thumb),
+          block_limit_(0),
+          queue_(NULL) {}
 
-LVTextParser::~LVTextParser() {}
+LVTextParser::~LVTextParser()
+{
+    delete queue_;
+}
 
 /// returns true if format is recognized by parser
 bool LVTextParser::CheckFormat()
@@ -2509,10 +2589,13 @@ bool LVTextParser::CheckFormat()
 
 /// parses input stream
 bool LVTextParser::Parse() {
-    LVTextLineQueue queue(this, firstpage_thumb_, 2000);
-    queue.ReadLines(2000);
+    delete queue_;
+    queue_ = NULL;
+    LVTextLineQueue* queue = new LVTextLineQueue(this, firstpage_thumb_, 2000);
+    queue->SetBlockLimit(block_limit_);
+    queue->ReadLines(2000);
     if (smart_format_) {
-        queue.TxtSmartFormat();
+        queue->TxtSmartFormat();
     }
     // make fb2 document structure
     m_callback->OnTagOpen( NULL, L"?xml" );
@@ -2525,24 +2608,52 @@ bool LVTextParser::Parse() {
       // DESCRIPTION
       m_callback->OnTagOpenNoAttr( NULL, L"description" );
         m_callback->OnTagOpenNoAttr( NULL, L"title-info" );
-          queue.TxtSmartDescription( m_callback );
+          queue->TxtSmartDescription( m_callback );
         m_callback->OnTagClose( NULL, L"title-info" );
       m_callback->OnTagClose( NULL, L"description" );
       // BODY
       m_callback->OnTagOpenNoAttr( NULL, L"body" );
         //callback_->OnTagOpen( NULL, L"section" );
-        bool res = queue.DoTextImport(m_callback);
+        bool res = queue->DoTextImport(m_callback);
         if(!res)
         {
             //fallback
             Reset();
-            queue.reinit();
-            queue.ReadLines(2000);
-            queue.DoTextImport(m_callback);
+            queue->reinit();
+            queue->ReadLines(2000);
+            queue->DoTextImport(m_callback);
+        }
+        if (queue->IsStopped())
+        {
+            // body is left open for ParseRest()
+            queue_ = queue;
+            return true;
         }
-        //callback_->OnTagClose( NULL, L"section" );
-      m_callback->OnTagClose( NULL, L"body" );
+        delete queue;
+        closeDocument();
+    return true;
+}
+
+void LVTextParser::closeDocument()
+{
+    //callback_->OnTagClose( NULL, L"section" );
+    m_callback->OnTagClose( NULL, L"body" );
     m_callback->OnTagClose( NULL, L"FictionBook" );
+}
+
+bool LVTextParser::ParseRest()
+{
+    if (queue_ == NULL)
+    {
+        return false;
+    }
+    // Stream may have been read by others since Parse()
+    m_stream->SetPos(m_buf_fpos + m_buf_len);
+    queue_->SetBlockLimit(0);
+    queue_->DoTextImport(m_callback);
+    delete queue_;
+    queue_ = NULL;
+    closeDocument();
     return true;
 }
 
@@ -2643,7 +2754,7 @@ void LvXmlParser::FullDom()
 bool LvXmlParser::Parse()
 {
 	Reset();
-	EpubStylesManager stylesManager = getStylesManager();
+	EpubStylesManager & stylesManager = getStylesManager();
     callback_->OnStart(this);
     //int txt_count = 0;
     int flags = callback_->getFlags();
@@ -2996,7 +3107,7 @@ bool LvXmlParser::Parse()
                             int bufnum = -1;
                             if(buffer == L"*")
                             {
-                                bufnum = LinksList_.size() + 1;
+                                bufnum = context_->linksList.size() + 1;
                             }
                             else
                             {
@@ -3010,7 +3121,7 @@ bool LvXmlParser::Parse()
                                 lString16 tmp_search;
                                 if(link_id.empty())
                                 {
-                                    lString16 temp = lString16("back_") + lString16::itoa(LinksList_.length());
+                                    lString16 temp = lString16("back_") + lString16::itoa(context_->linksList.length());
                                     callback_->OnAttribute(L"", L"id", temp.c_str());
                                     link_id = lString16("#") + callback_->convertId(temp);
                                     tmp_search = /*L"#" +*/ link_id;
@@ -3024,7 +3135,7 @@ bool LvXmlParser::Parse()
 
                                 lString16 tmp_href = callback_->convertHref(link_href);
                                 //LE("tmp_href = [%s]",LCSTR(tmp_href));
-                                if (LinksMap_.find(tmp_search.getHash()) == LinksMap_.end())
+                                if (context_->linksMap.find(tmp_search.getHash()) == context_->linksMap.end())
                                 {
                                     callback_->OnAttribute(L"", L"nref", (link_href + lString16("_note")).c_str());
                                     callback_->OnAttribute(L"", L"type", L"note");
@@ -3032,9 +3143,9 @@ bool LvXmlParser::Parse()
                                     {
                                         callback_->OnAttribute(L"", L"class", L"note_class");
                                     }
-                                    LinksList_.add(LinkStruct(bufnum, link_id, tmp_href));
+                                    context_->linksList.add(LinkStruct(bufnum, link_id, tmp_href));
                                 }
-                                LinksMap_[tmp_href.getHash()] = link_id;
+                                context_->linksMap[tmp_href.getHash()] = link_id;
                                 //CRLog::error("LIST added [%s] to [%s]",LCSTR(link_id),LCSTR(link_href));
                                 buffer = lString16::empty_str;
 
@@ -3112,10 +3223,10 @@ bool LvXmlParser::Parse()
                         //in_note_section = true
 
                         callback_->OnTagOpenNoAttr(L"",L"title");
-                        if(LinksMap_.find(callback_->convertId(lString16("#") + section_id).getHash())!=LinksMap_.end())
+                        if(context_->linksMap.find(callback_->convertId(lString16("#") + section_id).getHash())!=context_->linksMap.end())
                         {
                             callback_->OnTagOpen(L"",L"a");
-                            lString16 href = LinksMap_.at(callback_->convertId(lString16("#") + section_id).getHash());
+                            lString16 href = context_->linksMap.at(callback_->convertId(lString16("#") + section_id).getHash());
                             callback_->OnAttribute(L"",L"href",href.c_str());
                             callback_->OnAttribute(L"",L"class",L"link_valid");
                         }
@@ -3385,7 +3496,7 @@ bool LvXmlParser::Parse()
                     {
                         //CRLog::error("attrval = %d",("#" + callback_->convertId(attrvalue)).getHash());
                         lString16 hrf = "#" + callback_->convertId(attrvalue);
-                        Epub3Notes_.AddAside(hrf);
+                        context_->epub3Notes.AddAside(hrf);
                         //aside_old_id = attrvalue;
                     }
                 }
@@ -3394,7 +3505,7 @@ bool LvXmlParser::Parse()
                     if(attrname == "id")
                     {
                         lString16 hrf = "#" + callback_->convertId(attrvalue);
-                        Epub3Notes_.AddAside(hrf);
+                        context_->epub3Notes.AddAside(hrf);
                     }
                 }
 
@@ -3472,7 +3583,7 @@ bool LvXmlParser::Parse()
 //                }
             if(save_notes_title)
             {
-                this->ReadTextToString(Epub3Notes_.FootnotesTitle_,true);
+                this->ReadTextToString(context_->epub3Notes.FootnotesTitle_,true);
             }
             else if(save_a_content)
             {
@@ -3481,9 +3592,9 @@ bool LvXmlParser::Parse()
             }
             else if( in_head && in_style)
             {
+                // Head styles used to go to parser's own copy of manager, which nothing read
                 lString16 cssBufffer;
                 this->ReadTextToString(cssBufffer,true);
-                EpubStylesManager_.parseString(cssBufffer);
                 cssBufffer.clear();
             }
             else
@@ -3853,7 +3964,7 @@ bool LvXmlParser::ParseDocx(DocxItems docxItems, DocxLinks docxLinks, DocxStyles
     headermap[docxStyles.h5id_.getHash()] = 5;
     headermap[docxStyles.h6id_.getHash()] = 6;
 
-    LinksMap LinksMap = LinksMap_;
+    LinksMap LinksMap = context_->linksMap;
     for (; !eof_ && !error && !firstpage_thumb_num_reached ;)
     {
         if (m_stopped)
@@ -4546,8 +4657,8 @@ bool LvXmlParser::ParseDocx(DocxItems docxItems, DocxLinks docxLinks, DocxStyles
                     lString16 mark = "[" + attrvalue + "]";
                     callback_->OnText(mark.c_str(), mark.length(),0);
                     attrname= "href";
-                    LinksList_.add(LinkStruct(attrvalue.atoi(),id,href));
-                    LinksMap_[href.getHash()] = id;
+                    context_->linksList.add(LinkStruct(attrvalue.atoi(),id,href));
+                    context_->linksMap[href.getHash()] = id;
                     //CRLog::error("linksmap add = %s %s", LCSTR(href),LCSTR(id));
                     attrvalue = href;
                     in_footnoteref = false;
@@ -5045,7 +5156,7 @@ bool LvXmlParser::ParseOdt(/*DocxItems docxItems, DocxLinks docxLinks, */OdtStyl
 
     int hlevel = 0;
     int hlevel_backup = 0;
-    LinksMap LinksMap = LinksMap_;
+    LinksMap LinksMap = context_->linksMap;
 
     for (; !eof_ && !error && !firstpage_thumb_num_reached ;)
     {
@@ -5293,11 +5404,11 @@ bool LvXmlParser::ParseOdt(/*DocxItems docxItems, DocxLinks docxLinks, */OdtStyl
                     callback_->OnTagClose(L"", L"a");
                     callback_->OnTagClose(L"", L"sup");
 
-                    LinksList_.add(LinkStruct(footnote_head.atoi(),id,href));
-                    LinksMap_[href.getHash()] = id;
+                    context_->linksList.add(LinkStruct(footnote_head.atoi(),id,href));
+                    context_->linksMap[href.getHash()] = id;
 
                     lString16 hrf = "#" + callback_->convertId(note_id);
-                    Epub3Notes_.AddAside(hrf);
+                    context_->epub3Notes.AddAside(hrf);
 
                     in_note = false;
                     break;
@@ -5683,7 +5794,7 @@ bool LvXmlParser::ParseOdt(/*DocxItems docxItems, DocxLinks docxLinks, */OdtStyl
 bool LvXmlParser::ParseEpubFootnotes()
 {
     Reset();
-    EpubStylesManager stylesManager = getStylesManager();
+    EpubStylesManager & stylesManager = getStylesManager();
     lString16 name = lString16("notes");
     callback_->OnStart(this);
     callback_->OnTagOpen(L"",L"body");
@@ -5720,7 +5831,6 @@ bool LvXmlParser::ParseEpubFootnotes()
 
     int buffernum =-1;
     //LVArray<LinkStruct> LinksList = getLinksList();
-    LinksMap LinksMap = getLinksMap();
     lString16 temp_section_id;
 
     for (; !eof_ && !error && !firstpage_thumb_num_reached ;)
@@ -5917,11 +6027,11 @@ bool LvXmlParser::ParseEpubFootnotes()
                         else
                         {
                             lString16 currlink_id;
-                            if(LinksMap_.size() !=0 && buffernum != -1)
+                            if(context_->linksMap.size() !=0 && buffernum != -1)
                             {
-                                if(LinksMap_.find(temp_section_id.getHash())!=LinksMap_.end())
+                                if(context_->linksMap.find(temp_section_id.getHash())!=context_->linksMap.end())
                                 {
-                                    currlink_id = LinksMap_[temp_section_id.getHash()];
+                                    currlink_id = context_->linksMap[temp_section_id.getHash()];
                                     //CRLog::error("found [%s] at [%s]",LCSTR(currlink_id),LCSTR(temp_section_id));
                                     currlink_id = lString16("#") + currlink_id ;
                                 }
@@ -5956,11 +6066,11 @@ bool LvXmlParser::ParseEpubFootnotes()
                     {
 
                         lString16 currlink_id;
-                        if (LinksMap_.size() != 0 && buffernum != -1)
+                        if (context_->linksMap.size() != 0 && buffernum != -1)
                         {
-                            if (LinksMap_.find(temp_section_id.getHash()) != LinksMap_.end())
+                            if (context_->linksMap.find(temp_section_id.getHash()) != context_->linksMap.end())
                             {
-                                currlink_id = LinksMap_[temp_section_id.getHash()];
+                                currlink_id = context_->linksMap[temp_section_id.getHash()];
                                 currlink_id = lString16("#") + currlink_id;
                             }
                         }
@@ -7024,58 +7134,65 @@ LvXmlParser::LvXmlParser(LVStreamRef stream, LvXMLParserCallback* callback,bool
           possible_capitalized_tags_(false),
           m_allowHtml(allowHtml),
           m_fb2Only(fb2Only) {
+    context_ = &ownContext_;
+    EpubStylesManager_ = &ownStylesManager_;
     this->need_coverpage_= need_coverpage;
 }
 
 LvXmlParser::~LvXmlParser() {}
 
-void LvXmlParser::setEpubNotes(EpubItems epubItems)
+void LvXmlParser::setEpubNotes(EpubItems & epubItems)
 {
-    EpubNotes_ = new EpubItems(epubItems);
+    EpubNotes_ = &epubItems;
     if(epubItems.length()>0)
     {
         Notes_exists = true;
     }
 }
 
-void LvXmlParser::setLinksList(LVArray<LinkStruct> LinksList)
+void LvXmlParser::setImportContext(LvImportContext * context)
+{
+    context_ = context;
+}
+
+void LvXmlParser::setLinksList(const LVArray<LinkStruct> & LinksList)
 {
-    LinksList_ = LinksList;
+    context_->linksList = LinksList;
 }
 
-LVArray<LinkStruct> LvXmlParser::getLinksList()
+const LVArray<LinkStruct> & LvXmlParser::getLinksList()
 {
-    return LinksList_;
+    return context_->linksList;
 }
 
-void LvXmlParser::setLinksMap(LinksMap LinksMap)
+void LvXmlParser::setLinksMap(const LinksMap & LinksMap)
 {
-    LinksMap_ = LinksMap;
+    context_->linksMap = LinksMap;
 }
 
-LinksMap LvXmlParser::getLinksMap()
+const LinksMap & LvXmlParser::getLinksMap()
 {
-    return LinksMap_;
+    return context_->linksMap;
 }
 
-void LvXmlParser::setEpub3Notes(Epub3Notes Epub3Notes)
+void LvXmlParser::setEpub3Notes(const Epub3Notes & Epub3Notes)
 {
-    Epub3Notes_ = Epub3Notes;
+    context_->epub3Notes = Epub3Notes;
 }
 
-Epub3Notes LvXmlParser::getEpub3Notes()
+const Epub3Notes & LvXmlParser::getEpub3Notes()
 {
-    return Epub3Notes_;
+    return context_->epub3Notes;
 }
 
-void LvXmlParser::setStylesManager(EpubStylesManager manager)
+void LvXmlParser::setStylesManager(EpubStylesManager & manager)
 {
-    EpubStylesManager_ = manager;
+    EpubStylesManager_ = &manager;
 }
 
-EpubStylesManager LvXmlParser::getStylesManager()
+EpubStylesManager & LvXmlParser::getStylesManager()
 {
-    return EpubStylesManager_;
+    return *EpubStylesManager_;
 }
 
 lString16 htmlCharset(lString16 htmlHeader)
@@ -556,24 +556,132 @@ bAddTableRow(diagram_type *pDiag, char **aszColTxt,
 } /* end of bAddTableRow */
 
 
-static LVStream * antiword_stream = NULL;
+// OLE2 big block size, antiword reads whole sectors or slices of them
+#define ANTIWORD_SECTOR_SIZE 512
+// Sectors per cache line, one stream read fills this many of them at once
+#define ANTIWORD_LINE_SECTORS 64
+#define ANTIWORD_LINE_SIZE (ANTIWORD_SECTOR_SIZE * ANTIWORD_LINE_SECTORS)
+// Files up to ANTIWORD_LINE_SIZE * ANTIWORD_CACHE_LINES (2 Mb) stay in memory completely
+#define ANTIWORD_CACHE_LINES 64
+
+/**
+ * Read-ahead cache between antiword and document stream.
+ * Antiword does a seek and a small read for every block chain hop and
+ * every property page, and reads headers byte by byte, so each request
+ * is served from cached lines of consecutive sectors instead.
+ */
+class AntiwordReader {
+    struct Line {
+        lUInt32 sector; // first sector of line
+        lUInt32 size;   // valid bytes, less than ANTIWORD_LINE_SIZE at end of file
+        lUInt32 used;   // last access tick, for LRU eviction
+        lUInt8 * data;
+    };
+    LVStream * stream_;
+    lvsize_t size_;
+    lvpos_t pos_;       // position for aw_getc
+    lUInt32 tick_;
+    Line lines_[ANTIWORD_CACHE_LINES];
+    int count_;
+    Line * last_;
+
+    Line * getLine(lUInt32 sector) {
+        if (last_ && last_->sector == sector)
+            return last_;
+        Line * line = NULL;
+        for (int i = 0; i < count_; i++) {
+            if (lines_[i].sector == sector) {
+                line = &lines_[i];
+                break;
+            }
+        }
+        if (!line) {
+            if (count_ < ANTIWORD_CACHE_LINES) {
+                line = &lines_[count_++];
+                line->data = (lUInt8*)malloc(ANTIWORD_LINE_SIZE);
+            } else {
+                line = &lines_[0];
+                for (int i = 1; i < count_; i++) {
+                    if (lines_[i].used < line->used)
+                        line = &lines_[i];
+                }
+            }
+            line->sector = sector;
+            line->size = 0;
+            lvpos_t start = (lvpos_t)sector * ANTIWORD_SECTOR_SIZE;
+            lvsize_t bytesRead = 0;
+            if (stream_->SetPos(start) != start
+                    || stream_->Read(line->data, ANTIWORD_LINE_SIZE, &bytesRead) != LVERR_OK) {
+                // Don't keep failed line, next request will retry it
+                line->sector = 0xFFFFFFFF;
+                return NULL;
+            }
+            line->size = (lUInt32)bytesRead;
+        }
+        line->used = ++tick_;
+        last_ = line;
+        return line;
+    }
+public:
+    AntiwordReader(LVStream * stream) : stream_(stream), pos_(0), tick_(0), count_(0), last_(NULL) {
+        size_ = stream->GetSize();
+    }
+    ~AntiwordReader() {
+        for (int i = 0; i < count_; i++)
+            free(lines_[i].data);
+    }
+    bool read(lUInt8 * buf, lvsize_t len, lvpos_t offset) {
+        if (offset + len > size_)
+            return false;
+        while (len > 0) {
+            lUInt32 sector = (lUInt32)(offset / ANTIWORD_LINE_SIZE) * ANTIWORD_LINE_SECTORS;
+            Line * line = getLine(sector);
+            if (!line)
+                return false;
+            lUInt32 delta = (lUInt32)(offset - (lvpos_t)sector * ANTIWORD_SECTOR_SIZE);
+            if (delta >= line->size)
+                return false;
+            lvsize_t n = line->size - delta;
+            if (n > len)
+                n = len;
+            memcpy(buf, line->data + delta, n);
+            buf += n;
+            offset += n;
+            len -= n;
+        }
+        return true;
+    }
+    void rewind() {
+        pos_ = 0;
+    }
+    int getc() {
+        lUInt8 b;
+        if (!read(&b, 1, pos_))
+            return EOF;
+        pos_++;
+        return b;
+    }
+};
+
+static AntiwordReader * antiword_reader = NULL;
 class AntiwordStreamGuard {
+    AntiwordReader reader;
 public:
-    AntiwordStreamGuard(LVStreamRef stream) {
-        antiword_stream = stream.get();
+    AntiwordStreamGuard(LVStreamRef stream) : reader(stream.get()) {
+        antiword_reader = &reader;
     }
     ~AntiwordStreamGuard() {
-        antiword_stream = NULL;
+        antiword_reader = NULL;
     }
     operator FILE * () {
-        return (FILE*)antiword_stream;
+        return (FILE*)antiword_reader;
     }
 };
 
 void aw_rewind(FILE * pFile)
 {
-    if ((void*) pFile == (void*) antiword_stream) {
-        antiword_stream->SetPos(0);
+    if ((void*) pFile == (void*) antiword_reader) {
+        antiword_reader->rewind();
     } else {
         rewind(pFile);
     }
@@ -581,11 +689,8 @@ void aw_rewind(FILE * pFile)
 
 int aw_getc(FILE * pFile)
 {
-    if ((void*) pFile == (void*) antiword_stream) {
-        int b = antiword_stream->ReadByte();
-        if (b >= 0)
-            return b;
-        return EOF;
+    if ((void*) pFile == (void*) antiword_reader) {
+        return antiword_reader->getc();
     } else {
         return getc(pFile);
     }
@@ -602,19 +707,12 @@ bReadBytes(UCHAR *aucBytes, size_t tMemb, ULONG ulOffset, FILE *pFile)
 {
     LFAIL(aucBytes == NULL || pFile == NULL || ulOffset > (ULONG)LONG_MAX);
 
-    if ( (void*)pFile==(void*)antiword_stream ) {
-        // use CoolReader stream
-        LVStream * stream = (LVStream*)pFile;
-        // default implementation from Antiword
+    if ( (void*)pFile==(void*)antiword_reader ) {
+        // use CoolReader stream through read-ahead cache
         if (ulOffset > (ULONG)LONG_MAX) {
             return FALSE;
         }
-        if (stream->SetPos(ulOffset)!=ulOffset ) {
-            return FALSE;
-        }
-        lvsize_t bytesRead=0;
-        if (stream->Read(aucBytes, tMemb*sizeof(UCHAR), &bytesRead) != LVERR_OK
-                || bytesRead != (lvsize_t) tMemb) {
+        if (!antiword_reader->read(aucBytes, tMemb*sizeof(UCHAR), ulOffset)) {
             return FALSE;
         }
     } else {
@@ -784,7 +882,7 @@ bool ImportWordDocument(LVStreamRef stream,	CrDom* m_doc, bool need_coverpage)
         return FALSE;
     }
     /* Reset any reading done during file testing */
-    stream->SetPos(0);
+    aw_rewind(file);
 
 
     LvDomWriter w(m_doc);
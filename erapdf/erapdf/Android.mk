@@ -26,6 +26,7 @@ LOCAL_C_INCLUDES := \
 LOCAL_SRC_FILES := \
 	EraPdfMain.cpp \
 	EraPdfBridge.cpp \
+	EraPdfCache.cpp \
 	MuPdfLinks.cpp \
 	MuPdfOutline.cpp \
 	MuPdfText.cpp \
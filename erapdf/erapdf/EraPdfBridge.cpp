@@ -163,11 +163,16 @@ void MuPdfBridge::processQuit(CmdRequest& request, CmdResponse& response)
         pagesCache.at(i).reset();
     }
     pagesCache.clear();
-    for (int i = 0; i < pageCount; i++)
+    pageCache.save();
+    if (ctx != nullptr && ctx->darkmode_objs != nullptr)
     {
-        free(ctx->darkmode_objs[i].obj);
+        for (int i = 0; i < pageCount; i++)
+        {
+            free(ctx->darkmode_objs[i].obj);
+        }
+        free(ctx->darkmode_objs);
+        ctx->darkmode_objs = nullptr;
     }
-    free(ctx->darkmode_objs);
     response.cmd = CMD_RES_QUIT;
 }
 
@@ -214,7 +219,10 @@ void MuPdfBridge::processSetLayersMask(CmdRequest& request, CmdResponse& respons
 
     this->layersmask = layersMask;
 
-    restart();
+    if (!restart()) {
+        LE("Reopening document failed");
+        response.result = RES_INTERNAL_ERROR;
+    }
 }
 
 void MuPdfBridge::processOpen(CmdRequest& request, CmdResponse& response)
@@ -292,20 +300,19 @@ void MuPdfBridge::processOpen(CmdRequest& request, CmdResponse& response)
             response.result = RES_MUPDF_OOM;
             return;
         }
-        ctx->erapdf_linearized_load = 0;
+        // Linearized files are opened from the first page xref section and hint tables only,
+        // the rest of the file is read on demand. XPS has no linearization at all.
+        ctx->erapdf_linearized_load = (format == FORMAT_PDF) ? HARDCONFIG_MUPDF_LINEARIZED_LOAD : 0;
         ctx->erapdf_ignore_most_errors = 1;
         ctx->erapdf_has_password = (this->password && strlen(this->password));
     }
     eraConfig.applyToCtx(ctx);
     if (document == nullptr) {
+        pageCache.open(config_cache_dir, fd);
         LI("Opening document: %d %d", format, fd);
         LI(ctx->erapdf_has_password ? "Password present" : "No password");
         fz_try(ctx) {
-            if (format == FORMAT_XPS) {
-                document = (fz_document*) xps_open_document_with_stream(ctx, fz_open_fd(ctx, dup(fd)));
-            } else {
-                document = (fz_document*) pdf_open_document_with_stream(ctx, fz_open_fd(ctx, dup(fd)));
-            }
+            document = openDocument();
         } fz_catch(ctx) {
             const char* msg = fz_caught_message(ctx);
             LE("Opening document failed: %s", msg);
@@ -330,7 +337,12 @@ void MuPdfBridge::processOpen(CmdRequest& request, CmdResponse& response)
         }
         applyLayersMask();
         fz_try(ctx) {
-            pageCount = fz_count_pages(ctx, document);
+            if (pageCache.isLoaded()) {
+                pageCount = pageCache.getPageCount();
+            } else {
+                pageCount = fz_count_pages(ctx, document);
+                pageCache.setPageCount(pageCount);
+            }
             LD("Document pages: %d", pageCount);
             pages = (fz_page**) calloc(pageCount, sizeof(fz_page*));
             pageLists = (fz_display_list**) calloc(pageCount, sizeof(fz_display_list*));
@@ -341,14 +353,29 @@ void MuPdfBridge::processOpen(CmdRequest& request, CmdResponse& response)
             response.addIpcString(msg, true);
             return;
         }
+        applyRepairCache();
+        if (isLinearized()) {
+            // Page count came from linearization dictionary, make sure first page is really
+            // available before answering. On failure getPage reopens in non-linearized mode.
+            if (getPage(0, false) == nullptr) {
+                LE("First page loading failed");
+                if (document == nullptr) {
+                    LE("Reopening document failed");
+                    response.result = RES_INTERNAL_ERROR;
+                    return;
+                }
+            }
+            LD("Linearized: %s", isLinearized() ? "yes" : "no, reopened");
+        }
+    }
+    if (ctx == nullptr || document == nullptr) {
+        LE("Document is not opened");
+        response.result = RES_INTERNAL_ERROR;
+        return;
     }
     response.addInt(pageCount);
 	pagesCache.reserve(5);
-	ctx->darkmode_objs = static_cast<darkmode_obj_page *>(malloc(sizeof(darkmode_obj_page) * pageCount));
-    for (int i = 0; i < pageCount; i++)
-    {
-        ctx->darkmode_objs[i].analyzed = 0;
-    }
+	ctx->darkmode_objs = static_cast<darkmode_obj_page *>(calloc(pageCount, sizeof(darkmode_obj_page)));
     ctx->erapdf_nightmode = config_invert_images;
     reflowManager = new ReflowManager(ctx, this);
 }
@@ -377,6 +404,11 @@ void MuPdfBridge::processPageInfo(CmdRequest& request, CmdResponse& response)
         debug_generate_sigsegv_segv_maperr();
     }
 #endif
+    float data[2];
+    if (pageCache.getPageSize(pageNo, &data[0], &data[1])) {
+        response.addFloatArray(2, data, true);
+        return;
+    }
     fz_page* page = getPage(pageNo, false);
     if (!page) {
         LE("No page %d found", pageNo);
@@ -386,9 +418,9 @@ void MuPdfBridge::processPageInfo(CmdRequest& request, CmdResponse& response)
     fz_try(ctx) {
         fz_rect bounds = fz_empty_rect;
         fz_bound_page(ctx, page, &bounds);
-        float data[2];
         data[0] = fabs(bounds.x1 - bounds.x0);
         data[1] = fabs(bounds.y1 - bounds.y0);
+        pageCache.setPageSize(pageNo, data[0], data[1]);
         response.addFloatArray(2, data, true);
     } fz_catch(ctx) {
         const char* msg = fz_caught_message(ctx);
@@ -472,6 +504,11 @@ void MuPdfBridge::processPage(CmdRequest& request, CmdResponse& response)
     ctx->previewmode = preview;
     ctx->preview_heavy_image = 0; // Reset flag
     fz_page* page = getPage(index, true);
+    if (ctx == nullptr) {
+        // Reopening document failed
+        response.result = RES_INTERNAL_ERROR;
+        return;
+    }
     ctx->previewmode = 0;
     response.addInt(static_cast<uint32_t>(ctx->preview_heavy_image));
     if (page == nullptr) {
@@ -715,6 +752,10 @@ void MuPdfBridge::processPageText(CmdRequest& request, CmdResponse& response)
 
 fz_page* MuPdfBridge::getPage(uint32_t index, bool decode)
 {
+    if (document == nullptr || pages == nullptr) {
+        LE("Document not opened");
+        return nullptr;
+    }
 	if (index >= pageCount || index < 0) {
 		LE("Invalid page number: %d from %d", index, pageCount);
 		return nullptr;
@@ -728,7 +769,9 @@ fz_page* MuPdfBridge::getPage(uint32_t index, bool decode)
             if (ctx->erapdf_linearized_load) {
             	LE("Try to reopen in non-linearized mode");
             	ctx->erapdf_linearized_load = 0;
-            	restart();
+            	if (!restart()) {
+            	    return nullptr;
+            	}
             	return getPage(index, decode);
             }
             return nullptr;
@@ -749,7 +792,9 @@ fz_page* MuPdfBridge::getPage(uint32_t index, bool decode)
             if (ctx->erapdf_linearized_load) {
             	LE("Try to reopen in non-linearized mode");
             	ctx->erapdf_linearized_load = 0;
-            	restart();
+            	if (!restart()) {
+            	    return nullptr;
+            	}
             	return getPage(index, decode);
             } else {
             	fz_drop_display_list(ctx, pageLists[index]);
@@ -760,27 +805,45 @@ fz_page* MuPdfBridge::getPage(uint32_t index, bool decode)
     return pages[index];
 }
 
+bool MuPdfBridge::isLinearized()
+{
+    if (document == nullptr || format != FORMAT_PDF) {
+        return false;
+    }
+    return ((pdf_document*) document)->file_reading_linearly != 0;
+}
+
 bool MuPdfBridge::restart()
 {
+    // On failure the document is left closed, document and ctx are null
+    // Dark mode analysis points into display lists of the closed document, so it is redone
+    darkmode_obj_page* darkmode_objs = ctx ? ctx->darkmode_objs : nullptr;
+    if (darkmode_objs) {
+        for (int i = 0; i < pageCount; i++) {
+            free(darkmode_objs[i].obj);
+        }
+        free(darkmode_objs);
+    }
+    int previewmode = ctx ? ctx->previewmode : 0;
     release();
+    // Hitboxes are rebuilt from pages of reopened document
+    pagesCache.clear();
     LD("Creating context: storememory = %d", storememory);
     ctx = fz_new_context(nullptr, nullptr, storememory);
     if (!ctx) {
         return false;
     }
     ctx->erapdf_ignore_most_errors = 1;
+    ctx->erapdf_has_password = (password && strlen(password));
+    ctx->erapdf_nightmode = config_invert_images;
+    ctx->previewmode = previewmode;
+    eraConfig.applyToCtx(ctx);
     fz_try(ctx) {
-        if (format == FORMAT_XPS) {
-            document = (fz_document*) xps_open_document_with_stream(ctx, fz_open_fd(ctx, dup(fd)));
-        } else {
-            document = (fz_document*) pdf_open_document_with_stream(ctx, fz_open_fd(ctx, dup(fd)));
-        }
-        LD("Document pages: %d", pageCount);
-        pages = (fz_page**) calloc(pageCount, sizeof(fz_page*));
-        pageLists = (fz_display_list**) calloc(pageCount, sizeof(fz_display_list*));
+        document = openDocument();
     } fz_catch(ctx) {
         const char* msg = fz_caught_message(ctx);
         LE("%s", msg);
+        release();
         return false;
     }
     if (fz_needs_password(ctx, document)) {
@@ -789,17 +852,106 @@ bool MuPdfBridge::restart()
             int ok = fz_authenticate_password(ctx, document, password);
             if (!ok) {
                 LE("Wrong password given");
+                release();
                 return false;
             }
         } else {
             LE("Document needs a password!");
+            release();
             return false;
         }
     }
     applyLayersMask();
+    fz_try(ctx) {
+        // Count from linearization dictionary is not trusted after failed linearized load
+        int count = fz_count_pages(ctx, document);
+        if (count != pageCount) {
+            LD("Document pages: %d, was %d", count, pageCount);
+            pageCount = count;
+            pageCache.setPageCount(pageCount);
+        }
+        pages = (fz_page**) calloc(pageCount, sizeof(fz_page*));
+        pageLists = (fz_display_list**) calloc(pageCount, sizeof(fz_display_list*));
+    } fz_catch(ctx) {
+        const char* msg = fz_caught_message(ctx);
+        LE("Counting pages failed: %s", msg);
+        release();
+        return false;
+    }
+    applyRepairCache();
+    if (darkmode_objs) {
+        ctx->darkmode_objs = static_cast<darkmode_obj_page *>(calloc(pageCount, sizeof(darkmode_obj_page)));
+    }
+    if (reflowManager != nullptr) {
+        reflowManager->setContext(ctx);
+    }
     return true;
 }
 
+fz_document* MuPdfBridge::openDocument()
+{
+    if (format == FORMAT_XPS) {
+        return (fz_document*) xps_open_document_with_stream(ctx, fz_open_fd(ctx, dup(fd)));
+    }
+    // Repaired xref saved on previous open replaces the repair scan of damaged file
+    const std::vector<uint8_t>& xref = pageCache.getXref();
+    ctx->erapdf_xref_cache = xref.empty() ? nullptr : xref.data();
+    ctx->erapdf_xref_cache_len = (int) xref.size();
+    fz_document* doc = nullptr;
+    fz_try(ctx) {
+        doc = (fz_document*) pdf_open_document_with_stream(ctx, fz_open_fd(ctx, dup(fd)));
+    } fz_always(ctx) {
+        ctx->erapdf_xref_cache = nullptr;
+        ctx->erapdf_xref_cache_len = 0;
+    } fz_catch(ctx) {
+        fz_rethrow(ctx);
+    }
+    return doc;
+}
+
+void MuPdfBridge::applyRepairCache()
+{
+    if (format != FORMAT_PDF || document == nullptr) {
+        return;
+    }
+    auto doc = (pdf_document*) document;
+    // Intact files open fast enough, only repaired ones are worth the sidecar space
+    if (!doc->repair_attempted) {
+        return;
+    }
+    if (pageCache.getXref().empty()) {
+        fz_buffer* buf = nullptr;
+        fz_try(ctx) {
+            buf = pdf_save_repaired_xref(ctx, doc);
+        } fz_catch(ctx) {
+            LE("Saving repaired xref failed: %s", fz_caught_message(ctx));
+        }
+        if (buf != nullptr) {
+            pageCache.setXref(buf->data, (uint32_t) buf->len);
+            fz_drop_buffer(ctx, buf);
+        }
+    }
+    const std::vector<int32_t>& objs = pageCache.getPageObjs();
+    if (!objs.empty()) {
+        fz_try(ctx) {
+            pdf_set_page_obj_nums(ctx, doc, objs.data(), (int) objs.size());
+        } fz_catch(ctx) {
+            LE("Restoring page objects failed: %s", fz_caught_message(ctx));
+        }
+        return;
+    }
+    // Repair has loaded every object already, so the page tree walk is cheap here
+    std::vector<int32_t> nums(pageCount, 0);
+    fz_try(ctx) {
+        for (int i = 0; i < pageCount; i++) {
+            nums[i] = pdf_to_num(ctx, pdf_lookup_page_obj(ctx, doc, i));
+        }
+        pageCache.setPageObjs(nums.data(), (uint32_t) nums.size());
+    } fz_catch(ctx) {
+        LE("Collecting page objects failed: %s", fz_caught_message(ctx));
+    }
+}
+
 void MuPdfBridge::release()
 {
     if (pageLists != nullptr) {
@@ -34,6 +34,7 @@ extern "C" {
 #include "StBridge.h"
 #include "StSearchUtils.h"
 #include "openreadera.h"
+#include "EraPdfCache.h"
 
 #define CURRENT_MAX_VERSION 2
 
@@ -247,6 +248,7 @@ class MuPdfBridge : public StBridge
 private:
     int config_format = 0;
     int config_invert_images = 0;
+    std::string config_cache_dir;
 	int fd;
     char* password;
 
@@ -267,6 +269,7 @@ private:
     std::vector<PageHitboxesCash> pagesCache;
     ReflowManager* reflowManager;
     EraConfig eraConfig;
+    EraPdfCache pageCache;
 public:
     MuPdfBridge();
     ~MuPdfBridge();
@@ -304,6 +307,9 @@ protected:
     fz_page* getPage(uint32_t index, bool decode);
     bool renderPage(uint32_t index, int w, int h, unsigned char* pixels, const fz_matrix_s* ctm);
     bool restart();
+    fz_document* openDocument();
+    void applyRepairCache();
+    bool isLinearized();
     void release();
     void resetFonts();
     void processLinks(int pageNo, CmdResponse& response);
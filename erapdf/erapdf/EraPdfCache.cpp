@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2013-2020 READERA LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "ore_log.h"
+#include "EraPdfCache.h"
+
+#define CACHE_MAGIC "ERAPDFC2"
+#define CACHE_MAGIC_SIZE 8
+// Header is at beginning of file and trailer is at its end, both change on any update
+#define CACHE_KEY_BLOCK_SIZE 1024
+// Sanity limit for page count read from sidecar
+#define CACHE_MAX_PAGES 1000000
+// Sanity limit for repaired xref size read from sidecar
+#define CACHE_MAX_XREF_SIZE (256 * 1024 * 1024)
+
+static uint64_t fnv1a(uint64_t hash, const void* data, size_t len)
+{
+    const uint8_t* p = (const uint8_t*) data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool EraPdfCache::readKey(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        LE("EraPdfCache: fstat failed");
+        return false;
+    }
+    file_size_ = (uint64_t) st.st_size;
+    file_mtime_ = (int64_t) st.st_mtime;
+
+    // pread doesn't move file offset shared with the document stream
+    uint8_t block[CACHE_KEY_BLOCK_SIZE];
+    uint64_t hash = 14695981039346656037ULL;
+    ssize_t len = pread(fd, block, sizeof(block), 0);
+    if (len <= 0) {
+        return false;
+    }
+    hash = fnv1a(hash, block, (size_t) len);
+    if (file_size_ > CACHE_KEY_BLOCK_SIZE) {
+        len = pread(fd, block, sizeof(block), (off_t) (file_size_ - CACHE_KEY_BLOCK_SIZE));
+        if (len <= 0) {
+            return false;
+        }
+        hash = fnv1a(hash, block, (size_t) len);
+    }
+    file_hash_ = hash;
+    return true;
+}
+
+bool EraPdfCache::open(const std::string& cache_dir, int fd)
+{
+    reset();
+    if (cache_dir.empty() || fd < 0) {
+        return false;
+    }
+    if (!readKey(fd)) {
+        return false;
+    }
+    uint64_t name_hash = fnv1a(file_hash_, &file_size_, sizeof(file_size_));
+    name_hash = fnv1a(name_hash, &file_mtime_, sizeof(file_mtime_));
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.pdfc", (unsigned long long) name_hash);
+    path_ = cache_dir + "/" + name;
+    loaded_ = load();
+    LD("EraPdfCache: %s %s", path_.c_str(), loaded_ ? "loaded" : "not found");
+    return loaded_;
+}
+
+bool EraPdfCache::load()
+{
+    FILE* f = fopen(path_.c_str(), "rb");
+    if (f == nullptr) {
+        return false;
+    }
+    char magic[CACHE_MAGIC_SIZE];
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    uint64_t hash = 0;
+    uint32_t count = 0;
+    bool ok = fread(magic, 1, CACHE_MAGIC_SIZE, f) == CACHE_MAGIC_SIZE
+            && memcmp(magic, CACHE_MAGIC, CACHE_MAGIC_SIZE) == 0
+            && fread(&size, sizeof(size), 1, f) == 1
+            && fread(&mtime, sizeof(mtime), 1, f) == 1
+            && fread(&hash, sizeof(hash), 1, f) == 1
+            && fread(&count, sizeof(count), 1, f) == 1
+            && size == file_size_ && mtime == file_mtime_ && hash == file_hash_
+            && count > 0 && count <= CACHE_MAX_PAGES;
+    if (ok) {
+        sizes_.resize(count * 2);
+        ok = fread(sizes_.data(), sizeof(float), sizes_.size(), f) == sizes_.size();
+    }
+    uint32_t xref_len = 0;
+    if (ok) {
+        ok = fread(&xref_len, sizeof(xref_len), 1, f) == 1 && xref_len <= CACHE_MAX_XREF_SIZE;
+    }
+    if (ok) {
+        xref_.resize(xref_len);
+        ok = fread(xref_.data(), 1, xref_len, f) == xref_len;
+    }
+    uint32_t objs_count = 0;
+    if (ok) {
+        ok = fread(&objs_count, sizeof(objs_count), 1, f) == 1
+                && (objs_count == 0 || objs_count == count);
+    }
+    if (ok) {
+        page_objs_.resize(objs_count);
+        ok = fread(page_objs_.data(), sizeof(int32_t), objs_count, f) == objs_count;
+    }
+    fclose(f);
+    if (!ok) {
+        LE("EraPdfCache: stale or broken sidecar %s", path_.c_str());
+        sizes_.clear();
+        xref_.clear();
+        page_objs_.clear();
+        return false;
+    }
+    page_count_ = count;
+    return true;
+}
+
+void EraPdfCache::save()
+{
+    if (path_.empty() || !dirty_ || page_count_ == 0) {
+        return;
+    }
+    // Write to temporary file first, so crash in the middle never leaves broken sidecar
+    std::string tmp_path = path_ + ".tmp";
+    FILE* f = fopen(tmp_path.c_str(), "wb");
+    if (f == nullptr) {
+        LE("EraPdfCache: can't write %s", tmp_path.c_str());
+        return;
+    }
+    bool ok = fwrite(CACHE_MAGIC, 1, CACHE_MAGIC_SIZE, f) == CACHE_MAGIC_SIZE
+            && fwrite(&file_size_, sizeof(file_size_), 1, f) == 1
+            && fwrite(&file_mtime_, sizeof(file_mtime_), 1, f) == 1
+            && fwrite(&file_hash_, sizeof(file_hash_), 1, f) == 1
+            && fwrite(&page_count_, sizeof(page_count_), 1, f) == 1
+            && fwrite(sizes_.data(), sizeof(float), sizes_.size(), f) == sizes_.size();
+    uint32_t xref_len = (uint32_t) xref_.size();
+    uint32_t objs_count = (uint32_t) page_objs_.size();
+    ok = ok && fwrite(&xref_len, sizeof(xref_len), 1, f) == 1
+            && fwrite(xref_.data(), 1, xref_len, f) == xref_len
+            && fwrite(&objs_count, sizeof(objs_count), 1, f) == 1
+            && fwrite(page_objs_.data(), sizeof(int32_t), objs_count, f) == objs_count;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp_path.c_str(), path_.c_str()) != 0) {
+        LE("EraPdfCache: failed to save %s", path_.c_str());
+        unlink(tmp_path.c_str());
+        return;
+    }
+    dirty_ = false;
+}
+
+void EraPdfCache::reset()
+{
+    path_.clear();
+    file_size_ = 0;
+    file_mtime_ = 0;
+    file_hash_ = 0;
+    page_count_ = 0;
+    sizes_.clear();
+    xref_.clear();
+    page_objs_.clear();
+    loaded_ = false;
+    dirty_ = false;
+}
+
+void EraPdfCache::setPageCount(uint32_t page_count)
+{
+    if (page_count == page_count_) {
+        return;
+    }
+    page_count_ = page_count;
+    sizes_.assign(page_count * 2, -1.0f);
+    page_objs_.clear();
+    dirty_ = true;
+}
+
+bool EraPdfCache::getPageSize(uint32_t page, float* w, float* h)
+{
+    if (page >= page_count_ || sizes_[page * 2] < 0) {
+        return false;
+    }
+    *w = sizes_[page * 2];
+    *h = sizes_[page * 2 + 1];
+    return true;
+}
+
+void EraPdfCache::setPageSize(uint32_t page, float w, float h)
+{
+    if (page >= page_count_) {
+        return;
+    }
+    if (sizes_[page * 2] == w && sizes_[page * 2 + 1] == h) {
+        return;
+    }
+    sizes_[page * 2] = w;
+    sizes_[page * 2 + 1] = h;
+    dirty_ = true;
+}
+
+void EraPdfCache::setXref(const uint8_t* data, uint32_t len)
+{
+    if (len > CACHE_MAX_XREF_SIZE) {
+        return;
+    }
+    xref_.assign(data, data + len);
+    dirty_ = true;
+}
+
+void EraPdfCache::setPageObjs(const int32_t* nums, uint32_t count)
+{
+    if (count != page_count_) {
+        return;
+    }
+    page_objs_.assign(nums, nums + count);
+    dirty_ = true;
+}
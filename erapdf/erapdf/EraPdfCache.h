@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2013-2020 READERA LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ERAPDF_CACHE_H__
+#define __ERAPDF_CACHE_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Sidecar file with page count and page sizes of a document, so reopening
+ * the same file does not need to load every page to answer page info requests.
+ * For damaged files it also keeps the repaired xref and page object numbers,
+ * so reopening skips the repair scan of the whole file and the page tree walk.
+ * File is identified by its size, modification time and a hash of its header
+ * and trailer bytes.
+ */
+class EraPdfCache
+{
+private:
+    std::string path_;
+    uint64_t file_size_ = 0;
+    int64_t file_mtime_ = 0;
+    uint64_t file_hash_ = 0;
+    uint32_t page_count_ = 0;
+    // Two floats per page, negative width means page size is not known yet
+    std::vector<float> sizes_;
+    // Opaque data from pdf_save_repaired_xref, empty if document was not repaired
+    std::vector<uint8_t> xref_;
+    // Page object numbers, empty if not known
+    std::vector<int32_t> page_objs_;
+    bool loaded_ = false;
+    bool dirty_ = false;
+
+    bool readKey(int fd);
+    bool load();
+public:
+    EraPdfCache() {};
+
+    /// Computes document key and loads sidecar from cache_dir if it matches
+    bool open(const std::string& cache_dir, int fd);
+    void save();
+    void reset();
+
+    bool isLoaded() { return loaded_; }
+    uint32_t getPageCount() { return page_count_; }
+    void setPageCount(uint32_t page_count);
+    bool getPageSize(uint32_t page, float* w, float* h);
+    void setPageSize(uint32_t page, float w, float h);
+    const std::vector<uint8_t>& getXref() { return xref_; }
+    void setXref(const uint8_t* data, uint32_t len);
+    const std::vector<int32_t>& getPageObjs() { return page_objs_; }
+    void setPageObjs(const int32_t* nums, uint32_t count);
+};
+
+#endif
@@ -170,6 +170,13 @@ ReflowManager::ReflowManager(fz_context *ctx, MuPdfBridge *muPdfBridge)
     pageStatsArray = std::vector<PageStats>(this->pageCount);
 }
 
+void ReflowManager::setContext(fz_context *ctx)
+{
+    this->ctx = ctx;
+    this->pageCount = muPdfBridge->pageCount;
+    pageStatsArray = std::vector<PageStats>(this->pageCount);
+}
+
 void ReflowManager::freePage(int index)
 {
     if (muPdfBridge->pageLists[index])
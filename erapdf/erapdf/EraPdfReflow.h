@@ -111,6 +111,8 @@ class ReflowManager
 {
 public:
     ReflowManager(fz_context *ctx, MuPdfBridge *muPdfBridge);
+    /// rebinds to context of reopened document, page stats are collected again
+    void setContext(fz_context *ctx);
     bool analyzed = false;
     int doctype = REFLOW_UNSUPPORTED;
 
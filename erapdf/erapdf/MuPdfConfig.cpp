@@ -61,6 +61,10 @@ void MuPdfBridge::processConfig(CmdRequest& request, CmdResponse& response)
             eraConfig.f_bg_color[1] = ((c >> 8 ) & 0xFF) * FLOAT_COEFF ; //g
             eraConfig.f_bg_color[2] = ( c        & 0xFF) * FLOAT_COEFF ; //b
         }
+        else if (key == CONFIG_MUPDF_CACHE_DIR)
+        {
+            config_cache_dir = val;
+        }
         else
         {
             LE("processConfig unknown key: key=%d, val=%s", key, val);
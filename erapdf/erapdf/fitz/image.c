@@ -238,6 +238,132 @@ fz_drop_image_imp(fz_context *ctx, fz_storable *image_)
 	fz_free(ctx, image);
 }
 
+// EraPDF: bilevel samples cache >>>
+/* Decoding of JBIG2 and CCITT fax images is expensive and can't be done
+ * at reduced resolution, so decoded 1 bpc samples are kept in store
+ * next to the tiles. Tile for any other subsample factor is then made
+ * from them without running the decoder again. */
+#define FZ_IMAGE_SAMPLES_L2FACTOR -1
+
+typedef struct fz_image_samples_s fz_image_samples;
+
+struct fz_image_samples_s {
+	fz_storable storable;
+	unsigned char *data;
+	int len;
+};
+
+static void
+fz_drop_image_samples_imp(fz_context *ctx, fz_storable *samples_)
+{
+	fz_image_samples *samples = (fz_image_samples *)samples_;
+
+	fz_free(ctx, samples->data);
+	fz_free(ctx, samples);
+}
+
+static int
+fz_is_bilevel_image(fz_image *image)
+{
+	int type = image->buffer->params.type;
+	return (type == FZ_IMAGE_JBIG2 || type == FZ_IMAGE_FAX) && image->bpc == 1 && image->n == 1;
+}
+
+static fz_image_samples *
+fz_load_bilevel_samples(fz_context *ctx, fz_image *image)
+{
+	fz_image_samples *samples;
+	fz_image_samples *existing;
+	fz_image_key key;
+	fz_image_key *keyp = NULL;
+	fz_stream *stm = NULL;
+	int stride = (image->w + 7) / 8;
+	int native_l2factor = 0;
+
+	key.refs = 1;
+	key.image = image;
+	key.l2factor = FZ_IMAGE_SAMPLES_L2FACTOR;
+	samples = fz_find_item(ctx, fz_drop_image_samples_imp, &key, &fz_image_store_type);
+	if (samples)
+		return samples;
+
+	samples = fz_malloc_struct(ctx, fz_image_samples);
+	FZ_INIT_STORABLE(samples, 1, fz_drop_image_samples_imp);
+
+	fz_var(stm);
+	fz_try(ctx)
+	{
+		samples->data = fz_malloc_array(ctx, image->h, stride);
+		stm = fz_open_image_decomp_stream_from_buffer(ctx, image->buffer, &native_l2factor);
+		samples->len = fz_read(ctx, stm, samples->data, image->h * stride);
+	}
+	fz_always(ctx)
+	{
+		fz_drop_stream(ctx, stm);
+	}
+	fz_catch(ctx)
+	{
+		fz_drop_storable(ctx, &samples->storable);
+		fz_rethrow(ctx);
+	}
+
+	/* Failing to store samples is not an error, we just decode them again next time */
+	fz_var(keyp);
+	fz_try(ctx)
+	{
+		keyp = fz_malloc_struct(ctx, fz_image_key);
+		keyp->refs = 1;
+		keyp->image = fz_keep_image(ctx, image);
+		keyp->l2factor = FZ_IMAGE_SAMPLES_L2FACTOR;
+		existing = fz_store_item(ctx, keyp, samples, sizeof(*samples) + image->h * stride, &fz_image_store_type);
+		if (existing)
+		{
+			fz_drop_storable(ctx, &samples->storable);
+			samples = existing;
+		}
+	}
+	fz_always(ctx)
+	{
+		if (keyp)
+			fz_drop_image_key(ctx, keyp);
+	}
+	fz_catch(ctx)
+	{
+		/* Do nothing */
+	}
+
+	return samples;
+}
+
+static fz_pixmap *
+fz_decomp_bilevel_image(fz_context *ctx, fz_image *image, int l2factor)
+{
+	fz_image_samples *samples;
+	fz_pixmap *tile = NULL;
+	int indexed;
+
+	samples = fz_load_bilevel_samples(ctx, image);
+	indexed = fz_colorspace_is_indexed(ctx, image->colorspace);
+
+	fz_try(ctx)
+	{
+		/* Memory stream doesn't own the data, samples are kept alive until tile is ready */
+		fz_stream *stm = fz_open_memory(ctx, samples->data, samples->len);
+		tile = fz_decomp_image_from_stream(ctx, stm, image, indexed, l2factor, 0);
+	}
+	fz_always(ctx)
+	{
+		fz_drop_storable(ctx, &samples->storable);
+	}
+	fz_catch(ctx)
+	{
+		fz_rethrow(ctx);
+	}
+
+	return tile;
+}
+// EraPDF: bilevel samples cache <<<
+
 fz_pixmap *
 fz_image_get_pixmap(fz_context *ctx, fz_image *image, int w, int h)
 {
@@ -319,6 +445,13 @@ fz_image_get_pixmap(fz_context *ctx, fz_image *image, int w, int h)
 		/* fall through */
 
 	default:
+// EraPDF: bilevel samples cache >>>
+		if (fz_is_bilevel_image(image))
+		{
+			tile = fz_decomp_bilevel_image(ctx, image, l2factor);
+			break;
+		}
+// EraPDF: bilevel samples cache <<<
 		native_l2factor = l2factor;
 		stm = fz_open_image_decomp_stream_from_buffer(ctx, image->buffer, &native_l2factor);
 
@@ -10,6 +10,8 @@
 
 #include <openjpeg.h>
 #define MAXSIZE 512
+/* Smaller images are decoded faster than worker threads are started */
+#define THREADED_MIN_PIXELS (1024 * 1024)
 
 static void fz_opj_error_callback(const char *msg, void *client_data)
 {
@@ -80,6 +82,42 @@ static inline unsigned int read_value(const unsigned char *data, int bytes)
 	return value;
 }
 
+/* Reads image size from SIZ marker of bare codestream or from ihdr box of
+ * JP2 file without creating a codec. */
+static int jpx_read_size(unsigned char *data, int size, int *width, int *height)
+{
+	int i;
+
+	if (size >= 24 && data[0] == 0xFF && data[1] == 0x4F && data[2] == 0xFF && data[3] == 0x51)
+	{
+		*width = read_value(data + 8, 4) - read_value(data + 16, 4);
+		*height = read_value(data + 12, 4) - read_value(data + 20, 4);
+		return 1;
+	}
+	for (i = 0; i + 12 <= size; i++)
+	{
+		if (data[i] == 'i' && !memcmp(data + i, "ihdr", 4))
+		{
+			*height = read_value(data + i + 4, 4);
+			*width = read_value(data + i + 8, 4);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int jpx_decode_threads(unsigned char *data, int size)
+{
+	int width = 0;
+	int height = 0;
+
+	if (!jpx_read_size(data, size, &width, &height))
+		return 0;
+	if (width <= 0 || height <= 0 || (long long)width * height < THREADED_MIN_PIXELS)
+		return 0;
+	return opj_get_num_cpus();
+}
+
 void getJpxDims(fz_context *ctx, unsigned char *data, int size, int indexed, int *width, int *height, int *numcomps)
 {
 	opj_dparameters_t params;
@@ -105,8 +143,6 @@ void getJpxDims(fz_context *ctx, unsigned char *data, int size, int indexed, int
 
 	codec = opj_create_decompress(format);
 
-	//opj_codec_set_threads(codec,4); // if not called - creates %cpu number% threads
-
 	opj_set_info_handler(codec, fz_opj_info_callback, ctx);
 	opj_set_warning_handler(codec, fz_opj_warning_callback, ctx);
 	opj_set_error_handler(codec, fz_opj_error_callback, ctx);
@@ -156,6 +192,7 @@ fz_load_jpx(fz_context *ctx, unsigned char *data, int size, fz_colorspace *defcs
 	OPJ_CODEC_FORMAT format;
 	int a, n, w, h, depth, sgnd;
 	int x, y, k, v;
+	int threads;
 	stream_block sb;
 
 	if (size < 2)
@@ -173,7 +210,9 @@ fz_load_jpx(fz_context *ctx, unsigned char *data, int size, fz_colorspace *defcs
 
 	codec = opj_create_decompress(format);
 
-	//opj_codec_set_threads(codec,4); // if not called - creates %cpu number% threads
+	threads = jpx_decode_threads(data, size);
+	if (threads > 0)
+		opj_codec_set_threads(codec, threads);
 
 	if(ctx->previewmode == 1)
 	{
@@ -194,6 +194,9 @@ struct fz_context_s
 	int erapdf_file_stream_offset;
 	int erapdf_has_password;
 	int erapdf_reparing;
+	// Repaired xref saved by pdf_save_repaired_xref on previous open, used instead of repair scan
+	const unsigned char *erapdf_xref_cache;
+	int erapdf_xref_cache_len;
 	int previewmode;
 	int flag_interpolate_images;
 	int preview_heavy_image;
@@ -188,6 +188,16 @@ struct pdf_document_s
 
 	int repair_attempted;
 
+// EraPDF: persistent repaired xref >>>
+	/* Stream lengths fixed by repair, restored with cached xref */
+	int *erapdf_stm_lens;
+	int erapdf_stm_lens_len;
+	/* Page object numbers saved on previous open, refs are created on first lookup */
+	int *erapdf_page_nums;
+	pdf_obj **erapdf_page_refs;
+	int erapdf_page_nums_len;
+// EraPDF: persistent repaired xref <<<
+
 	/* State indicating which file parsing method we are using */
 	int file_reading_linearly;
 	int file_length;
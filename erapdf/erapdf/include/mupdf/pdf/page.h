@@ -4,6 +4,9 @@
 int pdf_lookup_page_number(fz_context *ctx, pdf_document *doc, pdf_obj *pageobj);
 int pdf_count_pages(fz_context *ctx, pdf_document *doc);
 pdf_obj *pdf_lookup_page_obj(fz_context *ctx, pdf_document *doc, int needle);
+// EraPDF: persistent repaired xref >>>
+void pdf_set_page_obj_nums(fz_context *ctx, pdf_document *doc, const int *nums, int n);
+// EraPDF: persistent repaired xref <<<
 
 /*
 	pdf_load_page: Load a page and its resources.
@@ -97,6 +97,10 @@ int pdf_xref_is_incremental(fz_context *ctx, pdf_document *doc, int num);
 
 void pdf_repair_xref(fz_context *ctx, pdf_document *doc);
 void pdf_repair_obj_stms(fz_context *ctx, pdf_document *doc);
+// EraPDF: persistent repaired xref >>>
+fz_buffer *pdf_save_repaired_xref(fz_context *ctx, pdf_document *doc);
+void pdf_load_repaired_xref(fz_context *ctx, pdf_document *doc, const unsigned char *data, int len);
+// EraPDF: persistent repaired xref <<<
 pdf_obj *pdf_new_ref(fz_context *ctx, pdf_document *doc, pdf_obj *obj);
 void pdf_ensure_solid_xref(fz_context *ctx, pdf_document *doc, int num);
 void pdf_mark_xref(fz_context *ctx, pdf_document *doc);
@@ -155,9 +155,59 @@ pdf_lookup_page_loc(fz_context *ctx, pdf_document *doc, int needle, pdf_obj **pa
 pdf_obj *
 pdf_lookup_page_obj(fz_context *ctx, pdf_document *doc, int needle)
 {
+// EraPDF: persistent repaired xref >>>
+	if (needle >= 0 && needle < doc->erapdf_page_nums_len)
+	{
+		pdf_obj *ref = doc->erapdf_page_refs[needle];
+		if (!ref)
+		{
+			int num = doc->erapdf_page_nums[needle];
+			if (num > 0 && num < pdf_xref_len(ctx, doc))
+				ref = doc->erapdf_page_refs[needle] = pdf_new_indirect(ctx, doc, num, 0);
+		}
+		/* Saved number is only a hint, page tree is walked if it is not a page */
+		if (ref && pdf_name_eq(ctx, pdf_get_node_type(ctx, ref), PDF_NAME_Page))
+			return ref;
+	}
+// EraPDF: persistent repaired xref <<<
 	return pdf_lookup_page_loc(ctx, doc, needle, NULL, NULL);
 }
 
+// EraPDF: persistent repaired xref >>>
+void
+pdf_set_page_obj_nums(fz_context *ctx, pdf_document *doc, const int *nums, int n)
+{
+	int i;
+
+	if (doc->erapdf_page_refs)
+	{
+		for (i = 0; i < doc->erapdf_page_nums_len; i++)
+			pdf_drop_obj(ctx, doc->erapdf_page_refs[i]);
+		fz_free(ctx, doc->erapdf_page_refs);
+		doc->erapdf_page_refs = NULL;
+	}
+	fz_free(ctx, doc->erapdf_page_nums);
+	doc->erapdf_page_nums = NULL;
+	doc->erapdf_page_nums_len = 0;
+
+	if (n <= 0)
+		return;
+	doc->erapdf_page_nums = fz_malloc_array(ctx, n, sizeof(int));
+	fz_try(ctx)
+	{
+		doc->erapdf_page_refs = fz_calloc(ctx, n, sizeof(pdf_obj *));
+	}
+	fz_catch(ctx)
+	{
+		fz_free(ctx, doc->erapdf_page_nums);
+		doc->erapdf_page_nums = NULL;
+		fz_rethrow(ctx);
+	}
+	memcpy(doc->erapdf_page_nums, nums, n * sizeof(int));
+	doc->erapdf_page_nums_len = n;
+}
+// EraPDF: persistent repaired xref <<<
+
 static int
 pdf_count_pages_before_kid(fz_context *ctx, pdf_document *doc, pdf_obj *parent, int kid_num)
 {
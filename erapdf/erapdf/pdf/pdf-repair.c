@@ -629,3 +629,148 @@ pdf_repair_obj_stms(fz_context *ctx, pdf_document *doc)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "invalid reference to non-object-stream: %d (%d 0 R)", entry->ofs, i);
 	}
 }
+
+// EraPDF: persistent repaired xref >>>
+/*
+ * Cached xref layout, native byte order:
+ *   int n, n records of int[5] { type, gen, ofs, stm_ofs, stm_len },
+ *   int trailer_len, trailer printed as pdf dictionary.
+ * stm_len is the stream length fixed by repair or -1.
+ */
+#define XREF_CACHE_REC 5
+
+fz_buffer *
+pdf_save_repaired_xref(fz_context *ctx, pdf_document *doc)
+{
+	fz_buffer *buf;
+	char *trailer = NULL;
+	int i, n, len;
+
+	if (!doc->repair_attempted)
+		return NULL;
+
+	n = pdf_xref_len(ctx, doc);
+	len = pdf_sprint_obj(ctx, NULL, 0, pdf_trailer(ctx, doc), 1);
+	buf = fz_new_buffer(ctx, (2 + n * XREF_CACHE_REC) * sizeof(int) + len);
+
+	fz_var(trailer);
+
+	fz_try(ctx)
+	{
+		fz_write_buffer(ctx, buf, &n, sizeof(int));
+		for (i = 0; i < n; i++)
+		{
+			pdf_xref_entry *entry = pdf_get_xref_entry(ctx, doc, i);
+			int rec[XREF_CACHE_REC] = { 0, 0, 0, 0, -1 };
+
+			if (entry)
+			{
+				/* Objects created in memory can't be found in file on next open */
+				if (entry->stm_buf)
+					fz_throw(ctx, FZ_ERROR_GENERIC, "object (%d 0 R) is not in file", i);
+				rec[0] = entry->type;
+				rec[1] = entry->gen;
+				rec[2] = entry->ofs;
+				rec[3] = entry->stm_ofs;
+				if (entry->type == 'n' && entry->stm_ofs && pdf_is_dict(ctx, entry->obj) && !doc->crypt)
+				{
+					pdf_obj *length = pdf_dict_get(ctx, entry->obj, PDF_NAME_Length);
+					if (!pdf_is_indirect(ctx, length) && pdf_is_int(ctx, length))
+						rec[4] = pdf_to_int(ctx, length);
+				}
+			}
+			fz_write_buffer(ctx, buf, rec, sizeof(rec));
+		}
+
+		trailer = fz_malloc(ctx, len + 1);
+		pdf_sprint_obj(ctx, trailer, len + 1, pdf_trailer(ctx, doc), 1);
+		fz_write_buffer(ctx, buf, &len, sizeof(int));
+		fz_write_buffer(ctx, buf, trailer, len);
+	}
+	fz_always(ctx)
+	{
+		fz_free(ctx, trailer);
+	}
+	fz_catch(ctx)
+	{
+		fz_drop_buffer(ctx, buf);
+		fz_rethrow_if(ctx, FZ_ERROR_TRYLATER);
+		fz_warn(ctx, "cannot save repaired xref");
+		return NULL;
+	}
+	return buf;
+}
+
+void
+pdf_load_repaired_xref(fz_context *ctx, pdf_document *doc, const unsigned char *data, int len)
+{
+	pdf_obj *trailer = NULL;
+	fz_stream *stm = NULL;
+	int i, n, tlen, tofs;
+
+	if (len < (int) (2 * sizeof(int)))
+		fz_throw(ctx, FZ_ERROR_GENERIC, "broken cached xref");
+	memcpy(&n, data, sizeof(int));
+	if (n <= 0 || n > MAX_OBJECT_NUMBER + 1 || len < (int) ((2 + n * XREF_CACHE_REC) * sizeof(int)))
+		fz_throw(ctx, FZ_ERROR_GENERIC, "broken cached xref");
+	tofs = (2 + n * XREF_CACHE_REC) * sizeof(int);
+	memcpy(&tlen, data + tofs - sizeof(int), sizeof(int));
+	if (tlen <= 0 || tlen != len - tofs)
+		fz_throw(ctx, FZ_ERROR_GENERIC, "broken cached xref");
+
+	/* Same state as after pdf_repair_xref */
+	doc->repair_attempted = 1;
+	doc->dirty = 1;
+	doc->freeze_updates = 1;
+
+	fz_var(trailer);
+	fz_var(stm);
+
+	fz_try(ctx)
+	{
+		pdf_ensure_solid_xref(ctx, doc, n);
+		doc->erapdf_stm_lens = fz_malloc_array(ctx, n, sizeof(int));
+		doc->erapdf_stm_lens_len = n;
+
+		for (i = 0; i < n; i++)
+		{
+			pdf_xref_entry *entry;
+			int rec[XREF_CACHE_REC];
+
+			memcpy(rec, data + (1 + i * XREF_CACHE_REC) * sizeof(int), sizeof(rec));
+			if (rec[0] != 0 && rec[0] != 'f' && rec[0] != 'n' && rec[0] != 'o')
+				fz_throw(ctx, FZ_ERROR_GENERIC, "broken cached xref entry (%d)", i);
+			if (rec[0] == 'n' && (rec[2] < 0 || rec[2] >= doc->file_length))
+				fz_throw(ctx, FZ_ERROR_GENERIC, "broken cached xref entry (%d)", i);
+			if (rec[0] == 'o' && (rec[2] <= 0 || rec[2] >= n))
+				fz_throw(ctx, FZ_ERROR_GENERIC, "broken cached xref entry (%d)", i);
+
+			entry = pdf_get_populating_xref_entry(ctx, doc, i);
+			entry->type = rec[0];
+			entry->gen = fz_clampi(rec[1], 0, 65535);
+			entry->ofs = rec[2];
+			entry->stm_ofs = rec[3];
+			doc->erapdf_stm_lens[i] = rec[4];
+		}
+
+		stm = fz_open_memory(ctx, (unsigned char *) data + tofs, tlen);
+		if (pdf_lex(ctx, stm, &doc->lexbuf.base) != PDF_TOK_OPEN_DICT)
+			fz_throw(ctx, FZ_ERROR_GENERIC, "broken cached trailer");
+		trailer = pdf_parse_dict(ctx, doc, stm, &doc->lexbuf.base);
+		pdf_set_populating_xref_trailer(ctx, doc, trailer);
+	}
+	fz_always(ctx)
+	{
+		pdf_drop_obj(ctx, trailer);
+		fz_drop_stream(ctx, stm);
+	}
+	fz_catch(ctx)
+	{
+		fz_free(ctx, doc->erapdf_stm_lens);
+		doc->erapdf_stm_lens = NULL;
+		doc->erapdf_stm_lens_len = 0;
+		doc->repair_attempted = 0;
+		fz_rethrow(ctx);
+	}
+}
+// EraPDF: persistent repaired xref <<<
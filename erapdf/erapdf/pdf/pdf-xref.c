@@ -1400,6 +1400,9 @@ pdf_init_document(fz_context *ctx, pdf_document *doc)
 	pdf_obj *obj;
 	pdf_obj *nobj = NULL;
 	int i, repaired = 0;
+// EraPDF: persistent repaired xref >>>
+	int cached = 0;
+// EraPDF: persistent repaired xref <<<
 
 	fz_var(dict);
 	fz_var(nobj);
@@ -1454,7 +1457,24 @@ pdf_init_document(fz_context *ctx, pdf_document *doc)
 		{
 			/* pdf_repair_xref may access xref_index, so reset it properly */
 			memset(doc->xref_index, 0, sizeof(int) * doc->max_xref_len);
-			pdf_repair_xref(ctx, doc);
+// EraPDF: persistent repaired xref >>>
+			if (ctx->erapdf_xref_cache)
+			{
+				fz_try(ctx)
+				{
+					pdf_load_repaired_xref(ctx, doc, ctx->erapdf_xref_cache, ctx->erapdf_xref_cache_len);
+					cached = 1;
+				}
+				fz_catch(ctx)
+				{
+					fz_warn(ctx, "ignoring cached xref: %s", fz_caught_message(ctx));
+					pdf_drop_xref_sections(ctx, doc);
+					memset(doc->xref_index, 0, sizeof(int) * doc->max_xref_len);
+				}
+			}
+			if (!cached)
+				pdf_repair_xref(ctx, doc);
+// EraPDF: persistent repaired xref <<<
 			pdf_prime_xref_index(ctx, doc);
 		}
 
@@ -1466,7 +1486,10 @@ pdf_init_document(fz_context *ctx, pdf_document *doc)
 		/* Allow lazy clients to read encrypted files with a blank password */
 		pdf_authenticate_password(ctx, doc, "");
 
-		if (repaired)
+// EraPDF: persistent repaired xref >>>
+		/* Cached xref already has object streams and Root/Info of the finished repair */
+		if (repaired && !cached)
+// EraPDF: persistent repaired xref <<<
 		{
 			int xref_len = pdf_xref_len(ctx, doc);
 			pdf_repair_obj_stms(ctx, doc);
@@ -1594,6 +1617,18 @@ pdf_close_document(fz_context *ctx, pdf_document *doc)
 		}
 		fz_free(ctx, doc->linear_page_refs);
 	}
+// EraPDF: persistent repaired xref >>>
+	fz_free(ctx, doc->erapdf_stm_lens);
+	if (doc->erapdf_page_refs)
+	{
+		for (i=0; i < doc->erapdf_page_nums_len; i++)
+		{
+			pdf_drop_obj(ctx, doc->erapdf_page_refs[i]);
+		}
+		fz_free(ctx, doc->erapdf_page_refs);
+	}
+	fz_free(ctx, doc->erapdf_page_nums);
+// EraPDF: persistent repaired xref <<<
 	fz_free(ctx, doc->hint_page);
 	fz_free(ctx, doc->hint_shared_ref);
 	fz_free(ctx, doc->hint_shared);
@@ -2049,6 +2084,16 @@ object_updated:
 			goto object_updated;
 		}
 
+// EraPDF: persistent repaired xref >>>
+		/* Restore stream length fixed by repair on previous open */
+		if (num < doc->erapdf_stm_lens_len && doc->erapdf_stm_lens[num] >= 0 && pdf_is_dict(ctx, x->obj))
+		{
+			pdf_obj *length = pdf_new_int(ctx, doc, doc->erapdf_stm_lens[num]);
+			pdf_dict_put(ctx, x->obj, PDF_NAME_Length, length);
+			pdf_drop_obj(ctx, length);
+		}
+// EraPDF: persistent repaired xref <<<
+
 		if (doc->crypt)
 			pdf_crypt_obj(ctx, doc->crypt, x->obj, num, gen);
 	}
@@ -9549,10 +9549,9 @@ opj_j2k_t* opj_j2k_create_decompress(void)
         opj_j2k_destroy(l_j2k);
         return 00;
     }
-    l_j2k->m_tp = opj_thread_pool_create(opj_j2k_get_default_thread_count());
-    if (!l_j2k->m_tp) {
-        l_j2k->m_tp = opj_thread_pool_create(0);
-    }
+    /* Decoder threads are spawned on demand with opj_codec_set_threads(), */
+    /* pool for every header probe or small image costs more than decoding */
+    l_j2k->m_tp = opj_thread_pool_create(0);
     if (!l_j2k->m_tp) {
         opj_j2k_destroy(l_j2k);
         return NULL;
@@ -77,6 +77,9 @@ int StBridge::main(int argc, char *argv[]) {
         LDD(LOG, "StBridge: Sending response...");
         out.writeResponse(response);
         run = response.cmd != CMD_RES_QUIT;
+        if (run) {
+            processIdle();
+        }
         request.reset();
         response.reset();
     }
@@ -29,6 +29,8 @@ public:
     virtual ~StBridge() {};
     virtual int main(int argc, char *argv[]);
     virtual void process(CmdRequest& request, CmdResponse& response)=0;
+    /// called after response is sent, for work that should not delay it
+    virtual void processIdle() {};
 protected:
     const char* lctx;
     void renice();
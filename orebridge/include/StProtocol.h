@@ -107,6 +107,10 @@
 #define CMD_RES_COMIC_RAR_INFO          75
 #define CMD_REQ_COMIC_RAR_EXTRACT       76
 #define CMD_RES_COMIC_RAR_EXTRACT       77
+#define CMD_REQ_CRE_COMPLETE_LAYOUT     78
+#define CMD_RES_CRE_COMPLETE_LAYOUT     79
+#define CMD_REQ_INDEXER_PREFIX          80
+#define CMD_RES_INDEXER_PREFIX          81
 
 #define CMD_REQ_INSTALL_FONTS 64
 #define CMD_RES_INSTALL_FONTS 65
@@ -111,9 +111,38 @@ void OreVerResporse(const char* base_version, CmdResponse& response);
 #define CONFIG_ERA_TEXT_INDENT            204
 #define CONFIG_ERA_PARAGRAPH_MARGIN       205
 #define CONFIG_ERA_INDENT_MARGIN_OVERRIDE 206
+/**
+ * Directory for per-document sidecar caches, empty string disables them
+ */
+#define CONFIG_MUPDF_CACHE_DIR            207
+/**
+ * Open lays out only start of document and replies with estimated pages count and
+ * "layout incomplete" flag, CMD_REQ_CRE_COMPLETE_LAYOUT returns final pages count
+ */
+#define CONFIG_CRE_PROGRESSIVE_RENDER     208
+/**
+ * Codec for document storage chunks unloaded from memory: 0 - none, 1 - fast (default), 2 - zlib
+ */
+#define CONFIG_CRE_STORAGE_CODEC          209
+/**
+ * Directory for temporary spill file of unloaded storage chunks,
+ * empty string keeps them packed in memory
+ */
+#define CONFIG_CRE_STORAGE_SPILL_DIR      210
+/**
+ * Directory for hyphenation pattern tries compiled on dictionary activation,
+ * empty string disables them
+ */
+#define CONFIG_CRE_HYPH_CACHE_DIR         211
+/**
+ * Directory for search suggestion phrases indexed per document and layout,
+ * empty string keeps them in memory only
+ */
+#define CONFIG_CRE_PHRASE_CACHE_DIR       212
 
 #define HARDCONFIG_DJVU_RENDERING_MODE 0
 #define HARDCONFIG_MUPDF_SLOW_CMYK 1 //if not ARM architecture it would convert cmyk slow but quality
+#define HARDCONFIG_MUPDF_LINEARIZED_LOAD 1 //open linearized pdf from first page xref and hints
 #define TEXT_SEARCH_PREVIEW_WORD_NUM 7
 
 // 32-bit unsigned integer max value.